@@ -0,0 +1,161 @@
+#include "aot.h"
+#include "interpreter.h"
+#include "lexer.h"
+#include "native_jit.h"
+#include "resolver.h"
+#include <elf.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+extern int yyparse();
+extern BlockNode* programRoot;
+
+// Image layout version
+static const uint32_t AOT_MAGIC = 0x4C414931;  // "LAI1"
+
+// Where the image starts in the object's data, after its size
+static const size_t IMAGE_OFFSET = 16;
+
+static void put(std::vector<uint8_t>& out, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+static void align(std::vector<uint8_t>& out, size_t alignment) {
+    while (out.size() % alignment) out.push_back(0);
+}
+
+// A relocatable object with the image in .rodata, as luau_aot_image and
+// luau_aot_image_size. Nothing in it needs relocating.
+static std::vector<uint8_t> elfObject(const std::vector<uint8_t>& image) {
+    std::vector<uint8_t> rodata;
+    uint64_t imageSize = image.size();
+    put(rodata, &imageSize, sizeof(imageSize));
+    align(rodata, IMAGE_OFFSET);
+    put(rodata, image.data(), image.size());
+
+    // Names, each after a NUL so that offset 0 is the empty name
+    std::string shstrtab = std::string("\0.rodata\0.note.GNU-stack\0.symtab\0.strtab\0.shstrtab\0", 51);
+    std::string strtab = std::string("\0luau_aot_image_size\0luau_aot_image\0", 36);
+
+    std::vector<Elf64_Sym> symbols(3);
+    memset(symbols.data(), 0, symbols.size() * sizeof(Elf64_Sym));
+    symbols[1].st_name = 1;
+    symbols[1].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+    symbols[1].st_shndx = 1;
+    symbols[1].st_value = 0;
+    symbols[1].st_size = sizeof(imageSize);
+    symbols[2].st_name = 21;
+    symbols[2].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+    symbols[2].st_shndx = 1;
+    symbols[2].st_value = IMAGE_OFFSET;
+    symbols[2].st_size = image.size();
+
+    std::vector<uint8_t> out(sizeof(Elf64_Ehdr));
+    size_t rodataOffset = out.size();
+    put(out, rodata.data(), rodata.size());
+    size_t shstrtabOffset = out.size();
+    put(out, shstrtab.data(), shstrtab.size());
+    size_t strtabOffset = out.size();
+    put(out, strtab.data(), strtab.size());
+    align(out, 8);
+    size_t symtabOffset = out.size();
+    put(out, symbols.data(), symbols.size() * sizeof(Elf64_Sym));
+    align(out, 8);
+    size_t sectionsOffset = out.size();
+
+    // null, .rodata, .note.GNU-stack (no executable stack), .symtab,
+    // .strtab, .shstrtab
+    std::vector<Elf64_Shdr> sections(6);
+    memset(sections.data(), 0, sections.size() * sizeof(Elf64_Shdr));
+    sections[1] = {1, SHT_PROGBITS, SHF_ALLOC, 0, rodataOffset, rodata.size(), 0, 0, 16, 0};
+    sections[2] = {9, SHT_PROGBITS, 0, 0, shstrtabOffset, 0, 0, 0, 1, 0};
+    sections[3] = {25, SHT_SYMTAB, 0, 0, symtabOffset, symbols.size() * sizeof(Elf64_Sym), 4, 1, 8,
+                   sizeof(Elf64_Sym)};
+    sections[4] = {33, SHT_STRTAB, 0, 0, strtabOffset, strtab.size(), 0, 0, 1, 0};
+    sections[5] = {41, SHT_STRTAB, 0, 0, shstrtabOffset, shstrtab.size(), 0, 0, 1, 0};
+    put(out, sections.data(), sections.size() * sizeof(Elf64_Shdr));
+
+    Elf64_Ehdr header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_NONE;
+    header.e_type = ET_REL;
+    header.e_machine = CodeGenerator::isX86_64() ? EM_X86_64 : EM_AARCH64;
+    header.e_version = EV_CURRENT;
+    header.e_shoff = sectionsOffset;
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_shentsize = sizeof(Elf64_Shdr);
+    header.e_shnum = sections.size();
+    header.e_shstrndx = 5;
+    memcpy(out.data(), &header, sizeof(header));
+    return out;
+}
+
+void writeAotObject(const std::string& path, const std::string& source, BlockNode* program) {
+    // Globals get the slots they will have when the image runs
+    Interpreter interp;
+    resolveSlots(program, interp.globals);
+    NativeJIT jit(&interp);
+    std::vector<uint8_t> functions = jit.precompile(program);
+
+    std::vector<uint8_t> image;
+    uint32_t sourceSize = source.size();
+    put(image, &AOT_MAGIC, sizeof(AOT_MAGIC));
+    put(image, &sourceSize, sizeof(sourceSize));
+    put(image, source.data(), source.size());
+    put(image, functions.data(), functions.size());
+
+    std::vector<uint8_t> object = elfObject(image);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)object.data(), object.size());
+    if (!file) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+int runAotImage(const uint8_t* image, size_t size) {
+    uint32_t magic = 0, sourceSize = 0;
+    if (size >= 8) {
+        memcpy(&magic, image, 4);
+        memcpy(&sourceSize, image + 4, 4);
+    }
+    if (magic != AOT_MAGIC || sourceSize > size - 8) {
+        std::cerr << "Error: Damaged program image" << std::endl;
+        return 1;
+    }
+    const uint8_t* functions = image + 8 + sourceSize;
+
+    // The source is parsed again, so the compiled code finds the same
+    // definitions it was compiled from
+    Arena arena;
+    parseArena = &arena;
+    yysetinput((const char*)image + 8, sourceSize);
+    if (yyparse() != 0 || !programRoot) {
+        std::cerr << "Error: Failed to parse program image" << std::endl;
+        return 1;
+    }
+
+    try {
+        // Functions run compiled from their first call; the image has
+        // them unless they didn't compile or were called with other types
+        Interpreter interp;
+        interp.callThreshold = 1;
+        resolveSlots(programRoot, interp.globals);
+        NativeJIT jit(&interp);
+        jit.useImage(functions, image + size - functions);
+        jit.execute(programRoot);
+    } catch (const std::exception& e) {
+        std::cerr << "Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
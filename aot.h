@@ -0,0 +1,23 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include "ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Ahead-of-time compilation. A program is written out as an ELF object
+// holding an image of its source and its functions compiled in advance;
+// linked with the runtime library (libluau_rt.a, which provides main) it
+// makes an executable that runs the program with no compilation on the
+// way, unless the types the code was compiled for turn out wrong.
+
+// Compile the functions of a parsed program and write the object; throws
+// std::runtime_error if it can't be written
+void writeAotObject(const std::string& path, const std::string& source, BlockNode* program);
+
+// Run the program in an image written by writeAotObject; returns the exit
+// status
+int runAotImage(const uint8_t* image, size_t size);
+
+#endif // AOT_H
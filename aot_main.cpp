@@ -0,0 +1,10 @@
+#include "aot.h"
+
+// Entry point of programs compiled ahead of time (luau --aot), whose object
+// defines the image
+extern "C" const uint64_t luau_aot_image_size;
+extern "C" const uint8_t luau_aot_image[];
+
+int main() {
+    return runAotImage(luau_aot_image, luau_aot_image_size);
+}
@@ -0,0 +1,36 @@
+#include "arena.h"
+#include <sys/mman.h>
+
+// All the address space 32-bit offsets can reach; reserving it costs
+// nothing until it is committed, a step at a time
+static const size_t RESERVED = (size_t)1 << 32;
+static const size_t COMMIT_STEP = 1 << 20;
+
+Arena::Arena() {
+    void* reservation = mmap(nullptr, RESERVED, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reservation == MAP_FAILED) throw std::bad_alloc();
+    base = (char*)reservation;
+    used = alignof(std::max_align_t);  // keeps offset 0 free
+}
+
+Arena::~Arena() {
+    for (const auto& object : destructors) {
+        object.second(object.first);
+    }
+    munmap(base, RESERVED);
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    size_t at = (used + align - 1) & ~(align - 1);
+    if (at + size > committed) {
+        if (at + size > RESERVED) throw std::bad_alloc();
+        size_t commit = (at + size + COMMIT_STEP - 1) & ~(COMMIT_STEP - 1);
+        if (commit > RESERVED) commit = RESERVED;
+        if (mprotect(base + committed, commit - committed, PROT_READ | PROT_WRITE) != 0) {
+            throw std::bad_alloc();
+        }
+        committed = commit;
+    }
+    used = at + size;
+    return base + at;
+}
@@ -0,0 +1,48 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for objects that all live exactly as long as the arena,
+// such as the nodes of a parsed program: they are laid out one after the
+// other in the order they are made, and the memory goes in one piece when
+// the arena does. Destructors still run then, in that same order, for
+// whatever the objects own themselves.
+//
+// The arena is a single reservation of address space that never moves,
+// committed as it fills, so everything in it is also at a fixed 32-bit
+// offset from its base. No object is ever at offset 0.
+class Arena {
+public:
+    Arena();
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align);
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            destructors.push_back({object, [](void* p) { static_cast<T*>(p)->~T(); }});
+        }
+        return object;
+    }
+
+    uint32_t offset(const void* object) const { return (uint32_t)((const char*)object - base); }
+    void* at(uint32_t offset) const { return base + offset; }
+
+private:
+    char* base = nullptr;
+    size_t used = 0;
+    size_t committed = 0;
+    std::vector<std::pair<void*, void (*)(void*)>> destructors;
+};
+
+#endif // ARENA_H
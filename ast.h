@@ -1,12 +1,12 @@
 #ifndef AST_H
 #define AST_H
 
-#include <string>
-#include <vector>
-#include <memory>
-#include <map>
+#include <cstdint>
+#include "arena.h"
+#include "symbol.h"
+#include "value.h"
 
-enum class ASTNodeType {
+enum class ASTNodeType : uint8_t {
     INTEGER,
     BOOLEAN,
     STRING,
@@ -24,25 +24,74 @@ enum class ASTNodeType {
     TYPE_ANNOTATION
 };
 
-enum class BinaryOpType {
+enum class BinaryOpType : uint8_t {
     ADD, SUB, MUL, DIV, MOD,
     EQ, NE, LT, LE, GT, GE,
     AND, OR
 };
 
-enum class UnaryOpType {
+enum class UnaryOpType : uint8_t {
     NOT, NEG
 };
 
+class ASTNode;
+class BlockNode;
+
+extern BlockNode* programRoot;
+// Where the parser makes the nodes of programRoot; they live as long as it
+extern Arena* parseArena;
+
+// The tree is flat: nodes, and the lists of their children and names, are
+// laid out in the parse arena in the order they are parsed (children
+// first), hold nothing that needs destroying, and link to each other by
+// 32-bit offsets into it rather than by pointers.
 class ASTNode {
 public:
     ASTNodeType type;
-    virtual ~ASTNode() = default;
 
 protected:
     ASTNode(ASTNodeType t) : type(t) {}
 };
 
+// A link to a child node, or to none
+class NodeRef {
+public:
+    NodeRef() = default;
+    NodeRef(ASTNode* node) : offset(node ? parseArena->offset(node) : 0) {}
+
+    ASTNode* get() const { return offset ? static_cast<ASTNode*>(parseArena->at(offset)) : nullptr; }
+    ASTNode* operator->() const { return get(); }
+    explicit operator bool() const { return offset != 0; }
+
+private:
+    uint32_t offset = 0;
+};
+
+// A list of child nodes or names, copied into the arena in one piece
+template <typename T>
+class ArenaList {
+public:
+    ArenaList() = default;
+    ArenaList(const T* items, size_t count) : count(count) {
+        if (count == 0) return;
+        T* copy = static_cast<T*>(parseArena->allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; i++) new (copy + i) T(items[i]);
+        offset = parseArena->offset(copy);
+    }
+
+    const T* begin() const { return static_cast<const T*>(parseArena->at(offset)); }
+    const T* end() const { return begin() + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return begin()[i]; }
+    const T& back() const { return begin()[count - 1]; }
+
+private:
+    uint32_t offset = 0;
+    uint32_t count = 0;
+};
+using NodeList = ArenaList<NodeRef>;
+
 class IntegerNode : public ASTNode {
 public:
     long long value;
@@ -55,23 +104,28 @@ public:
     BooleanNode(bool v) : ASTNode(ASTNodeType::BOOLEAN), value(v) {}
 };
 
+// The string is interned when parsed; it is never freed, so the node
+// holds just its payload
 class StringNode : public ASTNode {
 public:
-    std::string value;
-    StringNode(const std::string& v) : ASTNode(ASTNodeType::STRING), value(v) {}
+    long long bits;  // Value::bits of the interned string
+    StringNode(const std::string& v) : ASTNode(ASTNodeType::STRING), bits(Value::interned(v).bits()) {}
+    Value value() const { return Value::fromBits(ValueType::STRING, bits); }
 };
 
 class VariableNode : public ASTNode {
 public:
-    std::string name;
-    VariableNode(const std::string& n) : ASTNode(ASTNodeType::VARIABLE), name(n) {}
+    Symbol name;
+    int slot = -1;    // frame slot from resolveSlots, or -1 for a global
+    int global = -1;  // slot in the GlobalTable if a global
+    VariableNode(Symbol n) : ASTNode(ASTNodeType::VARIABLE), name(n) {}
 };
 
 class BinaryOpNode : public ASTNode {
 public:
     BinaryOpType op;
-    std::unique_ptr<ASTNode> left;
-    std::unique_ptr<ASTNode> right;
+    NodeRef left;
+    NodeRef right;
     BinaryOpNode(BinaryOpType o, ASTNode* l, ASTNode* r)
         : ASTNode(ASTNodeType::BINARY_OP), op(o), left(l), right(r) {}
 };
@@ -79,78 +133,75 @@ public:
 class UnaryOpNode : public ASTNode {
 public:
     UnaryOpType op;
-    std::unique_ptr<ASTNode> operand;
+    NodeRef operand;
     UnaryOpNode(UnaryOpType o, ASTNode* opnd)
         : ASTNode(ASTNodeType::UNARY_OP), op(o), operand(opnd) {}
 };
 
 class AssignmentNode : public ASTNode {
 public:
-    std::string variable;
-    std::string typeAnnotation;
-    std::unique_ptr<ASTNode> value;
-    AssignmentNode(const std::string& var, ASTNode* val, const std::string& type = "")
-        : ASTNode(ASTNodeType::ASSIGNMENT), variable(var), typeAnnotation(type), value(val) {}
+    Symbol variable;
+    Symbol typeAnnotation;
+    NodeRef value;
+    bool isLocal;   // declared with 'local'
+    int slot = -1;    // frame slot from resolveSlots, or -1 for a global
+    int global = -1;  // slot in the GlobalTable if a global
+    AssignmentNode(Symbol var, ASTNode* val, Symbol type = Symbol(), bool local = false)
+        : ASTNode(ASTNodeType::ASSIGNMENT), variable(var), typeAnnotation(type), value(val), isLocal(local) {}
 };
 
 class FunctionDefNode : public ASTNode {
 public:
-    std::string name;
-    std::vector<std::string> params;
-    std::vector<std::string> paramTypes;
-    std::string returnType;
-    std::unique_ptr<ASTNode> body;
-    FunctionDefNode(const std::string& n, const std::vector<std::string>& p, ASTNode* b,
-                    const std::vector<std::string>& pt = {}, const std::string& rt = "")
-        : ASTNode(ASTNodeType::FUNCTION_DEF), name(n), params(p), paramTypes(pt), returnType(rt), body(b) {}
+    Symbol name;
+    ArenaList<Symbol> params;
+    Symbol returnType;
+    NodeRef body;
+    int frameSize = 0;  // parameters and locals, parameters first
+    FunctionDefNode(Symbol n, ArenaList<Symbol> p, ASTNode* b, Symbol rt = Symbol())
+        : ASTNode(ASTNodeType::FUNCTION_DEF), name(n), params(p), returnType(rt), body(b) {}
 };
 
 class FunctionCallNode : public ASTNode {
 public:
-    std::string name;
-    std::vector<std::unique_ptr<ASTNode>> args;
-    FunctionCallNode(const std::string& n)
-        : ASTNode(ASTNodeType::FUNCTION_CALL), name(n) {}
+    Symbol name;
+    NodeList args;
+    FunctionCallNode(Symbol n, NodeList a)
+        : ASTNode(ASTNodeType::FUNCTION_CALL), name(n), args(a) {}
 };
 
 class ReturnNode : public ASTNode {
 public:
-    std::unique_ptr<ASTNode> value;
+    NodeRef value;
     ReturnNode(ASTNode* v) : ASTNode(ASTNodeType::RETURN), value(v) {}
 };
 
 class IfNode : public ASTNode {
 public:
-    std::unique_ptr<ASTNode> condition;
-    std::unique_ptr<ASTNode> thenBlock;
-    std::unique_ptr<ASTNode> elseBlock;
+    NodeRef condition;
+    NodeRef thenBlock;
+    NodeRef elseBlock;
     IfNode(ASTNode* cond, ASTNode* thenB, ASTNode* elseB = nullptr)
         : ASTNode(ASTNodeType::IF_STMT), condition(cond), thenBlock(thenB), elseBlock(elseB) {}
 };
 
 class WhileNode : public ASTNode {
 public:
-    std::unique_ptr<ASTNode> condition;
-    std::unique_ptr<ASTNode> body;
+    NodeRef condition;
+    NodeRef body;
     WhileNode(ASTNode* cond, ASTNode* b)
         : ASTNode(ASTNodeType::WHILE_STMT), condition(cond), body(b) {}
 };
 
 class BlockNode : public ASTNode {
 public:
-    std::vector<std::unique_ptr<ASTNode>> statements;
-    BlockNode() : ASTNode(ASTNodeType::BLOCK) {}
-    void addStatement(ASTNode* stmt) {
-        statements.push_back(std::unique_ptr<ASTNode>(stmt));
-    }
+    NodeList statements;
+    BlockNode(NodeList s) : ASTNode(ASTNodeType::BLOCK), statements(s) {}
 };
 
 class PrintNode : public ASTNode {
 public:
-    std::vector<std::unique_ptr<ASTNode>> args;
-    PrintNode() : ASTNode(ASTNodeType::PRINT) {}
+    NodeList args;
+    PrintNode(NodeList a) : ASTNode(ASTNodeType::PRINT), args(a) {}
 };
 
-extern BlockNode* programRoot;
-
 #endif
@@ -36,6 +36,10 @@ run_benchmark() {
     fi
 
     echo "Our implementation (interpreted):"
+    time ./luau --interp "$file" 2>&1
+    echo ""
+
+    echo "Our implementation (bytecode VM):"
     time ./luau "$file" 2>&1
     echo ""
 
@@ -57,6 +61,26 @@ fi
 # Run benchmarks
 run_benchmark "Arithmetic Operations" "benchmarks/arithmetic.lua"
 run_benchmark "Fibonacci" "benchmarks/fibonacci.lua"
+run_benchmark "Function Calls" "benchmarks/calls.lua"
+
+# Interpreted call cost should stay flat as the number of globals grows
+echo -e "${BLUE}Running benchmark: Function Calls vs. Global Count${NC}"
+echo "-----------------------------------"
+GLOBALS_FILE=$(mktemp /tmp/calls_globals.XXXXXX.lua)
+for count in 0 100 1000; do
+    : > "$GLOBALS_FILE"
+    for ((g = 0; g < count; g++)); do
+        echo "global_$g = $g" >> "$GLOBALS_FILE"
+    done
+    cat benchmarks/calls.lua >> "$GLOBALS_FILE"
+
+    echo "Our implementation (interpreted), $count globals:"
+    time ./luau --interp "$GLOBALS_FILE" 2>&1
+    echo ""
+done
+rm -f "$GLOBALS_FILE"
+echo "-----------------------------------"
+echo ""
 
 echo "======================================="
 echo "Benchmark Complete"
@@ -0,0 +1,20 @@
+-- Call overhead benchmark
+-- Makes many small function calls. benchmark.sh also runs it with extra
+-- globals defined up front: the cost of a call should not depend on them.
+
+function add(a, b)
+    return a + b
+end
+
+function benchmark()
+    local sum = 0
+    local i = 0
+    while i < 200000 do
+        sum = add(sum, i)
+        i = i + 1
+    end
+    return sum
+end
+
+local result = benchmark()
+print("Calls benchmark result:", result)
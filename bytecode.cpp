@@ -0,0 +1,319 @@
+#include "bytecode.h"
+#include <stdexcept>
+#include <algorithm>
+
+std::unique_ptr<Module> BytecodeCompiler::compile(BlockNode* program) {
+    auto result = std::make_unique<Module>();
+    module = result.get();
+
+    module->protos.push_back(std::make_unique<Proto>());
+    proto = module->protos[0].get();
+    proto->name = "main";
+    freeReg = 0;
+    integerConstants.clear();
+    stringConstants.clear();
+
+    compileStatement(program);
+    emit(encodeABC(Op::RETURN0, 0, 0, 0));
+
+    module = nullptr;
+    proto = nullptr;
+    return result;
+}
+
+int BytecodeCompiler::compileFunction(FunctionDefNode* func) {
+    Proto* savedProto = proto;
+    int savedFreeReg = freeReg;
+    auto savedIntegers = std::move(integerConstants);
+    auto savedStrings = std::move(stringConstants);
+    integerConstants.clear();
+    stringConstants.clear();
+
+    int index = module->protos.size();
+    module->protos.push_back(std::make_unique<Proto>());
+    proto = module->protos.back().get();
+    proto->name = func->name.str();
+    proto->def = func;
+    proto->functionIndex = function(func->name);
+    proto->numParams = func->params.size();
+
+    // Parameters and locals occupy the first slots of the frame
+    if (func->frameSize > MAX_REGISTERS) {
+        throw std::runtime_error("Too many locals in function " + func->name.str());
+    }
+    freeReg = func->frameSize;
+    proto->maxRegs = freeReg;
+
+    compileStatement(func->body.get());
+    emit(encodeABC(Op::RETURN0, 0, 0, 0));
+
+    proto = savedProto;
+    freeReg = savedFreeReg;
+    integerConstants = std::move(savedIntegers);
+    stringConstants = std::move(savedStrings);
+    return index;
+}
+
+void BytecodeCompiler::compileStatement(ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case ASTNodeType::ASSIGNMENT: {
+            AssignmentNode* assign = static_cast<AssignmentNode*>(node);
+            if (assign->slot >= 0) {
+                compileExpressionInto(assign->value.get(), assign->slot);
+            } else {
+                int saved = freeReg;
+                int value = compileExpression(assign->value.get());
+                emit(encodeABx(Op::SETGLOBAL, value, global(assign->variable)));
+                freeReg = saved;
+            }
+            break;
+        }
+
+        case ASTNodeType::FUNCTION_DEF: {
+            int index = compileFunction(static_cast<FunctionDefNode*>(node));
+            emit(encodeABx(Op::DEFFUNC, 0, index));
+            break;
+        }
+
+        case ASTNodeType::IF_STMT: {
+            IfNode* ifNode = static_cast<IfNode*>(node);
+            int saved = freeReg;
+            int cond = compileExpression(ifNode->condition.get());
+            freeReg = saved;
+            int skipThen = emit(encodeAsBx(Op::JMPIFNOT, cond, 0));
+            compileStatement(ifNode->thenBlock.get());
+            if (ifNode->elseBlock) {
+                int skipElse = emit(encodeAsBx(Op::JMP, 0, 0));
+                patchJump(skipThen, proto->code.size());
+                compileStatement(ifNode->elseBlock.get());
+                patchJump(skipElse, proto->code.size());
+            } else {
+                patchJump(skipThen, proto->code.size());
+            }
+            break;
+        }
+
+        case ASTNodeType::WHILE_STMT: {
+            WhileNode* whileNode = static_cast<WhileNode*>(node);
+            int loopStart = proto->code.size();
+            int saved = freeReg;
+            int cond = compileExpression(whileNode->condition.get());
+            freeReg = saved;
+            int exitJump = emit(encodeAsBx(Op::JMPIFNOT, cond, 0));
+            compileStatement(whileNode->body.get());
+            int backJump = emit(encodeAsBx(Op::JMP, 0, 0));
+            patchJump(backJump, loopStart);
+            patchJump(exitJump, proto->code.size());
+            break;
+        }
+
+        case ASTNodeType::BLOCK: {
+            for (auto& stmt : static_cast<BlockNode*>(node)->statements) {
+                compileStatement(stmt.get());
+            }
+            break;
+        }
+
+        case ASTNodeType::RETURN: {
+            ReturnNode* retNode = static_cast<ReturnNode*>(node);
+            if (retNode->value && retNode->value->type == ASTNodeType::FUNCTION_CALL && proto->def) {
+                // Proper tail call: the callee takes over this frame
+                int saved = freeReg;
+                compileCall(static_cast<FunctionCallNode*>(retNode->value.get()), allocRegister(), Op::TAILCALL);
+                freeReg = saved;
+            } else if (retNode->value) {
+                int saved = freeReg;
+                emit(encodeABC(Op::RETURN, compileExpression(retNode->value.get()), 0, 0));
+                freeReg = saved;
+            } else {
+                emit(encodeABC(Op::RETURN0, 0, 0, 0));
+            }
+            break;
+        }
+
+        case ASTNodeType::PRINT: {
+            PrintNode* printNode = static_cast<PrintNode*>(node);
+            int base = freeReg;
+            for (auto& arg : printNode->args) {
+                compileExpressionInto(arg.get(), allocRegister());
+            }
+            emit(encodeABC(Op::PRINT, base, printNode->args.size(), 0));
+            freeReg = base;
+            break;
+        }
+
+        default: {
+            // Expression statement, e.g. a call made for its side effects
+            int saved = freeReg;
+            compileExpression(node);
+            freeReg = saved;
+            break;
+        }
+    }
+}
+
+int BytecodeCompiler::compileExpression(ASTNode* node) {
+    if (node && node->type == ASTNodeType::VARIABLE) {
+        int slot = static_cast<VariableNode*>(node)->slot;
+        if (slot >= 0) return slot;
+    }
+    int reg = allocRegister();
+    compileExpressionInto(node, reg);
+    return reg;
+}
+
+void BytecodeCompiler::compileExpressionInto(ASTNode* node, int target) {
+    if (!node) {
+        emit(encodeABC(Op::LOADNIL, target, 0, 0));
+        return;
+    }
+
+    switch (node->type) {
+        case ASTNodeType::INTEGER: {
+            long long value = static_cast<IntegerNode*>(node)->value;
+            if (value >= -SBX_BIAS && value <= SBX_BIAS) {
+                emit(encodeAsBx(Op::LOADI, target, value));
+            } else {
+                emit(encodeABx(Op::LOADK, target, constant(Value(value))));
+            }
+            break;
+        }
+        case ASTNodeType::BOOLEAN:
+            emit(encodeABC(Op::LOADBOOL, target, static_cast<BooleanNode*>(node)->value, 0));
+            break;
+        case ASTNodeType::STRING:
+            emit(encodeABx(Op::LOADK, target,
+                           constant(static_cast<StringNode*>(node)->value())));
+            break;
+
+        case ASTNodeType::VARIABLE: {
+            VariableNode* var = static_cast<VariableNode*>(node);
+            if (var->slot < 0) {
+                emit(encodeABx(Op::GETGLOBAL, target, global(var->name)));
+            } else if (var->slot != target) {
+                emit(encodeABC(Op::MOVE, target, var->slot, 0));
+            }
+            break;
+        }
+
+        case ASTNodeType::BINARY_OP: {
+            static const Op ops[] = {
+                Op::ADD, Op::SUB, Op::MUL, Op::DIV, Op::MOD,
+                Op::EQ, Op::NE, Op::LT, Op::LE, Op::GT, Op::GE,
+                Op::AND, Op::OR
+            };
+            BinaryOpNode* binOp = static_cast<BinaryOpNode*>(node);
+            int saved = freeReg;
+            int left = compileExpression(binOp->left.get());
+            int right = compileExpression(binOp->right.get());
+            freeReg = saved;
+            emit(encodeABC(ops[(int)binOp->op], target, left, right));
+            break;
+        }
+
+        case ASTNodeType::UNARY_OP: {
+            UnaryOpNode* unOp = static_cast<UnaryOpNode*>(node);
+            int saved = freeReg;
+            int operand = compileExpression(unOp->operand.get());
+            freeReg = saved;
+            emit(encodeABC(unOp->op == UnaryOpType::NOT ? Op::NOT : Op::NEG, target, operand, 0));
+            break;
+        }
+
+        case ASTNodeType::FUNCTION_CALL: {
+            // Calls leave their result in the first argument register, which
+            // has to be the top of the frame
+            FunctionCallNode* call = static_cast<FunctionCallNode*>(node);
+            if (target == freeReg - 1 && target >= (proto->def ? proto->def->frameSize : 0)) {
+                compileCall(call, target);
+            } else {
+                int saved = freeReg;
+                int base = allocRegister();
+                compileCall(call, base);
+                emit(encodeABC(Op::MOVE, target, base, 0));
+                freeReg = saved;
+            }
+            break;
+        }
+
+        default:
+            emit(encodeABC(Op::LOADNIL, target, 0, 0));
+            break;
+    }
+}
+
+void BytecodeCompiler::compileCall(FunctionCallNode* call, int base, Op op) {
+    if (call->args.size() >= MAX_REGISTERS) {
+        throw std::runtime_error("Too many arguments in call to " + call->name.str());
+    }
+
+    for (size_t i = 0; i < call->args.size(); i++) {
+        int reg = i == 0 ? base : allocRegister();
+        compileExpressionInto(call->args[i].get(), reg);
+    }
+    freeReg = base + 1;
+
+    int index = function(call->name);
+    auto it = std::find(proto->callees.begin(), proto->callees.end(), index);
+    if (it == proto->callees.end()) {
+        if (proto->callees.size() >= 256) {
+            throw std::runtime_error("Too many distinct callees in " + proto->name);
+        }
+        it = proto->callees.insert(proto->callees.end(), index);
+    }
+    emit(encodeABC(op, base, call->args.size(), it - proto->callees.begin()));
+}
+
+int BytecodeCompiler::allocRegister() {
+    if (freeReg >= MAX_REGISTERS) {
+        throw std::runtime_error("Expression too complex in " + proto->name);
+    }
+    int reg = freeReg++;
+    proto->maxRegs = std::max(proto->maxRegs, freeReg);
+    return reg;
+}
+
+int BytecodeCompiler::emit(uint32_t insn) {
+    proto->code.push_back(insn);
+    return proto->code.size() - 1;
+}
+
+void BytecodeCompiler::patchJump(int at, int target) {
+    int offset = target - (at + 1);
+    if (offset < -SBX_BIAS || offset > SBX_BIAS) {
+        throw std::runtime_error("Jump too far in " + proto->name);
+    }
+    uint32_t insn = proto->code[at];
+    proto->code[at] = encodeAsBx(decodeOp(insn), decodeA(insn), offset);
+}
+
+int BytecodeCompiler::constant(const Value& value) {
+    auto& constants = proto->constants;
+    auto& index = value.type == ValueType::STRING ? stringConstants : integerConstants;
+    auto it = index.find(value.bits());
+    if (it != index.end()) return it->second;
+    if (constants.size() > 0xFFFF) {
+        throw std::runtime_error("Too many constants in " + proto->name);
+    }
+    constants.push_back(value);
+    return index[value.bits()] = constants.size() - 1;
+}
+
+int BytecodeCompiler::global(Symbol name) {
+    auto it = globalIndex.find(name);
+    if (it != globalIndex.end()) return it->second;
+    if (module->globalNames.size() > 0xFFFF) {
+        throw std::runtime_error("Too many globals");
+    }
+    module->globalNames.push_back(name);
+    return globalIndex[name] = module->globalNames.size() - 1;
+}
+
+int BytecodeCompiler::function(Symbol name) {
+    auto it = functionIndex.find(name);
+    if (it != functionIndex.end()) return it->second;
+    module->functionNames.push_back(name);
+    return functionIndex[name] = module->functionNames.size() - 1;
+}
@@ -0,0 +1,124 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "ast.h"
+#include "value.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+
+// Register-based bytecode in the style of Lua 5, executed by the VM.
+//
+// Each instruction is 32 bits: an 8-bit opcode, an 8-bit A operand, and
+// either two 8-bit operands B and C or one 16-bit operand Bx (sBx when
+// signed). Registers are frame slots: a function's parameters and locals
+// come first, numbered as resolveSlots numbered them, and expression
+// temporaries live above them.
+
+enum class Op : uint8_t {
+    MOVE,       // R[A] = R[B]
+    LOADI,      // R[A] = sBx
+    LOADK,      // R[A] = K[Bx]
+    LOADBOOL,   // R[A] = (B != 0)
+    LOADNIL,    // R[A] = nil
+    GETGLOBAL,  // R[A] = G[Bx]
+    SETGLOBAL,  // G[Bx] = R[A]
+
+    // R[A] = R[B] op R[C]
+    ADD, SUB, MUL, DIV, MOD,
+    EQ, NE, LT, LE, GT, GE,
+    AND, OR,
+
+    // R[A] = op R[B]
+    NOT, NEG,
+
+    JMP,        // pc += sBx
+    JMPIF,      // if R[A] then pc += sBx
+    JMPIFNOT,   // if not R[A] then pc += sBx
+
+    CALL,       // R[A] = F[callees[C]](R[A], ..., R[A+B-1])
+    TAILCALL,   // return F[callees[C]](R[A], ..., R[A+B-1]), reusing the frame
+    RETURN,     // return R[A]
+    RETURN0,    // return nil
+    PRINT,      // print(R[A], ..., R[A+B-1])
+    DEFFUNC,    // define function Bx (the statement 'function f() ... end')
+
+    OP_COUNT
+};
+
+const int MAX_REGISTERS = 256;
+const int SBX_BIAS = 0x7FFF;
+
+inline uint32_t encodeABC(Op op, int a, int b, int c) {
+    return (uint32_t)op | (uint32_t)a << 8 | (uint32_t)b << 16 | (uint32_t)c << 24;
+}
+inline uint32_t encodeABx(Op op, int a, int bx) {
+    return (uint32_t)op | (uint32_t)a << 8 | (uint32_t)bx << 16;
+}
+inline uint32_t encodeAsBx(Op op, int a, int sbx) {
+    return encodeABx(op, a, sbx + SBX_BIAS);
+}
+
+inline Op decodeOp(uint32_t insn) { return (Op)(insn & 0xFF); }
+inline int decodeA(uint32_t insn) { return (insn >> 8) & 0xFF; }
+inline int decodeB(uint32_t insn) { return (insn >> 16) & 0xFF; }
+inline int decodeC(uint32_t insn) { return insn >> 24; }
+inline int decodeBx(uint32_t insn) { return insn >> 16; }
+inline int decodeSBx(uint32_t insn) { return (int)(insn >> 16) - SBX_BIAS; }
+
+// Compiled form of one function, or of the top-level chunk
+struct Proto {
+    std::string name;
+    FunctionDefNode* def = nullptr;  // null for the top-level chunk
+    int functionIndex = -1;          // index in Module::functionNames
+    int numParams = 0;
+    int maxRegs = 0;
+    std::vector<uint32_t> code;
+    std::vector<Value> constants;
+    std::vector<int> callees;        // CALL's C operand -> function index
+};
+
+// A compiled program. Global variables and functions are referred to by
+// index; the names are kept for error messages.
+struct Module {
+    std::vector<std::unique_ptr<Proto>> protos;  // protos[0] is the top level
+    std::vector<Symbol> globalNames;
+    std::vector<Symbol> functionNames;
+};
+
+// Compiles a resolved AST (see resolveSlots) into a Module
+class BytecodeCompiler {
+public:
+    std::unique_ptr<Module> compile(BlockNode* program);
+
+private:
+    Module* module = nullptr;
+    Proto* proto = nullptr;
+    int freeReg = 0;  // lowest register not holding a local or live temporary
+    std::unordered_map<Symbol, int> globalIndex;
+    std::unordered_map<Symbol, int> functionIndex;
+    // Constants of the Proto being compiled, by payload: they are integers
+    // or interned strings, so the payload identifies a string too
+    std::unordered_map<long long, int> integerConstants;
+    std::unordered_map<long long, int> stringConstants;
+
+    int compileFunction(FunctionDefNode* func);  // returns the Proto's index
+    void compileStatement(ASTNode* node);
+
+    // Evaluate into a register of the compiler's choosing (a local's own
+    // slot when possible) or into the given one
+    int compileExpression(ASTNode* node);
+    void compileExpressionInto(ASTNode* node, int target);
+    void compileCall(FunctionCallNode* call, int target, Op op = Op::CALL);
+
+    int allocRegister();
+    int emit(uint32_t insn);
+    void patchJump(int at, int target);
+    int constant(const Value& value);
+    int global(Symbol name);
+    int function(Symbol name);
+};
+
+#endif // BYTECODE_H
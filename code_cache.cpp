@@ -0,0 +1,144 @@
+#include "code_cache.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <iterator>
+#include <stdexcept>
+
+// Blocks start on a cache line; regions are reserved in one piece (within
+// range of a bl, which reaches +/-128 MiB) and given access rights as the
+// bump pointer moves, a chunk at a time
+static const size_t CODE_ALIGN = 64;
+static const size_t REGION_SIZE = 64 << 20;
+static const size_t COMMIT_CHUNK = 64 << 10;
+
+CodeCache::~CodeCache() {
+    for (const Region& region : regions) {
+        munmap(region.base, region.size);
+    }
+}
+
+uint8_t* CodeCache::allocate(size_t size) {
+    size = (size + CODE_ALIGN - 1) & ~(CODE_ALIGN - 1);
+
+    // First fit from the free list, lowest address first to keep code
+    // packed; the rest of the block stays free
+    uint8_t* block = nullptr;
+    for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+        if (it->second < size) continue;
+        block = it->first;
+        size_t rest = it->second - size;
+        freeBlocks.erase(it);
+        if (rest > 0) freeBlocks[block + size] = rest;
+        break;
+    }
+    if (!block) block = bump(size);
+
+    blocks[block] = size;
+    inUse += size;
+    return block;
+}
+
+void CodeCache::release(void* ptr) {
+    uint8_t* block = (uint8_t*)ptr;
+    auto it = blocks.find(block);
+    if (it == blocks.end()) {
+        throw std::runtime_error("Releasing unknown code block");
+    }
+    size_t size = it->second;
+    blocks.erase(it);
+    inUse -= size;
+
+    // Merge with free neighbours
+    auto next = freeBlocks.lower_bound(block);
+    if (next != freeBlocks.end() && next->first == block + size) {
+        size += next->second;
+        next = freeBlocks.erase(next);
+    }
+    if (next != freeBlocks.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == block) {
+            prev->second += size;
+            return;
+        }
+    }
+    freeBlocks[block] = size;
+}
+
+size_t CodeCache::blockSize(const void* block) const {
+    auto it = blocks.find((const uint8_t*)block);
+    return it == blocks.end() ? 0 : it->second;
+}
+
+uint8_t* CodeCache::bump(size_t size) {
+    if (regions.empty() || regions.back().size - regions.back().used < size) {
+        newRegion(size);
+    }
+    Region& region = regions.back();
+    uint8_t* block = region.base + region.used;
+    region.used += size;
+    commit(region, region.used);
+    return block;
+}
+
+void CodeCache::newRegion(size_t size) {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t regionSize = size > REGION_SIZE ? (size + pageSize - 1) & ~(pageSize - 1) : REGION_SIZE;
+
+    // Reserve address space only, right after the previous region if
+    // possible so direct calls between them stay in range. What is left
+    // of the previous region goes to the free list.
+    void* hint = nullptr;
+    if (!regions.empty()) {
+        Region& last = regions.back();
+        hint = last.base + last.size;
+        if (last.size > last.used) {
+            commit(last, last.size);
+            uint8_t* tail = last.base + last.used;
+            size_t tailSize = last.size - last.used;
+            last.used = last.size;
+            blocks[tail] = tailSize;
+            inUse += tailSize;
+            release(tail);
+        }
+    }
+    void* base = mmap(hint, regionSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Failed to reserve executable memory");
+    }
+    regions.push_back({(uint8_t*)base, regionSize, 0, 0});
+}
+
+void CodeCache::commit(Region& region, size_t end) {
+    if (end <= region.committed) return;
+    size_t committed = (end + COMMIT_CHUNK - 1) & ~(COMMIT_CHUNK - 1);
+    if (committed > region.size) committed = region.size;
+
+    int prot = writers > 0 ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+    if (mprotect(region.base + region.committed, committed - region.committed, prot) != 0) {
+        throw std::runtime_error("Failed to commit executable memory");
+    }
+    region.committed = committed;
+}
+
+bool CodeCache::protect(bool writable) {
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+    bool ok = true;
+    for (const Region& region : regions) {
+        if (region.committed == 0) continue;
+        ok &= mprotect(region.base, region.committed, prot) == 0;
+    }
+    return ok;
+}
+
+CodeCache::WriteScope::WriteScope(CodeCache& cache) : cache(cache) {
+    if (cache.writers++ == 0 && !cache.protect(true)) {
+        cache.writers--;
+        cache.protect(false);
+        throw std::runtime_error("Failed to make code writable");
+    }
+}
+
+CodeCache::WriteScope::~WriteScope() {
+    // Dropping back to executable only takes rights away
+    if (--cache.writers == 0) cache.protect(false);
+}
@@ -0,0 +1,68 @@
+#ifndef CODE_CACHE_H
+#define CODE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Executable memory for compiled code. Large regions are reserved up front
+// and handed out in cache-line aligned blocks, packed together (so calls
+// between them stay within direct call range) and recycled through a free
+// list once released.
+//
+// Memory is never writable and executable at once (W^X): the cache is
+// executable except while a WriteScope is open, which makes it writable
+// and not executable. Code must not run, and callers must not return to
+// code, inside a scope.
+class CodeCache {
+public:
+    CodeCache() = default;
+    ~CodeCache();
+    CodeCache(const CodeCache&) = delete;
+    CodeCache& operator=(const CodeCache&) = delete;
+
+    // A block of at least 'size' bytes; only writable inside a WriteScope
+    uint8_t* allocate(size_t size);
+
+    // Return a block to the free list. Nothing may run or point at it any
+    // more.
+    void release(void* block);
+
+    // Size of a block returned by allocate, as rounded up
+    size_t blockSize(const void* block) const;
+
+    // Bytes in blocks handed out and not released
+    size_t bytesInUse() const { return inUse; }
+
+    class WriteScope {
+    public:
+        explicit WriteScope(CodeCache& cache);
+        ~WriteScope();
+        WriteScope(const WriteScope&) = delete;
+        WriteScope& operator=(const WriteScope&) = delete;
+
+    private:
+        CodeCache& cache;
+    };
+
+private:
+    struct Region {
+        uint8_t* base;
+        size_t size;
+        size_t committed;  // pages with access rights, from base
+        size_t used;       // bump pointer, from base
+    };
+    std::vector<Region> regions;
+    std::map<uint8_t*, size_t> freeBlocks;  // by address, coalesced
+    std::map<const uint8_t*, size_t> blocks;
+    size_t inUse = 0;
+    int writers = 0;
+
+    uint8_t* bump(size_t size);
+    void newRegion(size_t size);
+    void commit(Region& region, size_t end);
+    bool protect(bool writable);
+};
+
+#endif
@@ -39,6 +39,42 @@ struct Label {
     Label() : offset(0), bound(false) {}
 };
 
+// Location of a value in register-allocated code: one of the backend's
+// allocatable registers, a spill slot in the frame, or an immediate
+struct Operand {
+    enum Kind { REG, SLOT, IMM };
+    Kind kind;
+    long long value;
+
+    static Operand reg(int index) { return {REG, index}; }
+    static Operand slot(int index) { return {SLOT, index}; }
+    static Operand imm(long long v) { return {IMM, v}; }
+
+    bool isReg() const { return kind == REG; }
+    bool isSlot() const { return kind == SLOT; }
+    bool isImm() const { return kind == IMM; }
+    bool operator==(const Operand& o) const { return kind == o.kind && value == o.value; }
+    bool operator!=(const Operand& o) const { return !(*this == o); }
+};
+
+// Two-operand arithmetic and logic (AND/OR yield 0 or 1)
+enum class ALUOp { ADD, SUB, MUL, DIV, MOD, AND, OR };
+
+// Signed comparisons
+enum class CondCode { EQ, NE, LT, LE, GT, GE };
+
+// The comparison that holds exactly when cc does not
+inline CondCode inverse(CondCode cc) {
+    switch (cc) {
+        case CondCode::EQ: return CondCode::NE;
+        case CondCode::NE: return CondCode::EQ;
+        case CondCode::LT: return CondCode::GE;
+        case CondCode::LE: return CondCode::GT;
+        case CondCode::GT: return CondCode::LE;
+        default: return CondCode::LT;
+    }
+}
+
 // Abstract code generator base class
 class CodeGenerator {
 public:
@@ -47,71 +83,102 @@ public:
     // Get generated code
     const std::vector<uint8_t>& getCode() const { return code; }
     size_t size() const { return code.size(); }
-    void clear() { code.clear(); labelCounter = 0; }
+    void clear() {
+        code.clear();
+        labelCounter = 0;
+        forgetEmitted();
+    }
 
     // Architecture detection
     static bool isX86_64();
     static bool isARM64();
 
-    // Function prologue/epilogue
-    virtual void emitPrologue(int localCount) = 0;
-    virtual void emitEpilogue() = 0;
-
-    // Load immediate value into result register
-    virtual void emitLoadImmediate(long long value) = 0;
+    // Number of callee-saved registers handed to the register allocator.
+    // They survive runtime and direct calls, so no caller-side saves.
+    virtual int allocatableRegCount() const = 0;
 
-    // Load boolean into result register (0 or 1)
-    virtual void emitLoadBool(bool value) = 0;
-
-    // Variable operations (offset is stack slot index)
-    virtual void emitLoadLocal(int offset) = 0;
-    virtual void emitStoreLocal(int offset) = 0;
+    // Function prologue/epilogue. Reserves 'spillSlots' frame slots and
+    // preserves the first 'savedRegs' allocatable registers.
+    virtual void emitPrologue(int spillSlots, int savedRegs) = 0;
+    virtual void emitEpilogue() = 0;
 
-    // Load function argument into result register
-    virtual void emitLoadArg(int argIndex) = 0;
+    // dst = src
+    virtual void emitMove(Operand dst, Operand src) = 0;
 
-    // Push/pop result register to stack (for expression evaluation)
-    virtual void emitPush() = 0;
-    virtual void emitPop() = 0; // Pop into secondary register
+    // dst = incoming argument, or the address of the array holding them;
+    // only valid before the first call
+    virtual void emitLoadArg(Operand dst, int argIndex) = 0;
+    virtual void emitLoadArgs(Operand dst) = 0;
 
-    // Binary operations (left in secondary, right in result -> result)
-    virtual void emitAdd() = 0;
-    virtual void emitSub() = 0;
-    virtual void emitMul() = 0;
-    virtual void emitDiv() = 0;
-    virtual void emitMod() = 0;
+    // dst = left op right
+    virtual void emitBinary(ALUOp op, Operand dst, Operand left, Operand right) = 0;
 
-    // Comparison operations (result is 0 or 1)
-    virtual void emitCompareEq() = 0;
-    virtual void emitCompareNe() = 0;
-    virtual void emitCompareLt() = 0;
-    virtual void emitCompareLe() = 0;
-    virtual void emitCompareGt() = 0;
-    virtual void emitCompareGe() = 0;
+    // dst = (left cc right) ? 1 : 0
+    virtual void emitCompare(CondCode cc, Operand dst, Operand left, Operand right) = 0;
 
-    // Logical operations
-    virtual void emitAnd() = 0;
-    virtual void emitOr() = 0;
-    virtual void emitNot() = 0;
-    virtual void emitNeg() = 0;
+    // dst = !src, dst = -src
+    virtual void emitNot(Operand dst, Operand src) = 0;
+    virtual void emitNeg(Operand dst, Operand src) = 0;
 
     // Control flow
     virtual Label createLabel() = 0;
     virtual void bindLabel(Label& label) = 0;
     virtual void emitJump(Label& label) = 0;
-    virtual void emitJumpIfFalse(Label& label) = 0;
-    virtual void emitJumpIfTrue(Label& label) = 0;
-
-    // Function calls
-    virtual void emitCallRuntime(void* funcPtr, int argCount) = 0;
-    virtual void emitReturn() = 0;
-
-    // String literal - returns the address where string is stored
-    virtual void emitLoadStringPtr(const char* str) = 0;
-
-    // Prepare args for function call
-    virtual void emitPrepareCallArgs(int argCount) = 0;
-    virtual void emitSetCallArg(int argIndex) = 0;
+    virtual void emitJumpIfFalse(Operand cond, Label& label) = 0;
+    virtual void emitJumpIfTrue(Operand cond, Label& label) = 0;
+
+    // Runtime calls (C ABI): set argument registers, then call. Returns
+    // the offset of the function address, for patchAddress.
+    virtual void emitSetCallArg(int argIndex, Operand src) = 0;
+    virtual size_t emitCallRuntime(void* funcPtr, int argCount) = 0;
+
+    // dst = an address, always in the same form so that patchAddress can
+    // change it later; returns its offset
+    virtual size_t emitMoveAddress(Operand dst, uint64_t address) = 0;
+
+    // dst = result of the preceding call, and the type tag returned with it
+    // (second return register); both must directly follow the call
+    virtual void emitGetResult(Operand dst) = 0;
+    virtual void emitGetResultType(Operand dst) = 0;
+
+    // Return a value and its type tag from the function (emits the epilogue)
+    virtual void emitReturn(Operand value, Operand type) = 0;
+
+    // dst = the word at address + offset, and the other way round
+    virtual void emitLoad(Operand dst, Operand address, int offset) = 0;
+    virtual void emitStore(Operand address, int offset, Operand src) = 0;
+
+    // Direct calls between compiled functions. Arguments are stored into a
+    // per-call area on the machine stack, which is passed as the args array.
+    virtual void emitAllocCallArgs(int argCount) = 0;
+    virtual void emitStoreCallArg(int argIndex, Operand src) = 0;
+    // Returns the offset of the patchable call instruction
+    virtual size_t emitCallDirect(int argCount) = 0;
+    // Point a direct call at an offset inside the current buffer
+    virtual void bindCallDirect(size_t callOffset, size_t targetOffset) = 0;
+
+    // Tail calls: the arguments go over the function's own incoming ones
+    // (the array outlives the frame, and holds at least as many), the
+    // frame is torn down and the callee is jumped to, returning straight
+    // to this function's caller. The jump is bound and patched like a
+    // direct call; its offset is returned.
+    virtual void emitLoadTailCallArea(Operand area) = 0;
+    virtual void emitStoreTailCallArg(int argIndex, Operand src) = 0;
+    virtual size_t emitTailCallDirect(int argCount) = 0;
+
+    // Range-extension stub for a direct call: passes 'info' as the third
+    // argument and jumps to an absolute target. Returns the stub offset.
+    virtual size_t emitCallVeneer(void* info, void* target) = 0;
+
+    // Patch already-placed executable code. patchCallSite returns false if
+    // the target is out of range of a direct call instruction.
+    virtual bool patchCallSite(uint8_t* site, void* target) = 0;
+    virtual void patchCallVeneer(uint8_t* veneer, void* target) = 0;
+    virtual void patchCallVeneerInfo(uint8_t* veneer, void* info) = 0;
+
+    // Change an address emitted by emitMoveAddress or emitCallRuntime, in
+    // code that is not running
+    virtual void patchAddress(uint8_t* at, uint64_t address) = 0;
 
 protected:
     std::vector<uint8_t> code;
@@ -133,6 +200,42 @@ protected:
         emit32((value >> 32) & 0xFFFFFFFF);
     }
 
+    // Peephole window: what the instructions just emitted left behind, for
+    // the next ones to reuse rather than recompute. A fact holds only while
+    // the code still ends where it was noted, so emitting anything else ends
+    // it; so does binding a label there, since code jumping to it has not
+    // run those instructions.
+    struct StoredFact {
+        size_t end = SIZE_MAX;
+        Operand slot = Operand::slot(0);
+        int reg = 0;
+    };
+    struct ComparedFact {
+        size_t end = SIZE_MAX;
+        Operand dst = Operand::slot(0);
+        CondCode cc = CondCode::EQ;
+    };
+    StoredFact lastStore;      // reg was just stored to spill slot
+    ComparedFact lastCompare;  // the flags still hold the comparison dst was set from
+
+    void noteStore(Operand slot, int reg) { lastStore = {code.size(), slot, reg}; }
+    void noteCompare(Operand dst, CondCode cc) { lastCompare = {code.size(), dst, cc}; }
+    void forgetEmitted() { lastStore.end = lastCompare.end = SIZE_MAX; }
+
+    // The register that still holds what is in a spill slot, or -1
+    int storedReg(Operand slot) const {
+        return lastStore.end == code.size() && lastStore.slot == slot ? lastStore.reg : -1;
+    }
+    // Whether the flags tell if cond is true: it holds exactly when cc does
+    bool flagsHold(Operand cond, CondCode& cc) const {
+        if (lastCompare.end != code.size() || lastCompare.dst != cond) return false;
+        cc = lastCompare.cc;
+        return true;
+    }
+
+    // Bytes reserved for the per-call argument area (keeps 16-byte alignment)
+    static int callArgsSize(int argCount) { return ((argCount * 8) + 15) & ~15; }
+
     void patch32(size_t offset, int32_t value) {
         code[offset] = value & 0xFF;
         code[offset + 1] = (value >> 8) & 0xFF;
@@ -144,53 +247,53 @@ protected:
 // x86-64 code generator (System V AMD64 ABI)
 class X86_64CodeGen : public CodeGenerator {
 public:
-    void emitPrologue(int localCount) override;
-    void emitEpilogue() override;
-
-    void emitLoadImmediate(long long value) override;
-    void emitLoadBool(bool value) override;
-
-    void emitLoadLocal(int offset) override;
-    void emitStoreLocal(int offset) override;
-    void emitLoadArg(int argIndex) override;
+    int allocatableRegCount() const override { return 5; }
 
-    void emitPush() override;
-    void emitPop() override;
-
-    void emitAdd() override;
-    void emitSub() override;
-    void emitMul() override;
-    void emitDiv() override;
-    void emitMod() override;
-
-    void emitCompareEq() override;
-    void emitCompareNe() override;
-    void emitCompareLt() override;
-    void emitCompareLe() override;
-    void emitCompareGt() override;
-    void emitCompareGe() override;
+    void emitPrologue(int spillSlots, int savedRegs) override;
+    void emitEpilogue() override;
 
-    void emitAnd() override;
-    void emitOr() override;
-    void emitNot() override;
-    void emitNeg() override;
+    void emitMove(Operand dst, Operand src) override;
+    void emitLoadArg(Operand dst, int argIndex) override;
+    void emitLoadArgs(Operand dst) override;
+    void emitBinary(ALUOp op, Operand dst, Operand left, Operand right) override;
+    void emitCompare(CondCode cc, Operand dst, Operand left, Operand right) override;
+    void emitNot(Operand dst, Operand src) override;
+    void emitNeg(Operand dst, Operand src) override;
 
     Label createLabel() override;
     void bindLabel(Label& label) override;
     void emitJump(Label& label) override;
-    void emitJumpIfFalse(Label& label) override;
-    void emitJumpIfTrue(Label& label) override;
-
-    void emitCallRuntime(void* funcPtr, int argCount) override;
-    void emitReturn() override;
-
-    void emitLoadStringPtr(const char* str) override;
-    void emitPrepareCallArgs(int argCount) override;
-    void emitSetCallArg(int argIndex) override;
+    void emitJumpIfFalse(Operand cond, Label& label) override;
+    void emitJumpIfTrue(Operand cond, Label& label) override;
+
+    void emitSetCallArg(int argIndex, Operand src) override;
+    size_t emitCallRuntime(void* funcPtr, int argCount) override;
+    size_t emitMoveAddress(Operand dst, uint64_t address) override;
+    void emitGetResult(Operand dst) override;
+    void emitGetResultType(Operand dst) override;
+    void emitReturn(Operand value, Operand type) override;
+    void emitLoad(Operand dst, Operand address, int offset) override;
+    void emitStore(Operand address, int offset, Operand src) override;
+
+    void emitAllocCallArgs(int argCount) override;
+    void emitStoreCallArg(int argIndex, Operand src) override;
+    size_t emitCallDirect(int argCount) override;
+    void bindCallDirect(size_t callOffset, size_t targetOffset) override;
+    void emitLoadTailCallArea(Operand area) override;
+    void emitStoreTailCallArg(int argIndex, Operand src) override;
+    size_t emitTailCallDirect(int argCount) override;
+    size_t emitCallVeneer(void* info, void* target) override;
+    bool patchCallSite(uint8_t* site, void* target) override;
+    void patchCallVeneer(uint8_t* veneer, void* target) override;
+    void patchCallVeneerInfo(uint8_t* veneer, void* info) override;
+    void patchAddress(uint8_t* at, uint64_t address) override;
 
 private:
     int frameSize = 0;
-    int localSlots = 0;
+    int savedRegCount = 0;
+
+    // Epilogue up to, not including, the return
+    void emitFrameTeardown();
 
     // REX prefixes
     static constexpr uint8_t REX_W = 0x48;      // 64-bit operand size
@@ -200,8 +303,28 @@ private:
 
     void emitMovReg64Imm(int reg, uint64_t imm);
     void emitMovRegReg(int dst, int src);
-    void emitMovFromStack(int reg, int offset);
-    void emitMovToStack(int offset, int reg);
+
+    // Immediate forms: 'op reg, imm' for the group 1 ALU ops (add /0,
+    // sub /5, cmp /7), and 'imul reg, reg, imm'
+    void emitAluRegImm(int ext, int reg, int32_t imm);
+    void emitImulRegImm(int reg, int32_t imm);
+
+    // REX.W-prefixed 'opcode reg, r/m' with a register or [base + disp] r/m
+    void emitOpRegReg(const std::vector<uint8_t>& opcode, int reg, int rm);
+    void emitOpRegMem(const std::vector<uint8_t>& opcode, int reg, int base, int disp);
+    void emitOpRegOperand(const std::vector<uint8_t>& opcode, int reg, Operand op);
+
+    // Operand access through scratch registers
+    int physReg(Operand op) const;
+    int slotOffset(Operand op) const;
+    int loadOperand(Operand op, int scratch);
+    void loadOperandInto(int reg, Operand op);
+    void storeOperand(Operand dst, int reg);
+    void emitSetCC(CondCode cc);
+
+    // jcc / jmp to a label, rel32
+    void emitJumpIf(CondCode cc, Label& label);
+    void emitLabelOffset(Label& label);
 
     // Register encoding
     static constexpr int RAX = 0;
@@ -216,77 +339,103 @@ private:
     static constexpr int R9 = 9;
     static constexpr int R10 = 10;
     static constexpr int R11 = 11;
+    static constexpr int R12 = 12;
+    static constexpr int R13 = 13;
+    static constexpr int R14 = 14;
+    static constexpr int R15 = 15;
 };
 
 // ARM64 code generator (AAPCS64)
 class ARM64CodeGen : public CodeGenerator {
 public:
-    void emitPrologue(int localCount) override;
-    void emitEpilogue() override;
-
-    void emitLoadImmediate(long long value) override;
-    void emitLoadBool(bool value) override;
-
-    void emitLoadLocal(int offset) override;
-    void emitStoreLocal(int offset) override;
-    void emitLoadArg(int argIndex) override;
-
-    void emitPush() override;
-    void emitPop() override;
-
-    void emitAdd() override;
-    void emitSub() override;
-    void emitMul() override;
-    void emitDiv() override;
-    void emitMod() override;
+    int allocatableRegCount() const override { return 10; }
 
-    void emitCompareEq() override;
-    void emitCompareNe() override;
-    void emitCompareLt() override;
-    void emitCompareLe() override;
-    void emitCompareGt() override;
-    void emitCompareGe() override;
+    void emitPrologue(int spillSlots, int savedRegs) override;
+    void emitEpilogue() override;
 
-    void emitAnd() override;
-    void emitOr() override;
-    void emitNot() override;
-    void emitNeg() override;
+    void emitMove(Operand dst, Operand src) override;
+    void emitLoadArg(Operand dst, int argIndex) override;
+    void emitLoadArgs(Operand dst) override;
+    void emitBinary(ALUOp op, Operand dst, Operand left, Operand right) override;
+    void emitCompare(CondCode cc, Operand dst, Operand left, Operand right) override;
+    void emitNot(Operand dst, Operand src) override;
+    void emitNeg(Operand dst, Operand src) override;
 
     Label createLabel() override;
     void bindLabel(Label& label) override;
     void emitJump(Label& label) override;
-    void emitJumpIfFalse(Label& label) override;
-    void emitJumpIfTrue(Label& label) override;
-
-    void emitCallRuntime(void* funcPtr, int argCount) override;
-    void emitReturn() override;
-
-    void emitLoadStringPtr(const char* str) override;
-    void emitPrepareCallArgs(int argCount) override;
-    void emitSetCallArg(int argIndex) override;
+    void emitJumpIfFalse(Operand cond, Label& label) override;
+    void emitJumpIfTrue(Operand cond, Label& label) override;
+
+    void emitSetCallArg(int argIndex, Operand src) override;
+    size_t emitCallRuntime(void* funcPtr, int argCount) override;
+    size_t emitMoveAddress(Operand dst, uint64_t address) override;
+    void emitGetResult(Operand dst) override;
+    void emitGetResultType(Operand dst) override;
+    void emitReturn(Operand value, Operand type) override;
+    void emitLoad(Operand dst, Operand address, int offset) override;
+    void emitStore(Operand address, int offset, Operand src) override;
+
+    void emitAllocCallArgs(int argCount) override;
+    void emitStoreCallArg(int argIndex, Operand src) override;
+    size_t emitCallDirect(int argCount) override;
+    void bindCallDirect(size_t callOffset, size_t targetOffset) override;
+    void emitLoadTailCallArea(Operand area) override;
+    void emitStoreTailCallArg(int argIndex, Operand src) override;
+    size_t emitTailCallDirect(int argCount) override;
+    size_t emitCallVeneer(void* info, void* target) override;
+    bool patchCallSite(uint8_t* site, void* target) override;
+    void patchCallVeneer(uint8_t* veneer, void* target) override;
+    void patchCallVeneerInfo(uint8_t* veneer, void* info) override;
+    void patchAddress(uint8_t* at, uint64_t address) override;
 
 private:
     int frameSize = 0;
-    int localSlots = 0;
+    int savedRegCount = 0;
+
+    // Epilogue up to, not including, the return
+    void emitFrameTeardown();
 
     // ARM64 instruction encoding helpers
     void emitInstruction(uint32_t insn);
     void emitMovImm64(int reg, uint64_t imm);
+    void emitMovAddress(int reg, uint64_t address);
+    void emitLoadImm(int reg, long long value);
     void emitLdrOffset(int rt, int rn, int offset);
     void emitStrOffset(int rt, int rn, int offset);
+    void emitMovReg(int dst, int src);
+    void emitBranchOnZero(bool nonZero, int reg, Label& label);
+    void emitBranchIf(CondCode cc, Label& label);
+    // add d, n, #imm or sub d, n, #-imm, for |imm| <= 4095
+    void emitAddImm(int d, int n, long long imm);
+
+    // Operand access through scratch registers
+    int physReg(Operand op) const;
+    int slotOffset(Operand op) const;
+    int loadOperand(Operand op, int scratch);
+    void storeOperand(Operand dst, int reg);
+    int destReg(Operand dst, int scratch) const;
+    // Register holding address + offset, less what is left in offset
+    int addressReg(Operand address, int& offset);
 
     // Register usage:
-    // x0-x7: arguments / return value
-    // x9: secondary register for binary ops
-    // x19-x28: callee-saved (we use x19 for our temp)
+    // x0-x7: arguments / return value (x1: its type tag)
+    // x9-x11: scratch for operands in spill slots or immediates
+    // x16: veneer / runtime call target; offsets of far loads and stores
+    // x19-x28: allocatable (callee-saved)
     // x29: frame pointer
     // x30: link register
     static constexpr int X0 = 0;
+    static constexpr int X1 = 1;
     static constexpr int X9 = 9;
+    static constexpr int X10 = 10;
+    static constexpr int X11 = 11;
+    static constexpr int X16 = 16;
     static constexpr int X19 = 19;
     static constexpr int X29 = 29;
     static constexpr int X30 = 30;
     static constexpr int SP = 31;
+    static constexpr int XZR = 31;
 };
 
 // Factory function to create appropriate code generator
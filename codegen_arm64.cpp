@@ -4,19 +4,22 @@
 
 // ARM64 Implementation (AAPCS64)
 // Result register: X0
-// Secondary register: X9 (caller-saved)
-// Arg registers: X0-X7
-// Callee-saved: X19-X28
+// Allocatable registers: X19-X28 (callee-saved)
+// Scratch registers: X9-X11, X16 (call target, far load/store offsets)
+// Arg registers: X0-X7 (X0 = args array on entry)
 // Frame pointer: X29
 // Link register: X30
 // Stack pointer: SP (X31 context-dependent)
 //
-// Stack frame layout (growing down):
-//   [FP+8] = saved LR (X30)
-//   [FP]   = saved FP (X29)
-//   [FP-8] = local0
-//   [FP-16] = local1
+// Stack frame layout (FP == SP at statement boundaries):
+//   [FP+16+8*saved+8*n] = spill slot n
 //   ...
+//   [FP+16+8*k] = saved allocatable register k
+//   [FP+8]  = saved LR (X30)
+//   [FP]    = saved FP (X29)
+//
+// Everything lives inside the allocated frame: AAPCS64 has no red zone,
+// so anything below SP may be clobbered by call argument areas.
 
 void ARM64CodeGen::emitInstruction(uint32_t insn) {
     emit(insn & 0xFF);
@@ -25,49 +28,74 @@ void ARM64CodeGen::emitInstruction(uint32_t insn) {
     emit((insn >> 24) & 0xFF);
 }
 
-void ARM64CodeGen::emitPrologue(int localCount) {
-    localSlots = localCount;
+void ARM64CodeGen::emitPrologue(int spillSlots, int savedRegs) {
+    savedRegCount = savedRegs;
 
-    // Calculate frame size (locals + saved registers, 16-byte aligned)
-    frameSize = ((localCount * 8 + 32) + 15) & ~15;
+    // Calculate frame size (FP/LR + saved registers + spills, 16-byte aligned)
+    frameSize = ((16 + savedRegs * 8 + spillSlots * 8) + 15) & ~15;
+    if (frameSize > 4095) {
+        throw std::runtime_error("Too many spill slots for ARM64 frame");
+    }
 
-    // stp x29, x30, [sp, #-frameSize]!  ; pre-index store pair, allocate frame
-    uint32_t stp_offset = ((-frameSize) >> 3) & 0x7F;
-    emitInstruction(0xA9800000 | (stp_offset << 15) | (30 << 10) | (31 << 5) | 29);
+    if (frameSize <= 504) {
+        // stp x29, x30, [sp, #-frameSize]!  ; pre-index store pair, allocate frame
+        uint32_t stp_offset = ((-frameSize) >> 3) & 0x7F;
+        emitInstruction(0xA9800000 | (stp_offset << 15) | (30 << 10) | (31 << 5) | 29);
+    } else {
+        // sub sp, sp, #frameSize
+        emitInstruction(0xD10003FF | (frameSize << 10));
+        // stp x29, x30, [sp]
+        emitInstruction(0xA9007BFD);
+    }
 
     // mov x29, sp  ; set frame pointer
     emitInstruction(0x910003FD);
 
-    // Save x19 (we use it as temp)
-    // str x19, [sp, #16]
-    emitInstruction(0xF9000800 | (31 << 5) | 19);
-
-    // Save arg pointer (x0 = args array) to x19
-    // mov x19, x0
-    emitInstruction(0xAA0003F3);
-
-    // Initialize locals to 0
-    for (int i = 0; i < localCount; i++) {
-        // str xzr, [x29, #-(8*(i+1))]
-        int offset = -(8 * (i + 1));
-        // Need to use stur for negative offsets
-        emitInstruction(0xF8000000 | ((offset & 0x1FF) << 12) | (29 << 5) | 31);
+    // Save the callee-saved registers we allocate
+    for (int i = 0; i < savedRegs; i++) {
+        // str x(19+i), [x29, #(16 + 8*i)]
+        emitStrOffset(X19 + i, X29, 16 + 8 * i);
     }
 }
 
 void ARM64CodeGen::emitEpilogue() {
-    // Restore x19
-    // ldr x19, [sp, #16]
-    emitInstruction(0xF9400800 | (31 << 5) | 19);
-
-    // ldp x29, x30, [sp], #frameSize  ; post-index load pair, deallocate frame
-    uint32_t ldp_offset = (frameSize >> 3) & 0x7F;
-    emitInstruction(0xA8C00000 | (ldp_offset << 15) | (30 << 10) | (31 << 5) | 29);
+    emitFrameTeardown();
 
     // ret
     emitInstruction(0xD65F03C0);
 }
 
+void ARM64CodeGen::emitFrameTeardown() {
+    // mov sp, x29  ; drop any pending call areas
+    emitInstruction(0x910003BF);
+
+    // Restore callee-saved registers
+    for (int i = 0; i < savedRegCount; i++) {
+        // ldr x(19+i), [x29, #(16 + 8*i)]
+        emitLdrOffset(X19 + i, X29, 16 + 8 * i);
+    }
+
+    if (frameSize <= 504) {
+        // ldp x29, x30, [sp], #frameSize  ; post-index load pair, deallocate frame
+        uint32_t ldp_offset = (frameSize >> 3) & 0x7F;
+        emitInstruction(0xA8C00000 | (ldp_offset << 15) | (30 << 10) | (31 << 5) | 29);
+    } else {
+        // ldp x29, x30, [sp]
+        emitInstruction(0xA9407BFD);
+        // add sp, sp, #frameSize
+        emitInstruction(0x910003FF | (frameSize << 10));
+    }
+}
+
+void ARM64CodeGen::emitMovAddress(int reg, uint64_t address) {
+    // movz, then movk for each remaining halfword, even if zero, so the
+    // sequence has a fixed length
+    emitInstruction(0xD2800000 | ((address & 0xFFFF) << 5) | reg);
+    for (int shift = 1; shift < 4; shift++) {
+        emitInstruction(0xF2800000 | (shift << 21) | (((address >> (16 * shift)) & 0xFFFF) << 5) | reg);
+    }
+}
+
 void ARM64CodeGen::emitMovImm64(int reg, uint64_t imm) {
     // movz reg, #imm16, lsl #0
     emitInstruction(0xD2800000 | ((imm & 0xFFFF) << 5) | reg);
@@ -86,14 +114,31 @@ void ARM64CodeGen::emitMovImm64(int reg, uint64_t imm) {
     }
 }
 
+void ARM64CodeGen::emitLoadImm(int reg, long long value) {
+    if (value >= 0 && value <= 0xFFFF) {
+        // movz reg, #value
+        emitInstruction(0xD2800000 | ((value & 0xFFFF) << 5) | reg);
+    } else if (value < 0 && value >= -0x10000) {
+        // movn reg, #~value
+        uint16_t notVal = ~value;
+        emitInstruction(0x92800000 | (notVal << 5) | reg);
+    } else {
+        emitMovImm64(reg, (uint64_t)value);
+    }
+}
+
 void ARM64CodeGen::emitLdrOffset(int rt, int rn, int offset) {
     if (offset >= 0 && offset < 32768 && (offset & 7) == 0) {
         // ldr rt, [rn, #offset] - scaled offset
         uint32_t imm12 = offset >> 3;
         emitInstruction(0xF9400000 | (imm12 << 10) | (rn << 5) | rt);
-    } else {
+    } else if (offset >= -256 && offset < 256) {
         // ldur rt, [rn, #offset] - unscaled offset
         emitInstruction(0xF8400000 | ((offset & 0x1FF) << 12) | (rn << 5) | rt);
+    } else {
+        // ldr rt, [rn, x16] - beyond both, e.g. the frame of a loop entry
+        emitLoadImm(X16, offset);
+        emitInstruction(0xF8606800 | (X16 << 16) | (rn << 5) | rt);
     }
 }
 
@@ -102,164 +147,209 @@ void ARM64CodeGen::emitStrOffset(int rt, int rn, int offset) {
         // str rt, [rn, #offset] - scaled offset
         uint32_t imm12 = offset >> 3;
         emitInstruction(0xF9000000 | (imm12 << 10) | (rn << 5) | rt);
-    } else {
+    } else if (offset >= -256 && offset < 256) {
         // stur rt, [rn, #offset] - unscaled offset
         emitInstruction(0xF8000000 | ((offset & 0x1FF) << 12) | (rn << 5) | rt);
-    }
-}
-
-void ARM64CodeGen::emitLoadImmediate(long long value) {
-    if (value >= 0 && value <= 0xFFFF) {
-        // movz x0, #value
-        emitInstruction(0xD2800000 | ((value & 0xFFFF) << 5) | X0);
-    } else if (value < 0 && value >= -0x10000) {
-        // movn x0, #~value
-        uint16_t notVal = ~value;
-        emitInstruction(0x92800000 | (notVal << 5) | X0);
     } else {
-        emitMovImm64(X0, (uint64_t)value);
+        // str rt, [rn, x16]
+        emitLoadImm(X16, offset);
+        emitInstruction(0xF8206800 | (X16 << 16) | (rn << 5) | rt);
     }
 }
 
-void ARM64CodeGen::emitLoadBool(bool value) {
-    // movz x0, #0 or #1
-    emitInstruction(0xD2800000 | ((value ? 1 : 0) << 5) | X0);
-}
-
-void ARM64CodeGen::emitLoadLocal(int offset) {
-    // ldr x0, [x29, #-(8*(offset+1))]
-    int stackOffset = -(8 * (offset + 1));
-    emitLdrOffset(X0, X29, stackOffset);
+void ARM64CodeGen::emitMovReg(int dst, int src) {
+    if (dst == src) return;
+    // mov dst, src  (orr dst, xzr, src)
+    emitInstruction(0xAA0003E0 | (src << 16) | dst);
 }
 
-void ARM64CodeGen::emitStoreLocal(int offset) {
-    // str x0, [x29, #-(8*(offset+1))]
-    int stackOffset = -(8 * (offset + 1));
-    emitStrOffset(X0, X29, stackOffset);
+int ARM64CodeGen::physReg(Operand op) const {
+    return X19 + (int)op.value;
 }
 
-void ARM64CodeGen::emitLoadArg(int argIndex) {
-    // Args passed as array in x19
-    // ldr x0, [x19, #argIndex*8]
-    int offset = argIndex * 8;
-    emitLdrOffset(X0, X19, offset);
+int ARM64CodeGen::slotOffset(Operand op) const {
+    return 16 + 8 * savedRegCount + 8 * (int)op.value;
 }
 
-void ARM64CodeGen::emitPush() {
-    // str x0, [sp, #-16]!
-    emitInstruction(0xF81F0FE0);
-}
-
-void ARM64CodeGen::emitPop() {
-    // ldr x9, [sp], #16
-    emitInstruction(0xF8410FE9);
-}
-
-void ARM64CodeGen::emitAdd() {
-    // add x0, x9, x0
-    emitInstruction(0x8B000120);
-}
-
-void ARM64CodeGen::emitSub() {
-    // sub x0, x9, x0
-    emitInstruction(0xCB000120);
+// Get the operand into a register: allocated registers are used as-is,
+// everything else is loaded into 'scratch'
+int ARM64CodeGen::loadOperand(Operand op, int scratch) {
+    if (op.isReg()) return physReg(op);
+    if (op.isSlot()) {
+        // Not reloaded straight after a store to it
+        int stored = storedReg(op);
+        if (stored >= 0) {
+            emitMovReg(scratch, stored);
+        } else {
+            emitLdrOffset(scratch, X29, slotOffset(op));
+        }
+    } else {
+        emitLoadImm(scratch, op.value);
+    }
+    return scratch;
 }
 
-void ARM64CodeGen::emitMul() {
-    // mul x0, x9, x0
-    emitInstruction(0x9B007D20);
+void ARM64CodeGen::storeOperand(Operand dst, int reg) {
+    if (dst.isReg()) {
+        emitMovReg(physReg(dst), reg);
+    } else if (dst.isSlot()) {
+        emitStrOffset(reg, X29, slotOffset(dst));
+        noteStore(dst, reg);
+    } else {
+        throw std::runtime_error("Cannot store to an immediate operand");
+    }
 }
 
-void ARM64CodeGen::emitDiv() {
-    // sdiv x0, x9, x0
-    emitInstruction(0x9AC00D20);
+// Register to compute a result into before storing it to dst
+int ARM64CodeGen::destReg(Operand dst, int scratch) const {
+    return dst.isReg() ? physReg(dst) : scratch;
 }
 
-void ARM64CodeGen::emitMod() {
-    // sdiv x10, x9, x0
-    emitInstruction(0x9AC00D2A);
-    // msub x0, x10, x0, x9  ; x0 = x9 - x10 * x0
-    emitInstruction(0x9B008140);
+void ARM64CodeGen::emitMove(Operand dst, Operand src) {
+    if (dst == src) return;
+    if (dst.isReg() && src.isImm()) {
+        emitLoadImm(physReg(dst), src.value);
+        return;
+    }
+    storeOperand(dst, loadOperand(src, X9));
 }
 
-void ARM64CodeGen::emitCompareEq() {
-    // cmp x9, x0
-    emitInstruction(0xEB00013F);
-    // cset x0, eq
-    emitInstruction(0x9A9F17E0);
+void ARM64CodeGen::emitLoadArg(Operand dst, int argIndex) {
+    // Args passed as array in x0: ldr reg, [x0, #argIndex*8]
+    int reg = destReg(dst, X9);
+    emitLdrOffset(reg, X0, argIndex * 8);
+    storeOperand(dst, reg);
 }
 
-void ARM64CodeGen::emitCompareNe() {
-    // cmp x9, x0
-    emitInstruction(0xEB00013F);
-    // cset x0, ne
-    emitInstruction(0x9A9F07E0);
+void ARM64CodeGen::emitLoadArgs(Operand dst) {
+    storeOperand(dst, X0);
 }
 
-void ARM64CodeGen::emitCompareLt() {
-    // cmp x9, x0
-    emitInstruction(0xEB00013F);
-    // cset x0, lt
-    emitInstruction(0x9A9FA7E0);
+// Whether an operand fits the 12-bit immediate of add/sub/cmp, either sign
+static bool isArithImm(Operand op) {
+    return op.isImm() && op.value > -4096 && op.value < 4096;
 }
 
-void ARM64CodeGen::emitCompareLe() {
-    // cmp x9, x0
-    emitInstruction(0xEB00013F);
-    // cset x0, le
-    emitInstruction(0x9A9FC7E0);
+void ARM64CodeGen::emitAddImm(int d, int n, long long imm) {
+    if (imm >= 0) {
+        // add d, n, #imm
+        emitInstruction(0x91000000 | ((uint32_t)imm << 10) | (n << 5) | d);
+    } else {
+        // sub d, n, #-imm
+        emitInstruction(0xD1000000 | ((uint32_t)-imm << 10) | (n << 5) | d);
+    }
 }
 
-void ARM64CodeGen::emitCompareGt() {
-    // cmp x9, x0
-    emitInstruction(0xEB00013F);
-    // cset x0, gt
-    emitInstruction(0x9A9FC7E0 ^ 0x1000);  // Flip condition
-}
+void ARM64CodeGen::emitBinary(ALUOp op, Operand dst, Operand left, Operand right) {
+    if ((op == ALUOp::ADD || op == ALUOp::SUB) && isArithImm(right)) {
+        int l = loadOperand(left, X9);
+        int d = destReg(dst, X11);
+        emitAddImm(d, l, op == ALUOp::ADD ? right.value : -right.value);
+        storeOperand(dst, d);
+        return;
+    }
 
-void ARM64CodeGen::emitCompareGe() {
-    // cmp x9, x0
-    emitInstruction(0xEB00013F);
-    // cset x0, ge
-    emitInstruction(0x9A9FA7E0 ^ 0x1000);  // Flip condition
+    int l = loadOperand(left, X9);
+    int r = loadOperand(right, X10);
+    int d = destReg(dst, X11);
+
+    switch (op) {
+        case ALUOp::ADD:
+            // add d, l, r
+            emitInstruction(0x8B000000 | (r << 16) | (l << 5) | d);
+            break;
+        case ALUOp::SUB:
+            // sub d, l, r
+            emitInstruction(0xCB000000 | (r << 16) | (l << 5) | d);
+            break;
+        case ALUOp::MUL:
+            // mul d, l, r
+            emitInstruction(0x9B007C00 | (r << 16) | (l << 5) | d);
+            break;
+        case ALUOp::DIV:
+            // sdiv d, l, r
+            emitInstruction(0x9AC00C00 | (r << 16) | (l << 5) | d);
+            break;
+        case ALUOp::MOD:
+            // sdiv x11, l, r
+            emitInstruction(0x9AC00C00 | (r << 16) | (l << 5) | X11);
+            // msub d, x11, r, l  ; d = l - x11 * r
+            emitInstruction(0x9B008000 | (r << 16) | (l << 10) | (X11 << 5) | d);
+            break;
+        case ALUOp::AND:
+        case ALUOp::OR:
+            // cmp l, #0
+            emitInstruction(0xF100001F | (l << 5));
+            // cset x9, ne
+            emitInstruction(0x9A9F07E0 | (0 << 12) | X9);
+            // cmp r, #0
+            emitInstruction(0xF100001F | (r << 5));
+            // cset x10, ne
+            emitInstruction(0x9A9F07E0 | (0 << 12) | X10);
+            if (op == ALUOp::AND) {
+                // and d, x9, x10
+                emitInstruction(0x8A000000 | (X10 << 16) | (X9 << 5) | d);
+            } else {
+                // orr d, x9, x10
+                emitInstruction(0xAA000000 | (X10 << 16) | (X9 << 5) | d);
+            }
+            break;
+    }
+    storeOperand(dst, d);
+}
+
+// The cond field of b.cond and csinc; flipping its low bit inverts it
+static uint32_t conditionCode(CondCode cc) {
+    switch (cc) {
+        case CondCode::EQ: return 0x0; // eq
+        case CondCode::NE: return 0x1; // ne
+        case CondCode::LT: return 0xB; // lt
+        case CondCode::LE: return 0xD; // le
+        case CondCode::GT: return 0xC; // gt
+        default: return 0xA;           // ge
+    }
 }
 
-void ARM64CodeGen::emitAnd() {
-    // cmp x9, #0
-    emitInstruction(0xF100013F);
-    // cset x10, ne
-    emitInstruction(0x9A9F07EA);
-    // cmp x0, #0
-    emitInstruction(0xF100001F);
-    // cset x0, ne
-    emitInstruction(0x9A9F07E0);
-    // and x0, x10, x0
-    emitInstruction(0x8A000140);
-}
+void ARM64CodeGen::emitCompare(CondCode cc, Operand dst, Operand left, Operand right) {
+    int l = loadOperand(left, X9);
+    if (isArithImm(right)) {
+        if (right.value >= 0) {
+            // cmp l, #imm
+            emitInstruction(0xF100001F | ((uint32_t)right.value << 10) | (l << 5));
+        } else {
+            // cmn l, #-imm
+            emitInstruction(0xB100001F | ((uint32_t)-right.value << 10) | (l << 5));
+        }
+    } else {
+        int r = loadOperand(right, X10);
+        // cmp l, r
+        emitInstruction(0xEB00001F | (r << 16) | (l << 5));
+    }
+    int d = destReg(dst, X11);
 
-void ARM64CodeGen::emitOr() {
-    // cmp x9, #0
-    emitInstruction(0xF100013F);
-    // cset x10, ne
-    emitInstruction(0x9A9F07EA);
-    // cmp x0, #0
-    emitInstruction(0xF100001F);
-    // cset x0, ne
-    emitInstruction(0x9A9F07E0);
-    // orr x0, x10, x0
-    emitInstruction(0xAA000140);
+    // cset d, cc  (csinc d, xzr, xzr, !cc)
+    emitInstruction(0x9A9F07E0 | ((conditionCode(cc) ^ 1) << 12) | d);
+    storeOperand(dst, d);
+    // Neither touched the flags, so a branch on dst next can use them
+    noteCompare(dst, cc);
 }
 
-void ARM64CodeGen::emitNot() {
-    // cmp x0, #0
-    emitInstruction(0xF100001F);
-    // cset x0, eq
-    emitInstruction(0x9A9F17E0);
+void ARM64CodeGen::emitNot(Operand dst, Operand src) {
+    int s = loadOperand(src, X9);
+    int d = destReg(dst, X11);
+    // cmp s, #0
+    emitInstruction(0xF100001F | (s << 5));
+    // cset d, eq
+    emitInstruction(0x9A9F17E0 | d);
+    storeOperand(dst, d);
 }
 
-void ARM64CodeGen::emitNeg() {
-    // neg x0, x0
-    emitInstruction(0xCB0003E0);
+void ARM64CodeGen::emitNeg(Operand dst, Operand src) {
+    int s = loadOperand(src, X9);
+    int d = destReg(dst, X11);
+    // neg d, s
+    emitInstruction(0xCB0003E0 | (s << 16) | d);
+    storeOperand(dst, d);
 }
 
 Label ARM64CodeGen::createLabel() {
@@ -272,6 +362,7 @@ Label ARM64CodeGen::createLabel() {
 void ARM64CodeGen::bindLabel(Label& label) {
     label.offset = code.size();
     label.bound = true;
+    forgetEmitted();
 
     // Fix up pending references
     for (size_t fixupOffset : label.pendingFixups) {
@@ -288,6 +379,9 @@ void ARM64CodeGen::bindLabel(Label& label) {
         } else if ((insn & 0xFF000010) == 0x54000000) {
             // Conditional branch (B.cond)
             insn = (insn & 0xFF00001F) | ((rel & 0x7FFFF) << 5);
+        } else if ((insn & 0x7E000000) == 0x34000000) {
+            // Compare and branch (CBZ/CBNZ)
+            insn = (insn & 0xFF00001F) | ((rel & 0x7FFFF) << 5);
         }
 
         code[fixupOffset] = insn & 0xFF;
@@ -309,53 +403,234 @@ void ARM64CodeGen::emitJump(Label& label) {
     }
 }
 
-void ARM64CodeGen::emitJumpIfFalse(Label& label) {
-    // cbz x0, label  (branch if x0 == 0)
+void ARM64CodeGen::emitBranchOnZero(bool nonZero, int reg, Label& label) {
+    // cbz/cbnz reg, label
+    uint32_t opcode = nonZero ? 0xB5000000 : 0xB4000000;
     if (label.bound) {
         int32_t rel = (int32_t)(label.offset - code.size()) >> 2;
-        emitInstruction(0xB4000000 | ((rel & 0x7FFFF) << 5) | X0);
+        emitInstruction(opcode | ((rel & 0x7FFFF) << 5) | reg);
     } else {
         label.pendingFixups.push_back(code.size());
-        emitInstruction(0xB4000000 | X0); // placeholder
+        emitInstruction(opcode | reg); // placeholder
     }
 }
 
-void ARM64CodeGen::emitJumpIfTrue(Label& label) {
-    // cbnz x0, label  (branch if x0 != 0)
+void ARM64CodeGen::emitBranchIf(CondCode cc, Label& label) {
+    // b.cc label
+    uint32_t opcode = 0x54000000 | conditionCode(cc);
     if (label.bound) {
         int32_t rel = (int32_t)(label.offset - code.size()) >> 2;
-        emitInstruction(0xB5000000 | ((rel & 0x7FFFF) << 5) | X0);
+        emitInstruction(opcode | ((rel & 0x7FFFF) << 5));
     } else {
         label.pendingFixups.push_back(code.size());
-        emitInstruction(0xB5000000 | X0); // placeholder
+        emitInstruction(opcode); // placeholder
+    }
+}
+
+void ARM64CodeGen::emitJumpIfFalse(Operand cond, Label& label) {
+    // Straight after the compare that set cond, branch on its flags
+    CondCode cc;
+    if (flagsHold(cond, cc)) {
+        emitBranchIf(inverse(cc), label);
+        return;
     }
+    // cbz reg, label  (branch if reg == 0)
+    emitBranchOnZero(false, loadOperand(cond, X9), label);
+}
+
+void ARM64CodeGen::emitJumpIfTrue(Operand cond, Label& label) {
+    CondCode cc;
+    if (flagsHold(cond, cc)) {
+        emitBranchIf(cc, label);
+        return;
+    }
+    // cbnz reg, label  (branch if reg != 0)
+    emitBranchOnZero(true, loadOperand(cond, X9), label);
+}
+
+void ARM64CodeGen::emitSetCallArg(int argIndex, Operand src) {
+    // Sources are never argument registers, so order does not matter
+    if (argIndex >= 8) {
+        throw std::runtime_error("Too many runtime call arguments");
+    }
+    if (src.isReg()) {
+        emitMovReg(argIndex, physReg(src));
+    } else {
+        loadOperand(src, argIndex);
+    }
+}
+
+size_t ARM64CodeGen::emitCallRuntime(void* funcPtr, int argCount) {
+    // Load function pointer into x16
+    size_t address = code.size();
+    emitMovAddress(X16, (uint64_t)funcPtr);
+    // blr x16
+    emitInstruction(0xD63F0200);
+    return address;
+}
+
+size_t ARM64CodeGen::emitMoveAddress(Operand dst, uint64_t address) {
+    int reg = destReg(dst, X9);
+    size_t offset = code.size();
+    emitMovAddress(reg, address);
+    storeOperand(dst, reg);
+    return offset;
+}
+
+void ARM64CodeGen::emitGetResult(Operand dst) {
+    storeOperand(dst, X0);
 }
 
-void ARM64CodeGen::emitCallRuntime(void* funcPtr, int argCount) {
-    // Load function pointer into x10
-    emitMovImm64(10, (uint64_t)funcPtr);
-    // blr x10
-    emitInstruction(0xD63F0140);
+void ARM64CodeGen::emitGetResultType(Operand dst) {
+    storeOperand(dst, X1);
 }
 
-void ARM64CodeGen::emitReturn() {
+void ARM64CodeGen::emitReturn(Operand value, Operand type) {
+    // x0:x1, as for a two-word struct
+    int reg = loadOperand(type, X1);
+    emitMovReg(X1, reg);
+    reg = loadOperand(value, X0);
+    emitMovReg(X0, reg);
     emitEpilogue();
 }
 
-void ARM64CodeGen::emitLoadStringPtr(const char* str) {
-    emitMovImm64(X0, (uint64_t)str);
+int ARM64CodeGen::addressReg(Operand address, int& offset) {
+    int base = loadOperand(address, X10);
+    if (offset >= 0 && offset < 32768 && (offset & 7) == 0) return base;
+
+    // Beyond the reach of a scaled offset: add x11, base, x11
+    emitLoadImm(X11, offset);
+    emitInstruction(0x8B000000 | (X11 << 16) | (base << 5) | X11);
+    offset = 0;
+    return X11;
 }
 
-void ARM64CodeGen::emitPrepareCallArgs(int argCount) {
-    // Args are set via emitSetCallArg
+void ARM64CodeGen::emitLoad(Operand dst, Operand address, int offset) {
+    int base = addressReg(address, offset);
+    int reg = destReg(dst, X9);
+    emitLdrOffset(reg, base, offset);
+    storeOperand(dst, reg);
 }
 
-void ARM64CodeGen::emitSetCallArg(int argIndex) {
-    if (argIndex < 8) {
-        // mov xN, x0
-        if (argIndex != 0) {
-            emitInstruction(0xAA0003E0 | argIndex);
-        }
+void ARM64CodeGen::emitStore(Operand address, int offset, Operand src) {
+    int base = addressReg(address, offset);
+    emitStrOffset(loadOperand(src, X9), base, offset);
+}
+
+void ARM64CodeGen::emitAllocCallArgs(int argCount) {
+    int size = callArgsSize(argCount);
+    if (size > 4095) {
+        throw std::runtime_error("Too many call arguments for ARM64");
+    }
+    if (size > 0) {
+        // sub sp, sp, #size
+        emitInstruction(0xD10003FF | (size << 10));
+    }
+}
+
+void ARM64CodeGen::emitStoreCallArg(int argIndex, Operand src) {
+    // str reg, [sp, #argIndex*8]
+    emitStrOffset(loadOperand(src, X9), SP, argIndex * 8);
+}
+
+size_t ARM64CodeGen::emitCallDirect(int argCount) {
+    // mov x0, sp  ; args array is the call area
+    emitInstruction(0x910003E0);
+    // mov x1, #argCount
+    emitInstruction(0xD2800000 | ((argCount & 0xFFFF) << 5) | 1);
+
+    // bl (placeholder, bound or patched later)
+    size_t callOffset = code.size();
+    emitInstruction(0x94000000);
+
+    int size = callArgsSize(argCount);
+    if (size > 0) {
+        // add sp, sp, #size
+        emitInstruction(0x910003FF | (size << 10));
+    }
+    return callOffset;
+}
+
+void ARM64CodeGen::bindCallDirect(size_t callOffset, size_t targetOffset) {
+    // bl or b: keep the opcode, fill in imm26
+    int32_t rel = (int32_t)(targetOffset - callOffset) >> 2;
+    uint32_t insn = ((uint32_t)code[callOffset + 3] << 24 & 0xFC000000) | (rel & 0x3FFFFFF);
+    code[callOffset] = insn & 0xFF;
+    code[callOffset + 1] = (insn >> 8) & 0xFF;
+    code[callOffset + 2] = (insn >> 16) & 0xFF;
+    code[callOffset + 3] = (insn >> 24) & 0xFF;
+}
+
+void ARM64CodeGen::emitLoadTailCallArea(Operand area) {
+    emitMovReg(X0, loadOperand(area, X9));
+}
+
+void ARM64CodeGen::emitStoreTailCallArg(int argIndex, Operand src) {
+    // str reg, [x0, #argIndex*8]
+    emitStrOffset(loadOperand(src, X9), X0, argIndex * 8);
+}
+
+size_t ARM64CodeGen::emitTailCallDirect(int argCount) {
+    emitFrameTeardown();
+    // mov x1, #argCount
+    emitInstruction(0xD2800000 | ((argCount & 0xFFFF) << 5) | 1);
+
+    // b (placeholder, bound or patched later)
+    size_t jumpOffset = code.size();
+    emitInstruction(0x14000000);
+    return jumpOffset;
+}
+
+size_t ARM64CodeGen::emitCallVeneer(void* info, void* target) {
+    // Literals must be 8-byte aligned
+    while (code.size() % 8 != 0) {
+        emitInstruction(0xD503201F); // nop
+    }
+    size_t offset = code.size();
+    // ldr x2, #16  ; info
+    emitInstruction(0x58000082);
+    // ldr x16, #20  ; target (patched once the callee is compiled)
+    emitInstruction(0x580000B0);
+    // br x16
+    emitInstruction(0xD61F0200);
+    // nop
+    emitInstruction(0xD503201F);
+    emit64((uint64_t)info);
+    emit64((uint64_t)target);
+    return offset;
+}
+
+bool ARM64CodeGen::patchCallSite(uint8_t* site, void* target) {
+    int64_t rel = (int64_t)((uint8_t*)target - site);
+    // bl and b reach +/-128MB
+    if (rel < -(1LL << 27) || rel >= (1LL << 27)) return false;
+    uint32_t insn;
+    memcpy(&insn, site, 4);
+    insn = (insn & 0xFC000000) | ((uint32_t)(rel >> 2) & 0x3FFFFFF);
+    memcpy(site, &insn, 4);
+    __builtin___clear_cache((char*)site, (char*)site + 4);
+    return true;
+}
+
+void ARM64CodeGen::patchCallVeneer(uint8_t* veneer, void* target) {
+    // Literal read by 'ldr x16', data only so no icache maintenance needed
+    uint64_t addr = (uint64_t)target;
+    memcpy(veneer + 24, &addr, 8);
+}
+
+void ARM64CodeGen::patchCallVeneerInfo(uint8_t* veneer, void* info) {
+    // Literal read by 'ldr x2'
+    uint64_t addr = (uint64_t)info;
+    memcpy(veneer + 16, &addr, 8);
+}
+
+void ARM64CodeGen::patchAddress(uint8_t* at, uint64_t address) {
+    // The imm16 fields of an emitMovAddress sequence
+    for (int i = 0; i < 4; i++) {
+        uint32_t insn;
+        memcpy(&insn, at + 4 * i, 4);
+        insn = (insn & ~(0xFFFFu << 5)) | (uint32_t)(((address >> (16 * i)) & 0xFFFF) << 5);
+        memcpy(at + 4 * i, &insn, 4);
     }
 }
 
@@ -3,14 +3,17 @@
 #if defined(__x86_64__) || defined(_M_X64)
 
 // x86-64 Implementation (System V AMD64 ABI)
-// Result register: RAX
-// Secondary register: RBX (callee-saved, preserved across calls)
-// Arg registers: RDI, RSI, RDX, RCX, R8, R9
+// Allocatable registers: RBX, R12, R13, R14, R15 (callee-saved)
+// Scratch registers: RAX (also return value), RCX, RDX (idiv), R11 (call target)
+// Arg registers: RDI, RSI, RDX, RCX, R8, R9 (RDI = args array on entry)
 // Stack grows downward
-// Frame: [RBP+8]=return addr, [RBP]=old RBP, [RBP-8]=local0, [RBP-16]=local1, etc.
+// Frame: [RBP+8]=return addr, [RBP]=old RBP, then the saved allocatable
+// registers, then spill slots: [RBP - 8*saved - 8] = slot0, etc.
 
-void X86_64CodeGen::emitPrologue(int localCount) {
-    localSlots = localCount;
+static const int allocatableRegs[] = {3 /*RBX*/, 12, 13, 14, 15};
+
+void X86_64CodeGen::emitPrologue(int spillSlots, int savedRegs) {
+    savedRegCount = savedRegs;
 
     // push rbp
     emit(0x55);
@@ -18,18 +21,16 @@ void X86_64CodeGen::emitPrologue(int localCount) {
     // mov rbp, rsp
     emit(REX_W); emit(0x89); emit(0xE5);
 
-    // push rbx (callee-saved, we use it)
-    emit(0x53);
-
-    // push r12 (callee-saved, for arg array pointer)
-    emit(REX_B); emit(0x54);
-
-    // Save arg pointer (rdi = args array) to r12
-    // mov r12, rdi
-    emit(REX_W | 0x01); emit(0x89); emit(0xFC);
+    // push callee-saved registers we allocate
+    for (int i = 0; i < savedRegs; i++) {
+        int reg = allocatableRegs[i];
+        if (reg >= 8) emit(REX_B);
+        emit(0x50 + (reg & 7));
+    }
 
-    // Allocate space for locals (aligned to 16 bytes)
-    frameSize = ((localCount * 8) + 15) & ~15;
+    // Allocate spill slots, keeping rsp 16-byte aligned at calls
+    frameSize = spillSlots * 8;
+    if ((savedRegs * 8 + frameSize) % 16 != 0) frameSize += 8;
     if (frameSize > 0) {
         if (frameSize <= 127) {
             // sub rsp, imm8
@@ -39,209 +40,268 @@ void X86_64CodeGen::emitPrologue(int localCount) {
             emit(REX_W); emit(0x81); emit(0xEC); emit32(frameSize);
         }
     }
-
-    // Initialize locals to 0
-    for (int i = 0; i < localCount; i++) {
-        // mov qword [rbp - offset], 0
-        emit(REX_W); emit(0xC7); emit(0x45);
-        emit((uint8_t)(-(16 + (i + 1) * 8))); // offset from rbp
-        emit32(0);
-    }
 }
 
 void X86_64CodeGen::emitEpilogue() {
-    // mov rsp, rbp ; sub rsp, 16 (for saved rbx and r12)
-    emit(REX_W); emit(0x8D); emit(0x65); emit(0xF0); // lea rsp, [rbp-16]
-
-    // pop r12
-    emit(REX_B); emit(0x5C);
-
-    // pop rbx
-    emit(0x5B);
-
-    // pop rbp
-    emit(0x5D);
+    emitFrameTeardown();
 
     // ret
     emit(0xC3);
 }
 
-void X86_64CodeGen::emitLoadImmediate(long long value) {
-    emitMovReg64Imm(RAX, value);
-}
-
-void X86_64CodeGen::emitLoadBool(bool value) {
-    emitMovReg64Imm(RAX, value ? 1 : 0);
-}
-
-void X86_64CodeGen::emitLoadLocal(int offset) {
-    // mov rax, [rbp - (16 + (offset+1)*8)]
-    int stackOffset = -(16 + (offset + 1) * 8);
-    emitMovFromStack(RAX, stackOffset);
-}
-
-void X86_64CodeGen::emitStoreLocal(int offset) {
-    // mov [rbp - (16 + (offset+1)*8)], rax
-    int stackOffset = -(16 + (offset + 1) * 8);
-    emitMovToStack(stackOffset, RAX);
-}
-
-void X86_64CodeGen::emitLoadArg(int argIndex) {
-    // Args passed as array: mov rax, [r12 + argIndex*8]
-    // REX.W + 8B /r : mov r64, r/m64
-    // ModRM: 01 000 100 (mod=01, reg=rax, rm=r12 via SIB)
-    // SIB: 00 100 100 (scale=1, index=none, base=r12)
-    emit(REX_W | 0x01); emit(0x8B); emit(0x44); emit(0x24);
-    emit((uint8_t)(argIndex * 8));
-}
+void X86_64CodeGen::emitFrameTeardown() {
+    // lea rsp, [rbp - 8*saved]
+    emitOpRegMem({0x8D}, RSP, RBP, -8 * savedRegCount);
 
-void X86_64CodeGen::emitPush() {
-    // push rax
-    emit(0x50);
-}
+    // pop saved registers in reverse order
+    for (int i = savedRegCount - 1; i >= 0; i--) {
+        int reg = allocatableRegs[i];
+        if (reg >= 8) emit(REX_B);
+        emit(0x58 + (reg & 7));
+    }
 
-void X86_64CodeGen::emitPop() {
-    // pop rbx (secondary register)
-    emit(0x5B);
+    // pop rbp
+    emit(0x5D);
 }
 
-void X86_64CodeGen::emitAdd() {
-    // add rax, rbx
-    emit(REX_W); emit(0x01); emit(0xD8);
+int X86_64CodeGen::physReg(Operand op) const {
+    return allocatableRegs[op.value];
 }
 
-void X86_64CodeGen::emitSub() {
-    // sub rbx, rax (left - right, left in rbx, right in rax)
-    emit(REX_W); emit(0x29); emit(0xC3);
-    // mov rax, rbx
-    emit(REX_W); emit(0x89); emit(0xD8);
+int X86_64CodeGen::slotOffset(Operand op) const {
+    return -8 * savedRegCount - 8 * (int)(op.value + 1);
 }
 
-void X86_64CodeGen::emitMul() {
-    // imul rax, rbx
-    emit(REX_W); emit(0x0F); emit(0xAF); emit(0xC3);
+void X86_64CodeGen::emitOpRegReg(const std::vector<uint8_t>& opcode, int reg, int rm) {
+    uint8_t rex = REX_W;
+    if (reg >= 8) rex |= REX_R;
+    if (rm >= 8) rex |= REX_B;
+    emit(rex);
+    for (uint8_t b : opcode) emit(b);
+    emit(0xC0 | ((reg & 7) << 3) | (rm & 7));
 }
 
-void X86_64CodeGen::emitDiv() {
-    // rbx / rax -> we want rbx in rax, then divide by old rax
-    // mov rcx, rax
-    emit(REX_W); emit(0x89); emit(0xC1);
-    // mov rax, rbx
-    emit(REX_W); emit(0x89); emit(0xD8);
-    // cqo (sign extend rax into rdx:rax)
-    emit(REX_W); emit(0x99);
-    // idiv rcx
-    emit(REX_W); emit(0xF7); emit(0xF9);
+void X86_64CodeGen::emitOpRegMem(const std::vector<uint8_t>& opcode, int reg, int base, int disp) {
+    uint8_t rex = REX_W;
+    if (reg >= 8) rex |= REX_R;
+    if (base >= 8) rex |= REX_B;
+    emit(rex);
+    for (uint8_t b : opcode) emit(b);
+
+    // [rbp]/[r13] have no disp-less form
+    uint8_t mod;
+    if (disp == 0 && (base & 7) != RBP) {
+        mod = 0x00;
+    } else if (disp >= -128 && disp <= 127) {
+        mod = 0x40;
+    } else {
+        mod = 0x80;
+    }
+    emit(mod | ((reg & 7) << 3) | (base & 7));
+    // [rsp]/[r12] need a SIB byte
+    if ((base & 7) == RSP) emit(0x24);
+    if (mod == 0x40) {
+        emit((int8_t)disp);
+    } else if (mod == 0x80) {
+        emit32(disp);
+    }
 }
 
-void X86_64CodeGen::emitMod() {
-    // rbx % rax
-    // mov rcx, rax
-    emit(REX_W); emit(0x89); emit(0xC1);
-    // mov rax, rbx
-    emit(REX_W); emit(0x89); emit(0xD8);
-    // cqo
-    emit(REX_W); emit(0x99);
-    // idiv rcx
-    emit(REX_W); emit(0xF7); emit(0xF9);
-    // mov rax, rdx (remainder is in rdx)
-    emit(REX_W); emit(0x89); emit(0xD0);
+void X86_64CodeGen::emitOpRegOperand(const std::vector<uint8_t>& opcode, int reg, Operand op) {
+    if (op.isReg()) {
+        emitOpRegReg(opcode, reg, physReg(op));
+    } else if (op.isSlot()) {
+        // Straight after a store to the slot, the register stored from
+        int stored = storedReg(op);
+        if (stored >= 0) {
+            emitOpRegReg(opcode, reg, stored);
+        } else {
+            emitOpRegMem(opcode, reg, RBP, slotOffset(op));
+        }
+    } else {
+        // Immediates go through a scratch register first
+        int scratch = (reg == R11) ? RCX : R11;
+        emitMovReg64Imm(scratch, op.value);
+        emitOpRegReg(opcode, reg, scratch);
+    }
 }
 
-void X86_64CodeGen::emitCompareEq() {
-    // cmp rbx, rax
-    emit(REX_W); emit(0x39); emit(0xC3);
-    // sete al
-    emit(0x0F); emit(0x94); emit(0xC0);
-    // movzx rax, al
-    emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+// Get the operand into a register: allocated registers are used as-is,
+// everything else is loaded into 'scratch'
+int X86_64CodeGen::loadOperand(Operand op, int scratch) {
+    if (op.isReg()) return physReg(op);
+    loadOperandInto(scratch, op);
+    return scratch;
 }
 
-void X86_64CodeGen::emitCompareNe() {
-    // cmp rbx, rax
-    emit(REX_W); emit(0x39); emit(0xC3);
-    // setne al
-    emit(0x0F); emit(0x95); emit(0xC0);
-    // movzx rax, al
-    emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+void X86_64CodeGen::loadOperandInto(int reg, Operand op) {
+    if (op.isReg()) {
+        if (physReg(op) != reg) emitMovRegReg(reg, physReg(op));
+    } else if (op.isSlot()) {
+        // Not reloaded straight after a store to it
+        int stored = storedReg(op);
+        if (stored >= 0) {
+            if (stored != reg) emitMovRegReg(reg, stored);
+            return;
+        }
+        // mov reg, [rbp + offset]
+        emitOpRegMem({0x8B}, reg, RBP, slotOffset(op));
+    } else {
+        emitMovReg64Imm(reg, op.value);
+    }
 }
 
-void X86_64CodeGen::emitCompareLt() {
-    // cmp rbx, rax
-    emit(REX_W); emit(0x39); emit(0xC3);
-    // setl al
-    emit(0x0F); emit(0x9C); emit(0xC0);
-    // movzx rax, al
-    emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+void X86_64CodeGen::storeOperand(Operand dst, int reg) {
+    if (dst.isReg()) {
+        if (physReg(dst) != reg) emitMovRegReg(physReg(dst), reg);
+    } else if (dst.isSlot()) {
+        // mov [rbp + offset], reg
+        emitOpRegMem({0x89}, reg, RBP, slotOffset(dst));
+        noteStore(dst, reg);
+    } else {
+        throw std::runtime_error("Cannot store to an immediate operand");
+    }
 }
 
-void X86_64CodeGen::emitCompareLe() {
-    // cmp rbx, rax
-    emit(REX_W); emit(0x39); emit(0xC3);
-    // setle al
-    emit(0x0F); emit(0x9E); emit(0xC0);
-    // movzx rax, al
-    emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+void X86_64CodeGen::emitMove(Operand dst, Operand src) {
+    if (dst == src) return;
+    if (dst.isReg()) {
+        loadOperandInto(physReg(dst), src);
+    } else if (src.isImm() && src.value >= INT32_MIN && src.value <= INT32_MAX) {
+        // mov qword [rbp + offset], imm32 (sign-extended)
+        emitOpRegMem({0xC7}, 0, RBP, slotOffset(dst));
+        emit32((uint32_t)src.value);
+    } else {
+        storeOperand(dst, loadOperand(src, RAX));
+    }
 }
 
-void X86_64CodeGen::emitCompareGt() {
-    // cmp rbx, rax
-    emit(REX_W); emit(0x39); emit(0xC3);
-    // setg al
-    emit(0x0F); emit(0x9F); emit(0xC0);
-    // movzx rax, al
-    emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+void X86_64CodeGen::emitLoadArg(Operand dst, int argIndex) {
+    // Args passed as array in rdi: mov reg, [rdi + argIndex*8]
+    int reg = dst.isReg() ? physReg(dst) : RAX;
+    emitOpRegMem({0x8B}, reg, RDI, argIndex * 8);
+    storeOperand(dst, reg);
+}
+
+void X86_64CodeGen::emitLoadArgs(Operand dst) {
+    storeOperand(dst, RDI);
+}
+
+void X86_64CodeGen::emitBinary(ALUOp op, Operand dst, Operand left, Operand right) {
+    switch (op) {
+        case ALUOp::ADD:
+        case ALUOp::SUB:
+        case ALUOp::MUL: {
+            // Compute in place when dst is a register not read as 'right'
+            int work = (dst.isReg() && dst != right) ? physReg(dst) : RAX;
+            loadOperandInto(work, left);
+            if (right.isImm() && right.value >= INT32_MIN && right.value <= INT32_MAX) {
+                // add/sub/imul work, imm
+                if (op == ALUOp::MUL) {
+                    emitImulRegImm(work, (int32_t)right.value);
+                } else {
+                    emitAluRegImm(op == ALUOp::ADD ? 0 : 5, work, (int32_t)right.value);
+                }
+            } else if (op == ALUOp::ADD) {
+                // add work, right
+                emitOpRegOperand({0x03}, work, right);
+            } else if (op == ALUOp::SUB) {
+                // sub work, right
+                emitOpRegOperand({0x2B}, work, right);
+            } else {
+                // imul work, right
+                emitOpRegOperand({0x0F, 0xAF}, work, right);
+            }
+            storeOperand(dst, work);
+            break;
+        }
+        case ALUOp::DIV:
+        case ALUOp::MOD: {
+            // rdx:rax / divisor -> quotient in rax, remainder in rdx
+            loadOperandInto(RAX, left);
+            int divisor = loadOperand(right, RCX);
+            // cqo (sign extend rax into rdx:rax)
+            emit(REX_W); emit(0x99);
+            // idiv divisor
+            emitOpRegReg({0xF7}, 7, divisor);
+            storeOperand(dst, op == ALUOp::DIV ? RAX : RDX);
+            break;
+        }
+        case ALUOp::AND:
+        case ALUOp::OR: {
+            // Convert both to boolean, then combine
+            int l = loadOperand(left, RCX);
+            // test l, l; setne cl
+            emitOpRegReg({0x85}, l, l);
+            emit(0x0F); emit(0x95); emit(0xC1);
+            int r = loadOperand(right, RAX);
+            // test r, r; setne al
+            emitOpRegReg({0x85}, r, r);
+            emit(0x0F); emit(0x95); emit(0xC0);
+            if (op == ALUOp::AND) {
+                // and al, cl
+                emit(0x20); emit(0xC8);
+            } else {
+                // or al, cl
+                emit(0x08); emit(0xC8);
+            }
+            // movzx rax, al
+            emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+            storeOperand(dst, RAX);
+            break;
+        }
+    }
 }
 
-void X86_64CodeGen::emitCompareGe() {
-    // cmp rbx, rax
-    emit(REX_W); emit(0x39); emit(0xC3);
-    // setge al
-    emit(0x0F); emit(0x9D); emit(0xC0);
-    // movzx rax, al
-    emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+// The condition field of setcc and jcc
+static uint8_t conditionCode(CondCode cc) {
+    switch (cc) {
+        case CondCode::EQ: return 0x4; // e
+        case CondCode::NE: return 0x5; // ne
+        case CondCode::LT: return 0xC; // l
+        case CondCode::LE: return 0xE; // le
+        case CondCode::GT: return 0xF; // g
+        default: return 0xD;           // ge
+    }
 }
 
-void X86_64CodeGen::emitAnd() {
-    // Convert both to boolean, then AND
-    // test rbx, rbx; setne cl
-    emit(REX_W); emit(0x85); emit(0xDB);
-    emit(0x0F); emit(0x95); emit(0xC1);
-    // test rax, rax; setne al
-    emit(REX_W); emit(0x85); emit(0xC0);
-    emit(0x0F); emit(0x95); emit(0xC0);
-    // and al, cl
-    emit(0x20); emit(0xC8);
+void X86_64CodeGen::emitSetCC(CondCode cc) {
+    // setcc al
+    emit(0x0F); emit(0x90 | conditionCode(cc)); emit(0xC0);
     // movzx rax, al
     emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
 }
 
-void X86_64CodeGen::emitOr() {
-    // Convert both to boolean, then OR
-    // test rbx, rbx; setne cl
-    emit(REX_W); emit(0x85); emit(0xDB);
-    emit(0x0F); emit(0x95); emit(0xC1);
-    // test rax, rax; setne al
-    emit(REX_W); emit(0x85); emit(0xC0);
-    emit(0x0F); emit(0x95); emit(0xC0);
-    // or al, cl
-    emit(0x08); emit(0xC8);
-    // movzx rax, al
-    emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+void X86_64CodeGen::emitCompare(CondCode cc, Operand dst, Operand left, Operand right) {
+    int l = loadOperand(left, RAX);
+    if (right.isImm() && right.value >= INT32_MIN && right.value <= INT32_MAX) {
+        // cmp l, imm
+        emitAluRegImm(7, l, (int32_t)right.value);
+    } else {
+        // cmp l, right
+        emitOpRegOperand({0x3B}, l, right);
+    }
+    emitSetCC(cc);
+    storeOperand(dst, RAX);
+    // Neither touched the flags, so a branch on dst next can use them
+    noteCompare(dst, cc);
 }
 
-void X86_64CodeGen::emitNot() {
-    // test rax, rax
-    emit(REX_W); emit(0x85); emit(0xC0);
-    // sete al
-    emit(0x0F); emit(0x94); emit(0xC0);
-    // movzx rax, al
-    emit(REX_W); emit(0x0F); emit(0xB6); emit(0xC0);
+void X86_64CodeGen::emitNot(Operand dst, Operand src) {
+    int reg = loadOperand(src, RAX);
+    // test reg, reg
+    emitOpRegReg({0x85}, reg, reg);
+    // sete al; movzx rax, al
+    emitSetCC(CondCode::EQ);
+    storeOperand(dst, RAX);
 }
 
-void X86_64CodeGen::emitNeg() {
-    // neg rax
-    emit(REX_W); emit(0xF7); emit(0xD8);
+void X86_64CodeGen::emitNeg(Operand dst, Operand src) {
+    int work = dst.isReg() ? physReg(dst) : RAX;
+    loadOperandInto(work, src);
+    // neg work
+    emitOpRegReg({0xF7}, 3, work);
+    storeOperand(dst, work);
 }
 
 Label X86_64CodeGen::createLabel() {
@@ -254,6 +314,7 @@ Label X86_64CodeGen::createLabel() {
 void X86_64CodeGen::bindLabel(Label& label) {
     label.offset = code.size();
     label.bound = true;
+    forgetEmitted();
 
     // Fix up all pending references
     for (size_t fixupOffset : label.pendingFixups) {
@@ -263,9 +324,7 @@ void X86_64CodeGen::bindLabel(Label& label) {
     label.pendingFixups.clear();
 }
 
-void X86_64CodeGen::emitJump(Label& label) {
-    // jmp rel32
-    emit(0xE9);
+void X86_64CodeGen::emitLabelOffset(Label& label) {
     if (label.bound) {
         int32_t rel = (int32_t)(label.offset - (code.size() + 4));
         emit32(rel);
@@ -275,68 +334,204 @@ void X86_64CodeGen::emitJump(Label& label) {
     }
 }
 
-void X86_64CodeGen::emitJumpIfFalse(Label& label) {
-    // test rax, rax
-    emit(REX_W); emit(0x85); emit(0xC0);
-    // jz rel32
-    emit(0x0F); emit(0x84);
-    if (label.bound) {
-        int32_t rel = (int32_t)(label.offset - (code.size() + 4));
-        emit32(rel);
-    } else {
-        label.pendingFixups.push_back(code.size());
-        emit32(0); // placeholder
+void X86_64CodeGen::emitJump(Label& label) {
+    // jmp rel32
+    emit(0xE9);
+    emitLabelOffset(label);
+}
+
+void X86_64CodeGen::emitJumpIf(CondCode cc, Label& label) {
+    // jcc rel32
+    emit(0x0F); emit(0x80 | conditionCode(cc));
+    emitLabelOffset(label);
+}
+
+void X86_64CodeGen::emitJumpIfFalse(Operand cond, Label& label) {
+    // Straight after the compare that set cond, branch on its flags
+    CondCode cc;
+    if (flagsHold(cond, cc)) {
+        emitJumpIf(inverse(cc), label);
+        return;
     }
+    int reg = loadOperand(cond, RAX);
+    // test reg, reg; jz
+    emitOpRegReg({0x85}, reg, reg);
+    emitJumpIf(CondCode::EQ, label);
 }
 
-void X86_64CodeGen::emitJumpIfTrue(Label& label) {
-    // test rax, rax
-    emit(REX_W); emit(0x85); emit(0xC0);
-    // jnz rel32
-    emit(0x0F); emit(0x85);
-    if (label.bound) {
-        int32_t rel = (int32_t)(label.offset - (code.size() + 4));
-        emit32(rel);
-    } else {
-        label.pendingFixups.push_back(code.size());
-        emit32(0); // placeholder
+void X86_64CodeGen::emitJumpIfTrue(Operand cond, Label& label) {
+    CondCode cc;
+    if (flagsHold(cond, cc)) {
+        emitJumpIf(cc, label);
+        return;
     }
+    int reg = loadOperand(cond, RAX);
+    // test reg, reg; jnz
+    emitOpRegReg({0x85}, reg, reg);
+    emitJumpIf(CondCode::NE, label);
 }
 
-void X86_64CodeGen::emitCallRuntime(void* funcPtr, int argCount) {
+void X86_64CodeGen::emitSetCallArg(int argIndex, Operand src) {
+    // Sources are never argument registers, so order does not matter
+    static const int argRegs[] = {RDI, RSI, RDX, RCX, R8, R9};
+    if (argIndex >= 6) {
+        throw std::runtime_error("Too many runtime call arguments");
+    }
+    loadOperandInto(argRegs[argIndex], src);
+}
+
+size_t X86_64CodeGen::emitCallRuntime(void* funcPtr, int argCount) {
     // Call function at absolute address
     // mov r11, funcPtr
-    emit(REX_W | REX_B); emit(0xB8 + (R11 - 8)); emit64((uint64_t)funcPtr);
+    emit(REX_W | REX_B); emit(0xB8 + (R11 - 8));
+    size_t address = code.size();
+    emit64((uint64_t)funcPtr);
     // call r11
     emit(0x41); emit(0xFF); emit(0xD3);
+    return address;
+}
+
+size_t X86_64CodeGen::emitMoveAddress(Operand dst, uint64_t address) {
+    // mov reg, imm64, whatever the value
+    int reg = dst.isReg() ? physReg(dst) : RAX;
+    emit(reg >= 8 ? REX_W | REX_B : REX_W); emit(0xB8 + (reg & 7));
+    size_t offset = code.size();
+    emit64(address);
+    storeOperand(dst, reg);
+    return offset;
 }
 
-void X86_64CodeGen::emitReturn() {
+void X86_64CodeGen::emitGetResult(Operand dst) {
+    storeOperand(dst, RAX);
+}
+
+void X86_64CodeGen::emitGetResultType(Operand dst) {
+    storeOperand(dst, RDX);
+}
+
+void X86_64CodeGen::emitReturn(Operand value, Operand type) {
+    // rax:rdx, as for a two-word struct
+    loadOperandInto(RDX, type);
+    loadOperandInto(RAX, value);
     emitEpilogue();
 }
 
-void X86_64CodeGen::emitLoadStringPtr(const char* str) {
-    // Load string pointer directly (string is in static memory)
-    emitMovReg64Imm(RAX, (uint64_t)str);
+void X86_64CodeGen::emitLoad(Operand dst, Operand address, int offset) {
+    // mov reg, [base + offset]
+    int base = loadOperand(address, R11);
+    int reg = dst.isReg() ? physReg(dst) : RAX;
+    emitOpRegMem({0x8B}, reg, base, offset);
+    storeOperand(dst, reg);
 }
 
-void X86_64CodeGen::emitPrepareCallArgs(int argCount) {
-    // Args are already set via emitSetCallArg
+void X86_64CodeGen::emitStore(Operand address, int offset, Operand src) {
+    // mov [base + offset], reg
+    int base = loadOperand(address, R11);
+    int reg = loadOperand(src, RAX);
+    emitOpRegMem({0x89}, reg, base, offset);
 }
 
-void X86_64CodeGen::emitSetCallArg(int argIndex) {
-    // Move rax to the appropriate argument register
-    static const int argRegs[] = {RDI, RSI, RDX, RCX, R8, R9};
-    if (argIndex < 6) {
-        int reg = argRegs[argIndex];
-        if (reg < 8) {
-            // mov reg, rax
-            emit(REX_W); emit(0x89); emit(0xC0 | reg);
+void X86_64CodeGen::emitAllocCallArgs(int argCount) {
+    int size = callArgsSize(argCount);
+    if (size == 0) return;
+    if (size <= 127) {
+        // sub rsp, imm8
+        emit(REX_W); emit(0x83); emit(0xEC); emit(size);
+    } else {
+        // sub rsp, imm32
+        emit(REX_W); emit(0x81); emit(0xEC); emit32(size);
+    }
+}
+
+void X86_64CodeGen::emitStoreCallArg(int argIndex, Operand src) {
+    // mov [rsp + argIndex*8], reg
+    int reg = loadOperand(src, RAX);
+    emitOpRegMem({0x89}, reg, RSP, argIndex * 8);
+}
+
+size_t X86_64CodeGen::emitCallDirect(int argCount) {
+    // mov rdi, rsp (args array is the call area)
+    emit(REX_W); emit(0x89); emit(0xE7);
+    // mov esi, argCount
+    emit(0xBE); emit32(argCount);
+
+    // call rel32 (placeholder, bound or patched later)
+    size_t callOffset = code.size();
+    emit(0xE8); emit32(0);
+
+    int size = callArgsSize(argCount);
+    if (size > 0) {
+        if (size <= 127) {
+            // add rsp, imm8
+            emit(REX_W); emit(0x83); emit(0xC4); emit(size);
         } else {
-            // mov r8/r9, rax
-            emit(REX_W | REX_B); emit(0x89); emit(0xC0 | (reg - 8));
+            // add rsp, imm32
+            emit(REX_W); emit(0x81); emit(0xC4); emit32(size);
         }
     }
+    return callOffset;
+}
+
+void X86_64CodeGen::bindCallDirect(size_t callOffset, size_t targetOffset) {
+    // Same for call and jmp rel32
+    patch32(callOffset + 1, (int32_t)(targetOffset - (callOffset + 5)));
+}
+
+void X86_64CodeGen::emitLoadTailCallArea(Operand area) {
+    loadOperandInto(RDI, area);
+}
+
+void X86_64CodeGen::emitStoreTailCallArg(int argIndex, Operand src) {
+    // mov [rdi + argIndex*8], reg
+    int reg = loadOperand(src, RAX);
+    emitOpRegMem({0x89}, reg, RDI, argIndex * 8);
+}
+
+size_t X86_64CodeGen::emitTailCallDirect(int argCount) {
+    emitFrameTeardown();
+    // mov esi, argCount
+    emit(0xBE); emit32(argCount);
+
+    // jmp rel32 (placeholder, bound or patched later)
+    size_t jumpOffset = code.size();
+    emit(0xE9); emit32(0);
+    return jumpOffset;
+}
+
+size_t X86_64CodeGen::emitCallVeneer(void* info, void* target) {
+    size_t offset = code.size();
+    // mov rdx, info
+    emit(REX_W); emit(0xBA); emit64((uint64_t)info);
+    // mov r11, target (patched once the callee is compiled)
+    emit(REX_W | REX_B); emit(0xB8 + (R11 - 8)); emit64((uint64_t)target);
+    // jmp r11
+    emit(REX_B); emit(0xFF); emit(0xE3);
+    return offset;
+}
+
+bool X86_64CodeGen::patchCallSite(uint8_t* site, void* target) {
+    int64_t rel = (int64_t)((uint8_t*)target - (site + 5));
+    if (rel < INT32_MIN || rel > INT32_MAX) return false;
+    int32_t rel32 = (int32_t)rel;
+    memcpy(site + 1, &rel32, 4);
+    return true;
+}
+
+void X86_64CodeGen::patchCallVeneer(uint8_t* veneer, void* target) {
+    // Immediate of the 'mov r11, imm64' following the 10-byte 'mov rdx'
+    uint64_t addr = (uint64_t)target;
+    memcpy(veneer + 12, &addr, 8);
+}
+
+void X86_64CodeGen::patchCallVeneerInfo(uint8_t* veneer, void* info) {
+    // Immediate of the 'mov rdx, imm64'
+    uint64_t addr = (uint64_t)info;
+    memcpy(veneer + 2, &addr, 8);
+}
+
+void X86_64CodeGen::patchAddress(uint8_t* at, uint64_t address) {
+    // Always the imm64 of a mov
+    memcpy(at, &address, 8);
 }
 
 // Helper methods
@@ -356,6 +551,11 @@ void X86_64CodeGen::emitMovReg64Imm(int reg, uint64_t imm) {
             emit(REX_B); emit(0xB8 + (reg - 8));
         }
         emit32((uint32_t)imm);
+    } else if ((int64_t)imm < 0 && (int64_t)imm >= INT32_MIN) {
+        // mov rax, imm32 (sign-extended)
+        emit(reg >= 8 ? REX_W | REX_B : REX_W);
+        emit(0xC7); emit(0xC0 | (reg & 7));
+        emit32((uint32_t)imm);
     } else {
         // mov rax, imm64
         if (reg < 8) {
@@ -367,45 +567,38 @@ void X86_64CodeGen::emitMovReg64Imm(int reg, uint64_t imm) {
     }
 }
 
-void X86_64CodeGen::emitMovRegReg(int dst, int src) {
-    uint8_t rex = REX_W;
-    if (dst >= 8) rex |= REX_B;
-    if (src >= 8) rex |= REX_R;
-    emit(rex);
-    emit(0x89);
-    emit(0xC0 | ((src & 7) << 3) | (dst & 7));
+void X86_64CodeGen::emitAluRegImm(int ext, int reg, int32_t imm) {
+    emit(reg >= 8 ? REX_W | REX_B : REX_W);
+    if (imm >= INT8_MIN && imm <= INT8_MAX) {
+        // op reg, imm8 (sign-extended)
+        emit(0x83); emit(0xC0 | (ext << 3) | (reg & 7));
+        emit((uint8_t)imm);
+    } else {
+        // op reg, imm32
+        emit(0x81); emit(0xC0 | (ext << 3) | (reg & 7));
+        emit32((uint32_t)imm);
+    }
 }
 
-void X86_64CodeGen::emitMovFromStack(int reg, int offset) {
-    // mov reg, [rbp + offset]
-    uint8_t rex = REX_W;
-    if (reg >= 8) rex |= REX_R;
-    emit(rex);
-    emit(0x8B);
-
-    if (offset >= -128 && offset <= 127) {
-        emit(0x45 | ((reg & 7) << 3)); // ModRM: [rbp + disp8]
-        emit((int8_t)offset);
+void X86_64CodeGen::emitImulRegImm(int reg, int32_t imm) {
+    emit(reg >= 8 ? REX_W | REX_R | REX_B : REX_W);
+    bool small = imm >= INT8_MIN && imm <= INT8_MAX;
+    // imul reg, reg, imm8 / imm32
+    emit(small ? 0x6B : 0x69); emit(0xC0 | ((reg & 7) << 3) | (reg & 7));
+    if (small) {
+        emit((uint8_t)imm);
     } else {
-        emit(0x85 | ((reg & 7) << 3)); // ModRM: [rbp + disp32]
-        emit32(offset);
+        emit32((uint32_t)imm);
     }
 }
 
-void X86_64CodeGen::emitMovToStack(int offset, int reg) {
-    // mov [rbp + offset], reg
+void X86_64CodeGen::emitMovRegReg(int dst, int src) {
     uint8_t rex = REX_W;
-    if (reg >= 8) rex |= REX_R;
+    if (dst >= 8) rex |= REX_B;
+    if (src >= 8) rex |= REX_R;
     emit(rex);
     emit(0x89);
-
-    if (offset >= -128 && offset <= 127) {
-        emit(0x45 | ((reg & 7) << 3)); // ModRM: [rbp + disp8]
-        emit((int8_t)offset);
-    } else {
-        emit(0x85 | ((reg & 7) << 3)); // ModRM: [rbp + disp32]
-        emit32(offset);
-    }
+    emit(0xC0 | ((src & 7) << 3) | (dst & 7));
 }
 
 #endif // x86_64
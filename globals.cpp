@@ -0,0 +1,47 @@
+#include "globals.h"
+#include <stdexcept>
+
+// Slots are reserved in one piece so they never move; untouched pages of
+// the reservation cost nothing
+static const size_t MAX_GLOBALS = 1 << 16;
+
+static_assert(sizeof(GlobalTable::Slot) == 16, "Compiled code relies on the slot layout");
+
+GlobalTable::GlobalTable() {
+    slots.reserve(MAX_GLOBALS);
+}
+
+GlobalTable::~GlobalTable() {
+    for (const Slot& slot : slots) {
+        if (slot.type != UNDEFINED) Value::adopt((ValueType)slot.type, slot.bits);
+    }
+}
+
+int GlobalTable::index(Symbol name) {
+    auto it = indices.find(name);
+    if (it != indices.end()) return it->second;
+
+    if (slots.size() == MAX_GLOBALS) {
+        throw std::runtime_error("Too many global variables");
+    }
+    indices.emplace(name, slots.size());
+    slots.push_back({UNDEFINED, 0});
+    return slots.size() - 1;
+}
+
+int GlobalTable::find(Symbol name) const {
+    auto it = indices.find(name);
+    return it != indices.end() ? it->second : -1;
+}
+
+void GlobalTable::store(Slot& slot, const Value& value) {
+    // The new reference is taken before the old one goes, in case they
+    // are the same string
+    long long bits = value.retainedBits();
+    if (slot.type != UNDEFINED) {
+        Value old = Value::adopt((ValueType)slot.type, slot.bits);
+        if (replaced && old.type == ValueType::STRING) replaced->push_back(std::move(old));
+    }
+    slot.type = (long long)value.type;
+    slot.bits = bits;
+}
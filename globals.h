@@ -0,0 +1,52 @@
+#ifndef GLOBALS_H
+#define GLOBALS_H
+
+#include "symbol.h"
+#include "value.h"
+#include <unordered_map>
+#include <vector>
+
+// Global variables. A name gets a slot the first time it is looked up and
+// keeps it; resolveSlots looks up every global of a program, in order, so
+// the interpreter and compiled code address them by index. Slots never
+// move, so compiled code reads and writes them in place, at a fixed offset
+// from the base of the table.
+class GlobalTable {
+public:
+    // A global as compiled code sees it: the ValueType of its value (or
+    // UNDEFINED until something is assigned) and the payload, Value::bits.
+    // A string payload holds a reference.
+    struct Slot {
+        long long type;
+        long long bits;
+    };
+    static const long long UNDEFINED = -1;
+    static const int TYPE_OFFSET = 0;
+    static const int BITS_OFFSET = 8;
+
+    GlobalTable();
+    ~GlobalTable();
+    GlobalTable(const GlobalTable&) = delete;
+    GlobalTable& operator=(const GlobalTable&) = delete;
+
+    // The slot of a name, created undefined if there is none yet
+    int index(Symbol name);
+    // The slot of a name, or -1 if it has none
+    int find(Symbol name) const;
+    Slot* base() { return slots.data(); }
+    Slot& operator[](int index) { return slots[index]; }
+
+    static Value load(const Slot& slot) { return Value::fromBits((ValueType)slot.type, slot.bits); }
+    void store(Slot& slot, const Value& value);
+
+    // While compiled code may hold bare pointers to the strings of
+    // globals, the values replaced go here instead of being released
+    void keepReplaced(std::vector<Value>* keep) { replaced = keep; }
+
+private:
+    std::vector<Slot> slots;  // all the capacity there will ever be
+    std::unordered_map<Symbol, int> indices;
+    std::vector<Value>* replaced = nullptr;
+};
+
+#endif // GLOBALS_H
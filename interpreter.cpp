@@ -2,75 +2,106 @@
 #include <iostream>
 #include <stdexcept>
 
-void Interpreter::execute(BlockNode* root) {
-    if (!root) return;
+Completion Interpreter::execute(BlockNode* root) {
+    if (!root) return Completion::NORMAL;
 
     for (auto& stmt : root->statements) {
-        try {
-            executeStatement(stmt.get());
-        } catch (const ReturnException& e) {
-            throw;
-        }
+        Completion completion = executeStatement(stmt.get());
+        if (completion != Completion::NORMAL) return completion;
     }
+    return Completion::NORMAL;
 }
 
-Value Interpreter::executeStatement(ASTNode* stmt) {
-    if (!stmt) return Value();
+Completion Interpreter::executeStatement(ASTNode* stmt) {
+    if (!stmt) return Completion::NORMAL;
 
     switch (stmt->type) {
         case ASTNodeType::ASSIGNMENT: {
             AssignmentNode* assign = static_cast<AssignmentNode*>(stmt);
             Value val = evaluate(assign->value.get());
-            variables[assign->variable] = val;
-            return val;
+            if (assign->slot >= 0) {
+                stack[frameBase + assign->slot] = std::move(val);
+            } else {
+                globals.store(globals[assign->global], val);
+            }
+            return Completion::NORMAL;
         }
         case ASTNodeType::FUNCTION_DEF: {
-            FunctionDefNode* funcDef = static_cast<FunctionDefNode*>(stmt);
-            functions[funcDef->name] = funcDef;
-            return Value();
+            define(static_cast<FunctionDefNode*>(stmt));
+            return Completion::NORMAL;
         }
         case ASTNodeType::FUNCTION_CALL: {
-            return evaluateFunctionCall(static_cast<FunctionCallNode*>(stmt));
+            evaluateFunctionCall(static_cast<FunctionCallNode*>(stmt));
+            return Completion::NORMAL;
         }
         case ASTNodeType::IF_STMT: {
             IfNode* ifNode = static_cast<IfNode*>(stmt);
             Value cond = evaluate(ifNode->condition.get());
             if (cond.asBoolean()) {
-                executeStatement(ifNode->thenBlock.get());
+                return executeStatement(ifNode->thenBlock.get());
             } else if (ifNode->elseBlock) {
-                executeStatement(ifNode->elseBlock.get());
+                return executeStatement(ifNode->elseBlock.get());
             }
-            return Value();
+            return Completion::NORMAL;
         }
         case ASTNodeType::WHILE_STMT: {
             WhileNode* whileNode = static_cast<WhileNode*>(stmt);
+            uint32_t iterations = 0;
             while (evaluate(whileNode->condition.get()).asBoolean()) {
-                executeStatement(whileNode->body.get());
+                Completion completion = executeStatement(whileNode->body.get());
+                if (completion != Completion::NORMAL) return completion;
+                if (jit) {
+                    if (currentProfile) countBackedge();
+                    if (++iterations == loopThreshold && enterLoop(whileNode)) {
+                        // The function, or the program, has run to its end
+                        return Completion::RETURN;
+                    }
+                }
             }
-            return Value();
+            return Completion::NORMAL;
         }
         case ASTNodeType::BLOCK: {
             BlockNode* block = static_cast<BlockNode*>(stmt);
-            execute(block);
-            return Value();
+            return execute(block);
         }
         case ASTNodeType::RETURN: {
             ReturnNode* retNode = static_cast<ReturnNode*>(stmt);
-            if (retNode->value) {
-                throw ReturnException(evaluate(retNode->value.get()));
+            if (inFunction && retNode->value && retNode->value->type == ASTNodeType::FUNCTION_CALL) {
+                // Tail call: arguments are evaluated here, and the call
+                // itself is left to callFunction once this frame is done
+                std::vector<Value> args;
+                FunctionDefNode* callee =
+                    evaluateArguments(static_cast<FunctionCallNode*>(retNode->value.get()), args);
+                if (replayNext < replay.size()) {
+                    returnValue = std::move(replay[replayNext++]);
+                    return Completion::RETURN;
+                }
+                tailFunction = callee;
+                tailArgs = std::move(args);
+                return Completion::TAIL_CALL;
             }
-            throw ReturnException(Value());
+            returnValue = retNode->value ? evaluate(retNode->value.get()) : Value();
+            return Completion::RETURN;
         }
         case ASTNodeType::PRINT: {
             PrintNode* printNode = static_cast<PrintNode*>(stmt);
             executePrint(printNode);
-            return Value();
+            return Completion::NORMAL;
         }
         default:
-            return evaluate(stmt);
+            evaluate(stmt);
+            return Completion::NORMAL;
     }
 }
 
+bool Interpreter::define(FunctionDefNode* funcDef) {
+    FunctionDefNode*& current = functions[funcDef->name];
+    bool redefined = current && current != funcDef;
+    if (jit && redefined) jit->functionRedefined(funcDef->name);
+    current = funcDef;
+    return redefined;
+}
+
 Value Interpreter::evaluate(ASTNode* node) {
     if (!node) return Value();
 
@@ -84,16 +115,18 @@ Value Interpreter::evaluate(ASTNode* node) {
             return Value(boolNode->value);
         }
         case ASTNodeType::STRING: {
-            StringNode* strNode = static_cast<StringNode*>(node);
-            return Value(strNode->value);
+            return static_cast<StringNode*>(node)->value();
         }
         case ASTNodeType::VARIABLE: {
             VariableNode* varNode = static_cast<VariableNode*>(node);
-            auto it = variables.find(varNode->name);
-            if (it != variables.end()) {
-                return it->second;
+            if (varNode->slot >= 0) {
+                return stack[frameBase + varNode->slot];
+            }
+            const GlobalTable::Slot& global = globals[varNode->global];
+            if (global.type != GlobalTable::UNDEFINED) {
+                return GlobalTable::load(global);
             }
-            throw std::runtime_error("Undefined variable: " + varNode->name);
+            throw std::runtime_error("Undefined variable: " + varNode->name.str());
         }
         case ASTNodeType::BINARY_OP: {
             return evaluateBinaryOp(static_cast<BinaryOpNode*>(node));
@@ -116,9 +149,7 @@ Value Interpreter::evaluateBinaryOp(BinaryOpNode* node) {
     switch (node->op) {
         case BinaryOpType::ADD:
             if (left.type == ValueType::STRING || right.type == ValueType::STRING) {
-                std::string leftStr = (left.type == ValueType::STRING) ? left.asString() : std::to_string(left.asInteger());
-                std::string rightStr = (right.type == ValueType::STRING) ? right.asString() : std::to_string(right.asInteger());
-                return Value(leftStr + rightStr);
+                return Value::concatenate(left, right);
             }
             return Value(left.asInteger() + right.asInteger());
         case BinaryOpType::SUB:
@@ -127,26 +158,17 @@ Value Interpreter::evaluateBinaryOp(BinaryOpNode* node) {
             return Value(left.asInteger() * right.asInteger());
         case BinaryOpType::DIV:
             if (right.asInteger() == 0) throw std::runtime_error("Division by zero");
+            // LLONG_MIN / -1 wraps around to itself
+            if (right.asInteger() == -1) return Value((long long)(0ULL - (unsigned long long)left.asInteger()));
             return Value(left.asInteger() / right.asInteger());
         case BinaryOpType::MOD:
             if (right.asInteger() == 0) throw std::runtime_error("Modulo by zero");
+            if (right.asInteger() == -1) return Value(0LL);
             return Value(left.asInteger() % right.asInteger());
         case BinaryOpType::EQ:
-            if (left.type == ValueType::INTEGER && right.type == ValueType::INTEGER)
-                return Value(left.asInteger() == right.asInteger());
-            if (left.type == ValueType::BOOLEAN && right.type == ValueType::BOOLEAN)
-                return Value(left.asBoolean() == right.asBoolean());
-            if (left.type == ValueType::STRING && right.type == ValueType::STRING)
-                return Value(left.asString() == right.asString());
-            return Value(false);
+            return Value(left.equals(right));
         case BinaryOpType::NE:
-            if (left.type == ValueType::INTEGER && right.type == ValueType::INTEGER)
-                return Value(left.asInteger() != right.asInteger());
-            if (left.type == ValueType::BOOLEAN && right.type == ValueType::BOOLEAN)
-                return Value(left.asBoolean() != right.asBoolean());
-            if (left.type == ValueType::STRING && right.type == ValueType::STRING)
-                return Value(left.asString() != right.asString());
-            return Value(true);
+            return Value(!left.equals(right));
         case BinaryOpType::LT:
             return Value(left.asInteger() < right.asInteger());
         case BinaryOpType::LE:
@@ -177,41 +199,229 @@ Value Interpreter::evaluateUnaryOp(UnaryOpNode* node) {
     }
 }
 
-Value Interpreter::evaluateFunctionCall(FunctionCallNode* node) {
+FunctionDefNode* Interpreter::evaluateArguments(FunctionCallNode* node, std::vector<Value>& args) {
     auto it = functions.find(node->name);
     if (it == functions.end()) {
-        throw std::runtime_error("Undefined function: " + node->name);
+        throw std::runtime_error("Undefined function: " + node->name.str());
     }
 
     FunctionDefNode* funcDef = it->second;
 
-    std::map<std::string, Value> savedVars = variables;
+    // Arguments are evaluated in the caller's frame; extra ones only for
+    // their side effects
+    args.clear();
+    for (size_t i = 0; i < node->args.size(); ++i) {
+        Value arg = evaluate(node->args[i].get());
+        if (i < funcDef->params.size()) args.push_back(std::move(arg));
+    }
+    args.resize(funcDef->params.size());
+    return funcDef;
+}
+
+Value Interpreter::evaluateFunctionCall(FunctionCallNode* node) {
+    std::vector<Value> args;
+    FunctionDefNode* funcDef = evaluateArguments(node, args);
+
+    // A call made by compiled code before it deoptimized
+    if (replayNext < replay.size()) {
+        return std::move(replay[replayNext++]);
+    }
+    return callFunction(funcDef, args);
+}
+
+Value Interpreter::callFunction(FunctionDefNode* funcDef, std::vector<Value>& args) {
+    // The frame for the callee goes on top of the stack; globals are
+    // shared, so nothing else needs saving
+    size_t base = stack.size();
+    size_t savedBase = frameBase;
+    FunctionProfile* savedProfile = currentProfile;
+    bool savedInFunction = inFunction;
+    FunctionProfile* caller = nullptr;  // first function of a chain of tail calls
+
+    Value result;
+    for (;;) {
+        FunctionProfile* profile = nullptr;
+        if (jit) {
+            profile = &profiles[funcDef];
+            profile->function = funcDef;
+            if (!caller) caller = profile;
+            if (profile->argTypes.size() < args.size()) profile->argTypes.resize(args.size());
+            for (size_t i = 0; i < args.size(); ++i) {
+                profile->argTypes[i] |= 1 << (int)args[i].type;
+            }
+            if (profile->state == FunctionProfile::COUNTING && ++profile->calls >= callThreshold) {
+                promote(*profile);
+            }
+            if (profile->state == FunctionProfile::NATIVE) {
+                stack.resize(base);
+                if (jit->callNative(funcDef, args, result)) {
+                    profile->returnTypes |= 1 << (int)result.type;
+                    break;
+                }
+            }
+        }
+
+        // A tail call reuses the frame of the function making it
+        stack.resize(base);
+        stack.resize(base + funcDef->frameSize);
+        for (size_t i = 0; i < funcDef->params.size() && i < args.size(); ++i) {
+            stack[base + i] = std::move(args[i]);
+        }
+        frameBase = base;
+        currentProfile = profile;
+        inFunction = true;
 
-    for (size_t i = 0; i < funcDef->params.size(); ++i) {
-        if (i < node->args.size()) {
-            variables[funcDef->params[i]] = evaluate(node->args[i].get());
-        } else {
-            variables[funcDef->params[i]] = Value();
+        Completion completion = executeStatement(funcDef->body.get());
+        if (completion == Completion::TAIL_CALL) {
+            funcDef = tailFunction;
+            args = std::move(tailArgs);
+            continue;
         }
+        if (completion == Completion::RETURN) {
+            result = std::move(returnValue);
+            returnValue = Value();
+        }
+        if (profile) profile->returnTypes |= 1 << (int)result.type;
+        break;
     }
 
+    frameBase = savedBase;
+    currentProfile = savedProfile;
+    inFunction = savedInFunction;
+    stack.resize(base);
+
+    if (caller) caller->returnTypes |= 1 << (int)result.type;
+    return result;
+}
+
+Value Interpreter::resumeFunction(FunctionDefNode* funcDef, std::vector<Value>& slots,
+                                  const std::vector<ASTNode*>& path, std::vector<Value>& replayed,
+                                  size_t printed) {
+    // Top-level code has no frame; a function gets its slots back
+    size_t base = stack.size();
+    FunctionProfile* profile = nullptr;
+    if (funcDef) {
+        profile = &profiles[funcDef];
+        stack.resize(base + funcDef->frameSize);
+        for (size_t i = 0; i < slots.size() && i < (size_t)funcDef->frameSize; ++i) {
+            stack[base + i] = std::move(slots[i]);
+        }
+    }
+    size_t savedBase = frameBase;
+    FunctionProfile* savedProfile = currentProfile;
+    bool savedInFunction = inFunction;
+    std::vector<Value> savedReplay = std::move(replay);
+    size_t savedReplayNext = replayNext;
+    if (funcDef) frameBase = base;
+    currentProfile = profile;
+    inFunction = funcDef != nullptr;
+    replay = std::move(replayed);
+    replayNext = 0;
+    printSkip = printed;
+
     Value result;
-    try {
-        executeStatement(funcDef->body.get());
-    } catch (const ReturnException& e) {
-        result = e.value;
+    Completion completion = resume(path, 0);
+    if (completion == Completion::RETURN) {
+        result = std::move(returnValue);
+        returnValue = Value();
     }
 
-    variables = savedVars;
+    frameBase = savedBase;
+    currentProfile = savedProfile;
+    inFunction = savedInFunction;
+    replay = std::move(savedReplay);
+    replayNext = savedReplayNext;
+    stack.resize(base);
 
+    // The frame is gone; a pending tail call runs as an ordinary one
+    if (completion == Completion::TAIL_CALL) {
+        std::vector<Value> args = std::move(tailArgs);
+        result = callFunction(tailFunction, args);
+    }
+
+    if (profile) profile->returnTypes |= 1 << (int)result.type;
     return result;
 }
 
+Completion Interpreter::resume(const std::vector<ASTNode*>& path, size_t depth) {
+    ASTNode* node = path[depth];
+    if (depth + 1 == path.size()) {
+        Completion completion = executeStatement(node);
+        replay.clear();
+        replayNext = 0;
+        return completion;
+    }
+
+    // Finish the enclosing statements around the resumed one
+    ASTNode* next = path[depth + 1];
+    switch (node->type) {
+        case ASTNodeType::BLOCK: {
+            auto& statements = static_cast<BlockNode*>(node)->statements;
+            size_t i = 0;
+            while (statements[i].get() != next) i++;
+            Completion completion = resume(path, depth + 1);
+            for (i++; completion == Completion::NORMAL && i < statements.size(); i++) {
+                completion = executeStatement(statements[i].get());
+            }
+            return completion;
+        }
+        case ASTNodeType::WHILE_STMT: {
+            // The body finishes this iteration, then the loop carries on
+            Completion completion = resume(path, depth + 1);
+            if (completion != Completion::NORMAL) return completion;
+            return executeStatement(node);
+        }
+        default:
+            // An if statement: the branch taken is the rest of it
+            return resume(path, depth + 1);
+    }
+}
+
+const Interpreter::FunctionProfile* Interpreter::profile(const FunctionDefNode* funcDef) const {
+    auto it = profiles.find(funcDef);
+    return it == profiles.end() ? nullptr : &it->second;
+}
+
+void Interpreter::deoptimized(FunctionDefNode* funcDef) {
+    FunctionProfile& profile = profiles[funcDef];
+    profile.function = funcDef;
+    profile.calls = 0;
+    profile.backedges = 0;
+    profile.state = ++profile.deopts < 3 ? FunctionProfile::COUNTING : FunctionProfile::INTERPRETED;
+}
+
+// A hot loop makes its function hot too. The running call finishes in
+// the interpreter; the next one gets the native code.
+void Interpreter::countBackedge() {
+    if (currentProfile->state == FunctionProfile::COUNTING &&
+        ++currentProfile->backedges >= loopThreshold) {
+        promote(*currentProfile);
+    }
+}
+
+bool Interpreter::enterLoop(WhileNode* loop) {
+    if (!currentProfile) {
+        return jit->enterLoop(nullptr, loop, nullptr, returnValue);
+    }
+    return jit->enterLoop(currentProfile->function, loop, stack.data() + frameBase, returnValue);
+}
+
+void Interpreter::promote(FunctionProfile& profile) {
+    profile.state = jit->compileHot(profile.function) ? FunctionProfile::NATIVE
+                                                      : FunctionProfile::INTERPRETED;
+}
+
 void Interpreter::executePrint(PrintNode* node) {
+    // After a deoptimization, compiled code may have printed the first
+    // arguments, and the tab before the next one, already
+    size_t skip = printSkip;
+    printSkip = 0;
+
     for (size_t i = 0; i < node->args.size(); ++i) {
-        if (i > 0) std::cout << "\t";
+        if (i > 0 && i > skip) std::cout << "\t";
 
         Value val = evaluate(node->args[i].get());
+        if (i < skip) continue;
         switch (val.type) {
             case ValueType::INTEGER:
                 std::cout << val.asInteger();
@@ -2,58 +2,135 @@
 #define INTERPRETER_H
 
 #include "ast.h"
-#include <variant>
+#include "value.h"
+#include "globals.h"
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <functional>
 
-enum class ValueType {
-    INTEGER,
-    BOOLEAN,
-    STRING,
-    NONE
+// How a statement finished. RETURN unwinds statement by statement up to
+// the enclosing call, which picks up Interpreter::returnValue. TAIL_CALL
+// unwinds the same way for 'return f(...)', and the enclosing call then
+// runs Interpreter::tailFunction in the frame it is leaving.
+enum class Completion {
+    NORMAL,
+    RETURN,
+    TAIL_CALL
 };
 
-class Value {
+// A compiler tier the interpreter can hand hot functions to
+class HotCodeCompiler {
 public:
-    ValueType type;
-    std::variant<long long, bool, std::string> data;
-
-    Value() : type(ValueType::NONE) {}
-    Value(long long i) : type(ValueType::INTEGER), data(i) {}
-    Value(bool b) : type(ValueType::BOOLEAN), data(b) {}
-    Value(const std::string& s) : type(ValueType::STRING), data(s) {}
-
-    long long asInteger() const { return std::get<long long>(data); }
-    bool asBoolean() const {
-        if (type == ValueType::BOOLEAN) return std::get<bool>(data);
-        if (type == ValueType::INTEGER) return std::get<long long>(data) != 0;
-        return true;
-    }
-    std::string asString() const { return std::get<std::string>(data); }
+    virtual ~HotCodeCompiler() = default;
 
-    bool isNone() const { return type == ValueType::NONE; }
-};
+    // Compile a function that got hot; false leaves it interpreted for good
+    virtual bool compileHot(FunctionDefNode* funcDef) = 0;
 
-class ReturnException {
-public:
-    Value value;
-    ReturnException(const Value& v) : value(v) {}
+    // Run a function compileHot accepted. Returns false, without side
+    // effects, when the arguments don't suit the compiled code.
+    virtual bool callNative(FunctionDefNode* funcDef, std::vector<Value>& args, Value& result) = 0;
+
+    // On-stack replacement: finish a hot loop, which has just completed an
+    // iteration, in native code, along with the rest of the function (frame
+    // holds its slots) or, for a top-level loop (funcDef null), the rest of
+    // the program; result is what it returns. False means nothing ran and
+    // the interpreter goes on.
+    virtual bool enterLoop(FunctionDefNode* funcDef, WhileNode* loop, Value* frame, Value& result) = 0;
+
+    // A function name now refers to a different definition; compiled code
+    // must stop calling the old one
+    virtual void functionRedefined(Symbol name) = 0;
 };
 
 class Interpreter {
 public:
-    std::map<std::string, Value> variables;
-    std::map<std::string, FunctionDefNode*> functions;
+    GlobalTable globals;
+    std::unordered_map<Symbol, FunctionDefNode*> functions;
+    // The definition a name refers to, or null
+    FunctionDefNode* definition(Symbol name) const {
+        auto it = functions.find(name);
+        return it != functions.end() ? it->second : nullptr;
+    }
+
+    // Tiering: with a compiler attached, every function counts its calls
+    // and loop back-edges, and is handed over once either count reaches
+    // its threshold. A single run of a loop reaching the loop threshold
+    // moves to native code on the spot.
+    HotCodeCompiler* jit = nullptr;
+    uint32_t callThreshold = 100;
+    uint32_t loopThreshold = 1000;
+
+    // What a function has been seen doing: counters for tiering, and type
+    // feedback (masks of 1 << ValueType) for the compiler to specialize on
+    struct FunctionProfile {
+        enum State : uint8_t { COUNTING, NATIVE, INTERPRETED };
+        FunctionDefNode* function = nullptr;
+        uint32_t calls = 0;
+        uint32_t backedges = 0;
+        State state = COUNTING;
+        uint8_t deopts = 0;
+        std::vector<uint8_t> argTypes;
+        uint8_t returnTypes = 0;
+    };
+    const FunctionProfile* profile(const FunctionDefNode* funcDef) const;
 
-    void execute(BlockNode* root);
+    // Compiled code for funcDef bailed out; count it again from scratch,
+    // and after a few bailouts leave it interpreted
+    void deoptimized(FunctionDefNode* funcDef);
+
+    // Deoptimization: finish a call that compiled code started. slots is
+    // the frame as it was when the compiled code gave up, and execution
+    // continues at the innermost statement of path (a chain of nested
+    // statements starting at the function body). That statement runs
+    // again from the start with replay standing in for the calls it had
+    // already made, and without repeating the first printed arguments of
+    // a print. A null funcDef resumes a top-level loop.
+    Value resumeFunction(FunctionDefNode* funcDef, std::vector<Value>& slots,
+                         const std::vector<ASTNode*>& path, std::vector<Value>& replay,
+                         size_t printed);
+
+    // Make a definition the one its name refers to; true if it replaces
+    // another
+    bool define(FunctionDefNode* funcDef);
+
+    Completion execute(BlockNode* root);
     Value evaluate(ASTNode* node);
-    Value executeStatement(ASTNode* stmt);
+    Completion executeStatement(ASTNode* stmt);
+
+    // Run a function body in a fresh frame; args fill the parameter slots
+    Value callFunction(FunctionDefNode* funcDef, std::vector<Value>& args);
 
 private:
+    // Call frames live contiguously on a slot stack; the running function's
+    // slots start at frameBase and are indexed by resolveSlots annotations.
+    // Top-level code has no frame: every variable there is global.
+    std::vector<Value> stack;
+    size_t frameBase = 0;
+
+    // Value of the 'return' being unwound, or the tail call
+    Value returnValue;
+    FunctionDefNode* tailFunction = nullptr;
+    std::vector<Value> tailArgs;
+    bool inFunction = false;  // whether 'return' leaves a function
+
+    std::unordered_map<const FunctionDefNode*, FunctionProfile> profiles;
+    FunctionProfile* currentProfile = nullptr;  // running function, if profiled
+
+    // Deoptimization state for the statement being resumed
+    std::vector<Value> replay;
+    size_t replayNext = 0;
+    size_t printSkip = 0;
+
     Value evaluateBinaryOp(BinaryOpNode* node);
     Value evaluateUnaryOp(UnaryOpNode* node);
     Value evaluateFunctionCall(FunctionCallNode* node);
+    FunctionDefNode* evaluateArguments(FunctionCallNode* node, std::vector<Value>& args);
     void executePrint(PrintNode* node);
+    void countBackedge();
+    bool enterLoop(WhileNode* loop);
+    Completion resume(const std::vector<ASTNode*>& path, size_t depth);
+    void promote(FunctionProfile& profile);
 };
 
 #endif
@@ -0,0 +1,203 @@
+#include "ir.h"
+
+std::vector<int> IRFunction::successors(int block) const {
+    const IRBlock& b = blocks[block];
+    if (!b.terminated()) return {};
+
+    const IRInstr& term = b.instrs.back();
+    switch (term.op) {
+        case IROp::JUMP:
+            return {term.target};
+        case IROp::BRANCH:
+            return {term.target, term.elseTarget};
+        default:
+            return {};
+    }
+}
+
+std::vector<std::vector<int>> IRFunction::predecessors() const {
+    std::vector<std::vector<int>> preds(blocks.size());
+    for (size_t b = 0; b < blocks.size(); b++) {
+        for (int s : successors(b)) {
+            preds[s].push_back(b);
+        }
+    }
+    return preds;
+}
+
+std::vector<int> IRFunction::reversePostOrder() const {
+    std::vector<int> order;
+    std::vector<bool> visited(blocks.size());
+
+    // Iterative DFS; each entry is (block, next successor to visit)
+    std::vector<std::pair<int, size_t>> stack;
+    stack.push_back({0, 0});
+    visited[0] = true;
+    while (!stack.empty()) {
+        int block = stack.back().first;
+        std::vector<int> succs = successors(block);
+        if (stack.back().second < succs.size()) {
+            int s = succs[stack.back().second++];
+            if (!visited[s]) {
+                visited[s] = true;
+                stack.push_back({s, 0});
+            }
+        } else {
+            order.push_back(block);
+            stack.pop_back();
+        }
+    }
+    return std::vector<int>(order.rbegin(), order.rend());
+}
+
+void IRFunction::renumberBlocks(const std::vector<int>& order) {
+    std::vector<int> newIndex(blocks.size(), -1);
+    for (size_t i = 0; i < order.size(); i++) {
+        newIndex[order[i]] = i;
+    }
+
+    std::vector<IRBlock> reordered;
+    for (int old : order) {
+        reordered.push_back(std::move(blocks[old]));
+    }
+    blocks = std::move(reordered);
+
+    for (auto& block : blocks) {
+        for (auto& instr : block.instrs) {
+            if (instr.target >= 0) instr.target = newIndex[instr.target];
+            if (instr.elseTarget >= 0) instr.elseTarget = newIndex[instr.elseTarget];
+            for (int& pred : instr.phiBlocks) pred = newIndex[pred];
+        }
+    }
+}
+
+void IRFunction::retarget(int pred, int from, int to) {
+    IRInstr& term = blocks[pred].instrs.back();
+    if (term.target == from) term.target = to;
+    if (term.elseTarget == from) term.elseTarget = to;
+}
+
+IRBuilder::IRBuilder(IRFunction& f) : func(f) {
+    block = func.blocks.empty() ? func.newBlock() : 0;
+}
+
+IRInstr& IRBuilder::append(IROp op) {
+    // Nothing may follow a terminator in the same block
+    if (func.blocks[block].terminated()) {
+        block = func.newBlock();
+    }
+    func.blocks[block].instrs.emplace_back(op);
+    return func.blocks[block].instrs.back();
+}
+
+int IRBuilder::emitConst(long long value, IRType type) {
+    IRInstr& instr = append(IROp::CONST);
+    instr.dst = func.newVReg(type);
+    instr.imm = value;
+    return instr.dst;
+}
+
+void IRBuilder::emitMove(int dst, int src) {
+    IRInstr& instr = append(IROp::MOVE);
+    instr.dst = dst;
+    instr.args = {src};
+}
+
+void IRBuilder::emitArg(int dst, int index) {
+    IRInstr& instr = append(IROp::ARG);
+    instr.dst = dst;
+    instr.imm = index;
+}
+
+int IRBuilder::emitArgs() {
+    IRInstr& instr = append(IROp::ARGS);
+    instr.dst = func.newVReg();
+    return instr.dst;
+}
+
+int IRBuilder::emitBinary(IROp op, int left, int right) {
+    bool isBool = op >= IROp::CMP_EQ && op <= IROp::OR;
+    IRInstr& instr = append(op);
+    instr.dst = func.newVReg(isBool ? IRType::BOOL : IRType::INT);
+    instr.args = {left, right};
+    return instr.dst;
+}
+
+int IRBuilder::emitUnary(IROp op, int operand) {
+    IRInstr& instr = append(op);
+    instr.dst = func.newVReg(op == IROp::NOT ? IRType::BOOL : IRType::INT);
+    instr.args = {operand};
+    return instr.dst;
+}
+
+int IRBuilder::emitCall(const std::string& callee, const std::vector<int>& args, IRType resultType) {
+    IRInstr& instr = append(IROp::CALL);
+    instr.dst = func.newVReg(resultType);
+    instr.args = args;
+    instr.callee = callee;
+    return instr.dst;
+}
+
+void IRBuilder::emitCallRuntime(void* runtimeFunc, const std::vector<int>& args) {
+    IRInstr& instr = append(IROp::CALL_RUNTIME);
+    instr.args = args;
+    instr.runtimeFunc = runtimeFunc;
+}
+
+int IRBuilder::emitCallRuntime(void* runtimeFunc, const std::vector<int>& args, IRType resultType) {
+    IRInstr& instr = append(IROp::CALL_RUNTIME);
+    instr.dst = func.newVReg(resultType);
+    instr.args = args;
+    instr.runtimeFunc = runtimeFunc;
+    return instr.dst;
+}
+
+int IRBuilder::emitResultType() {
+    IRInstr& instr = append(IROp::RESULT_TYPE);
+    instr.dst = func.newVReg();
+    return instr.dst;
+}
+
+int IRBuilder::emitGlobals() {
+    IRInstr& instr = append(IROp::GLOBALS);
+    instr.dst = func.newVReg();
+    return instr.dst;
+}
+
+int IRBuilder::emitLoad(int address, int offset, IRType type) {
+    IRInstr& instr = append(IROp::LOAD);
+    instr.dst = func.newVReg(type);
+    instr.args = {address};
+    instr.imm = offset;
+    return instr.dst;
+}
+
+void IRBuilder::emitStore(int address, int offset, int value) {
+    IRInstr& instr = append(IROp::STORE);
+    instr.args = {address, value};
+    instr.imm = offset;
+}
+
+void IRBuilder::emitJump(int target) {
+    IRInstr& instr = append(IROp::JUMP);
+    instr.target = target;
+}
+
+void IRBuilder::emitBranch(int cond, int ifTrue, int ifFalse) {
+    IRInstr& instr = append(IROp::BRANCH);
+    instr.args = {cond};
+    instr.target = ifTrue;
+    instr.elseTarget = ifFalse;
+}
+
+void IRBuilder::emitReturn(int value, int type) {
+    IRInstr& instr = append(IROp::RETURN);
+    instr.args = {value, type};
+}
+
+void IRBuilder::emitTailCall(const std::string& callee, int area, const std::vector<int>& args) {
+    IRInstr& instr = append(IROp::TAIL_CALL);
+    instr.args = {area};
+    instr.args.insert(instr.args.end(), args.begin(), args.end());
+    instr.callee = callee;
+}
@@ -0,0 +1,180 @@
+#ifndef IR_H
+#define IR_H
+
+#include <vector>
+#include <string>
+
+// Per-function intermediate representation used by NativeJIT between the
+// AST and the CodeGenerator backends. Values are virtual registers (vregs);
+// a function is a list of basic blocks, each ending in a terminator.
+//
+// The builder emits locals as vregs assigned in several places. For
+// optimization the function is put into SSA form (constructSSA), where every
+// vreg has exactly one definition and PHIs merge values at join points, and
+// taken out again (destructSSA) before register allocation.
+
+// Static type of a vreg. Compiled code keeps a value's payload in the vreg
+// (see Value::bits): strings as StringObject pointers, nil as 0.
+enum class IRType { INT, BOOL, STRING, NIL };
+
+enum class IROp {
+    CONST,          // dst = imm
+    MOVE,           // dst = args[0]
+    ARG,            // dst = incoming argument #imm (entry block only)
+    ARGS,           // dst = address of the incoming argument array (entry block only)
+
+    // dst = args[0] op args[1]
+    ADD, SUB, MUL, DIV, MOD,
+    CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE,
+    AND, OR,
+
+    // dst = op args[0]
+    NOT, NEG,
+
+    CALL,           // dst = callee(args...) through a direct call
+    CALL_RUNTIME,   // [dst =] runtimeFunc(args...)
+    RESULT_TYPE,    // dst = type tag returned along with the preceding call's result
+
+    GLOBALS,        // dst = address of the global variable table (entry block only)
+    LOAD,           // dst = the word at address args[0] + imm
+    STORE,          // the word at address args[0] + imm = args[1]
+
+    PHI,            // dst = args[i] when entered from phiBlocks[i] (block head only)
+
+    JUMP,           // goto target
+    BRANCH,         // if args[0] goto target else elseTarget
+    RETURN,         // return args[0], with type tag args[1]
+    TAIL_CALL       // return callee(args[1]...), jumping to it from this frame with
+                    // the arguments stored over the incoming array args[0]
+};
+
+struct IRInstr {
+    IROp op;
+    int dst = -1;
+    std::vector<int> args;
+    long long imm = 0;
+    int target = -1;
+    int elseTarget = -1;
+    std::string callee;
+    void* runtimeFunc = nullptr;
+    std::vector<int> phiBlocks;
+
+    IRInstr(IROp o) : op(o) {}
+
+    bool isTerminator() const {
+        return op == IROp::JUMP || op == IROp::BRANCH || op == IROp::RETURN || op == IROp::TAIL_CALL;
+    }
+
+    // Calls, memory accesses and terminators must stay (and RESULT_TYPE
+    // right behind its call); everything else is a pure function of its
+    // operands and may be removed, merged or moved
+    bool hasSideEffects() const {
+        return op == IROp::CALL || op == IROp::CALL_RUNTIME || op == IROp::RESULT_TYPE ||
+               op == IROp::LOAD || op == IROp::STORE || isTerminator();
+    }
+};
+
+struct IRBlock {
+    std::vector<IRInstr> instrs;
+
+    bool terminated() const { return !instrs.empty() && instrs.back().isTerminator(); }
+};
+
+class IRFunction {
+public:
+    std::string name;
+    int vregCount = 0;
+    std::vector<IRType> types;     // indexed by vreg
+    std::vector<IRBlock> blocks;   // blocks[0] is the entry
+
+    int newVReg(IRType type = IRType::INT) {
+        types.push_back(type);
+        return vregCount++;
+    }
+    int newBlock() {
+        blocks.emplace_back();
+        return blocks.size() - 1;
+    }
+
+    // Successor block indices of a block's terminator
+    std::vector<int> successors(int block) const;
+    std::vector<std::vector<int>> predecessors() const;
+
+    // Blocks reachable from the entry, in reverse postorder
+    std::vector<int> reversePostOrder() const;
+
+    // Reorder blocks to 'order' (old indices), dropping blocks not listed.
+    // Edges and PHI inputs from dropped blocks must already be gone.
+    void renumberBlocks(const std::vector<int>& order);
+
+    // Redirect edges from 'pred' to 'from' so they go to 'to' instead
+    void retarget(int pred, int from, int to);
+};
+
+// Dominator tree over the reachable blocks (Cooper, Harvey & Kennedy)
+class DominatorTree {
+public:
+    DominatorTree(const IRFunction& func);
+
+    bool reachable(int block) const { return rpoIndex[block] >= 0; }
+    int idom(int block) const { return idoms[block]; }
+    bool dominates(int a, int b) const;
+    const std::vector<int>& children(int block) const { return kids[block]; }
+    const std::vector<int>& frontier(int block) const { return frontiers[block]; }
+    const std::vector<int>& reversePostOrder() const { return rpo; }
+
+private:
+    std::vector<int> rpo;
+    std::vector<int> rpoIndex;
+    std::vector<int> idoms;
+    std::vector<std::vector<int>> kids;
+    std::vector<std::vector<int>> frontiers;
+};
+
+// Drop blocks unreachable from the entry, along with PHI inputs from them
+void removeUnreachableBlocks(IRFunction& func);
+
+// Rename multiply-assigned vregs into SSA form, inserting PHIs on the
+// iterated dominance frontier of their definitions
+void constructSSA(IRFunction& func);
+
+// Replace PHIs by copies in (split) predecessor edges
+void destructSSA(IRFunction& func);
+
+// Appends instructions to the current block of an IRFunction
+class IRBuilder {
+public:
+    IRBuilder(IRFunction& f);
+
+    IRFunction& function() { return func; }
+    int currentBlock() const { return block; }
+    void setBlock(int b) { block = b; }
+
+    int emitConst(long long value, IRType type = IRType::INT);
+    void emitMove(int dst, int src);
+    void emitArg(int dst, int index);
+    int emitArgs();
+    int emitBinary(IROp op, int left, int right);
+    int emitUnary(IROp op, int operand);
+    int emitCall(const std::string& callee, const std::vector<int>& args, IRType resultType);
+    void emitCallRuntime(void* func, const std::vector<int>& args);
+    int emitCallRuntime(void* func, const std::vector<int>& args, IRType resultType);
+    int emitResultType();
+    int emitGlobals();
+    int emitLoad(int address, int offset, IRType type = IRType::INT);
+    void emitStore(int address, int offset, int value);
+
+    // Terminators. Code emitted after RETURN goes to a fresh unreachable block.
+    void emitJump(int target);
+    void emitBranch(int cond, int ifTrue, int ifFalse);
+    void emitReturn(int value, int type);
+    void emitTailCall(const std::string& callee, int area, const std::vector<int>& args);
+
+private:
+    IRFunction& func;
+    int block;
+
+    IRInstr& append(IROp op);
+};
+
+#endif // IR_H
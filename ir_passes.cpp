@@ -0,0 +1,389 @@
+#include "ir_passes.h"
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <numeric>
+#include <tuple>
+
+static bool isBinary(IROp op) { return op >= IROp::ADD && op <= IROp::OR; }
+static bool isUnary(IROp op) { return op == IROp::NOT || op == IROp::NEG; }
+
+static bool isCommutative(IROp op) {
+    return op == IROp::ADD || op == IROp::MUL || op == IROp::CMP_EQ ||
+           op == IROp::CMP_NE || op == IROp::AND || op == IROp::OR;
+}
+
+// Evaluate a binary operation with the JIT's 64-bit wrapping semantics.
+// Division that would trap at run time is left alone.
+static bool evaluateBinary(IROp op, long long l, long long r, long long& out) {
+    unsigned long long ul = l, ur = r;
+    switch (op) {
+        case IROp::ADD: out = (long long)(ul + ur); return true;
+        case IROp::SUB: out = (long long)(ul - ur); return true;
+        case IROp::MUL: out = (long long)(ul * ur); return true;
+        case IROp::DIV:
+        case IROp::MOD:
+            if (r == 0 || (l == LLONG_MIN && r == -1)) return false;
+            out = op == IROp::DIV ? l / r : l % r;
+            return true;
+        case IROp::CMP_EQ: out = l == r; return true;
+        case IROp::CMP_NE: out = l != r; return true;
+        case IROp::CMP_LT: out = l < r; return true;
+        case IROp::CMP_LE: out = l <= r; return true;
+        case IROp::CMP_GT: out = l > r; return true;
+        case IROp::CMP_GE: out = l >= r; return true;
+        case IROp::AND: out = l != 0 && r != 0; return true;
+        case IROp::OR: out = l != 0 || r != 0; return true;
+        default: return false;
+    }
+}
+
+static void makeConst(IRInstr& instr, long long value) {
+    instr.op = IROp::CONST;
+    instr.imm = value;
+    instr.args.clear();
+    instr.phiBlocks.clear();
+}
+
+static void makeMove(IRInstr& instr, int src) {
+    instr.op = IROp::MOVE;
+    instr.args = {src};
+    instr.phiBlocks.clear();
+}
+
+// Drop the PHI inputs of 'block' that arrive along one edge from 'pred'
+static void removePhiInput(IRFunction& func, int block, int pred) {
+    for (auto& instr : func.blocks[block].instrs) {
+        if (instr.op != IROp::PHI) break;
+        for (size_t i = 0; i < instr.phiBlocks.size(); i++) {
+            if (instr.phiBlocks[i] == pred) {
+                instr.phiBlocks.erase(instr.phiBlocks.begin() + i);
+                instr.args.erase(instr.args.begin() + i);
+                break;
+            }
+        }
+    }
+}
+
+bool foldConstants(IRFunction& func) {
+    bool changed = false;
+    bool branchFolded = false;
+    std::vector<bool> known(func.vregCount);
+    std::vector<long long> value(func.vregCount);
+
+    // Reverse postorder visits definitions before their uses, except
+    // around loop back edges
+    for (int b : func.reversePostOrder()) {
+        for (auto& instr : func.blocks[b].instrs) {
+            if (isBinary(instr.op)) {
+                int l = instr.args[0], r = instr.args[1];
+                long long result;
+                if (known[l] && known[r] && evaluateBinary(instr.op, value[l], value[r], result)) {
+                    makeConst(instr, result);
+                    changed = true;
+                } else if ((instr.op == IROp::ADD || instr.op == IROp::SUB) && known[r] && value[r] == 0) {
+                    makeMove(instr, l);
+                    changed = true;
+                } else if (instr.op == IROp::ADD && known[l] && value[l] == 0) {
+                    makeMove(instr, r);
+                    changed = true;
+                } else if (instr.op == IROp::MUL && known[r] && value[r] == 1) {
+                    makeMove(instr, l);
+                    changed = true;
+                } else if (instr.op == IROp::MUL && known[l] && value[l] == 1) {
+                    makeMove(instr, r);
+                    changed = true;
+                }
+            } else if (isUnary(instr.op) && known[instr.args[0]]) {
+                long long v = value[instr.args[0]];
+                makeConst(instr, instr.op == IROp::NOT ? !v : (long long)(0ULL - (unsigned long long)v));
+                changed = true;
+            } else if (instr.op == IROp::PHI) {
+                // A PHI whose inputs (ignoring itself) are all the same value
+                int same = -1;
+                bool trivial = true;
+                for (int arg : instr.args) {
+                    if (arg == instr.dst || arg == same) continue;
+                    if (same < 0) {
+                        same = arg;
+                    } else if (!(known[arg] && known[same] && value[arg] == value[same])) {
+                        trivial = false;
+                        break;
+                    }
+                }
+                if (trivial && same >= 0) {
+                    if (known[same]) {
+                        makeConst(instr, value[same]);
+                    } else {
+                        makeMove(instr, same);
+                    }
+                    changed = true;
+                }
+            } else if (instr.op == IROp::BRANCH) {
+                int cond = instr.args[0];
+                int taken = -1;
+                if (known[cond]) {
+                    taken = value[cond] ? instr.target : instr.elseTarget;
+                } else if (instr.target == instr.elseTarget) {
+                    taken = instr.target;
+                }
+                if (taken >= 0) {
+                    int dropped = taken == instr.target ? instr.elseTarget : instr.target;
+                    removePhiInput(func, dropped, b);
+                    instr.op = IROp::JUMP;
+                    instr.args.clear();
+                    instr.target = taken;
+                    instr.elseTarget = -1;
+                    changed = true;
+                    branchFolded = true;
+                }
+            }
+
+            if (instr.op == IROp::CONST) {
+                known[instr.dst] = true;
+                value[instr.dst] = instr.imm;
+            }
+        }
+    }
+
+    if (branchFolded) {
+        removeUnreachableBlocks(func);
+    }
+    return changed;
+}
+
+bool propagateCopies(IRFunction& func) {
+    std::vector<int> replacement(func.vregCount);
+    std::iota(replacement.begin(), replacement.end(), 0);
+
+    bool found = false;
+    for (const auto& block : func.blocks) {
+        for (const auto& instr : block.instrs) {
+            if (instr.op == IROp::MOVE) {
+                replacement[instr.dst] = instr.args[0];
+                found = true;
+            }
+        }
+    }
+    if (!found) return false;
+
+    auto resolve = [&](int v) {
+        while (replacement[v] != v) v = replacement[v];
+        return v;
+    };
+
+    for (auto& block : func.blocks) {
+        auto& instrs = block.instrs;
+        instrs.erase(std::remove_if(instrs.begin(), instrs.end(),
+                                    [](const IRInstr& instr) { return instr.op == IROp::MOVE; }),
+                     instrs.end());
+        for (auto& instr : instrs) {
+            for (int& arg : instr.args) arg = resolve(arg);
+        }
+    }
+    return true;
+}
+
+bool eliminateCommonSubexpressions(IRFunction& func) {
+    typedef std::tuple<IROp, long long, int, std::vector<int>> Key;
+    DominatorTree dom(func);
+    std::map<Key, int> available;
+    std::vector<Key> scope;  // keys added, undone when leaving a subtree
+    bool changed = false;
+
+    // Walk the dominator tree; entries are (block, scope mark or -1)
+    std::vector<std::pair<int, long>> work;
+    work.push_back({0, -1});
+    while (!work.empty()) {
+        auto& top = work.back();
+        if (top.second >= 0) {
+            while ((long)scope.size() > top.second) {
+                available.erase(scope.back());
+                scope.pop_back();
+            }
+            work.pop_back();
+            continue;
+        }
+        int b = top.first;
+        top.second = scope.size();
+
+        for (auto& instr : func.blocks[b].instrs) {
+            if (instr.op != IROp::CONST && !isBinary(instr.op) && !isUnary(instr.op)) continue;
+
+            std::vector<int> args = instr.args;
+            if (isCommutative(instr.op)) std::sort(args.begin(), args.end());
+            Key key(instr.op, instr.imm, (int)func.types[instr.dst], args);
+
+            auto it = available.find(key);
+            if (it != available.end()) {
+                makeMove(instr, it->second);
+                changed = true;
+            } else {
+                available[key] = instr.dst;
+                scope.push_back(key);
+            }
+        }
+
+        for (int child : dom.children(b)) {
+            work.push_back({child, -1});
+        }
+    }
+    return changed;
+}
+
+bool hoistLoopInvariants(IRFunction& func) {
+    DominatorTree dom(func);
+    std::vector<std::vector<int>> preds = func.predecessors();
+    size_t blockCount = func.blocks.size();
+    bool changed = false;
+
+    std::vector<int> defBlock(func.vregCount, -1);
+    std::vector<bool> known(func.vregCount);
+    std::vector<long long> value(func.vregCount);
+    for (size_t b = 0; b < blockCount; b++) {
+        for (const auto& instr : func.blocks[b].instrs) {
+            if (instr.dst < 0) continue;
+            defBlock[instr.dst] = b;
+            if (instr.op == IROp::CONST) {
+                known[instr.dst] = true;
+                value[instr.dst] = instr.imm;
+            }
+        }
+    }
+
+    for (int header : dom.reversePostOrder()) {
+        // Natural loop: the header plus everything reaching a back edge
+        // source without passing through the header
+        std::vector<bool> inLoop(blockCount);
+        std::vector<int> worklist;
+        for (int p : preds[header]) {
+            if (dom.dominates(header, p) && !inLoop[p]) {
+                inLoop[p] = true;
+                worklist.push_back(p);
+            }
+        }
+        if (worklist.empty()) continue;
+        inLoop[header] = true;
+        while (!worklist.empty()) {
+            int b = worklist.back();
+            worklist.pop_back();
+            for (int p : preds[b]) {
+                if (!inLoop[p]) {
+                    inLoop[p] = true;
+                    worklist.push_back(p);
+                }
+            }
+        }
+
+        // Only loops entered from a single block that just jumps to the
+        // header, which is how IRBuilder lays out while loops
+        int preheader = -1;
+        int outside = 0;
+        for (int p : preds[header]) {
+            if (!inLoop[p]) {
+                preheader = p;
+                outside++;
+            }
+        }
+        if (outside != 1 || func.successors(preheader).size() != 1) continue;
+
+        for (int b : dom.reversePostOrder()) {
+            if (!inLoop[b]) continue;
+            auto& instrs = func.blocks[b].instrs;
+            for (size_t i = 0; i < instrs.size();) {
+                const IRInstr& instr = instrs[i];
+                bool hoistable = instr.op == IROp::CONST || isBinary(instr.op) || isUnary(instr.op);
+                if (instr.op == IROp::DIV || instr.op == IROp::MOD) {
+                    // Division may trap, so only when the divisor is safe
+                    int r = instr.args[1];
+                    hoistable = known[r] && value[r] != 0 && value[r] != -1;
+                }
+                for (int arg : instr.args) {
+                    if (inLoop[defBlock[arg]]) hoistable = false;
+                }
+                if (!hoistable) {
+                    i++;
+                    continue;
+                }
+
+                auto& target = func.blocks[preheader].instrs;
+                defBlock[instr.dst] = preheader;
+                target.insert(target.end() - 1, instr);
+                instrs.erase(instrs.begin() + i);
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+bool eliminateDeadCode(IRFunction& func) {
+    std::vector<std::pair<int, int>> defSite(func.vregCount, {-1, -1});
+    std::vector<std::vector<bool>> live(func.blocks.size());
+    std::vector<int> worklist;
+
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        const auto& instrs = func.blocks[b].instrs;
+        live[b].assign(instrs.size(), false);
+        for (size_t i = 0; i < instrs.size(); i++) {
+            if (instrs[i].dst >= 0) defSite[instrs[i].dst] = {b, i};
+            if (instrs[i].hasSideEffects()) {
+                live[b][i] = true;
+                worklist.insert(worklist.end(), instrs[i].args.begin(), instrs[i].args.end());
+            }
+        }
+    }
+
+    // Mark everything the side-effecting instructions depend on; dead PHI
+    // cycles are never reached
+    while (!worklist.empty()) {
+        int v = worklist.back();
+        worklist.pop_back();
+        auto site = defSite[v];
+        if (site.first < 0 || live[site.first][site.second]) continue;
+        live[site.first][site.second] = true;
+        const auto& args = func.blocks[site.first].instrs[site.second].args;
+        worklist.insert(worklist.end(), args.begin(), args.end());
+    }
+
+    bool changed = false;
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        auto& instrs = func.blocks[b].instrs;
+        size_t kept = 0;
+        for (size_t i = 0; i < instrs.size(); i++) {
+            if (live[b][i]) {
+                if (kept != i) instrs[kept] = std::move(instrs[i]);
+                kept++;
+            }
+        }
+        if (kept != instrs.size()) {
+            instrs.resize(kept, IRInstr(IROp::CONST));
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void PassManager::add(const std::string& name, IRPass pass) {
+    passes.push_back({name, pass});
+}
+
+void PassManager::run(IRFunction& func) {
+    for (int iteration = 0; iteration < maxIterations; iteration++) {
+        bool changed = false;
+        for (const auto& pass : passes) {
+            if (pass.second(func)) changed = true;
+        }
+        if (!changed) break;
+    }
+}
+
+PassManager PassManager::standard() {
+    PassManager pm;
+    pm.add("constant-folding", foldConstants);
+    pm.add("copy-propagation", propagateCopies);
+    pm.add("cse", eliminateCommonSubexpressions);
+    pm.add("licm", hoistLoopInvariants);
+    pm.add("dce", eliminateDeadCode);
+    return pm;
+}
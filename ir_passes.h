@@ -0,0 +1,43 @@
+#ifndef IR_PASSES_H
+#define IR_PASSES_H
+
+#include "ir.h"
+#include <string>
+#include <vector>
+
+// Optimization passes over SSA-form IR. Each returns true if it changed
+// the function.
+typedef bool (*IRPass)(IRFunction& func);
+
+// Fold operations on constants, simplify trivial PHIs and algebraic
+// identities, and turn branches on constants into jumps
+bool foldConstants(IRFunction& func);
+
+// Replace uses of MOVE results by their source and drop the MOVEs
+bool propagateCopies(IRFunction& func);
+
+// Reuse an identical pure computation from a dominating block
+bool eliminateCommonSubexpressions(IRFunction& func);
+
+// Move pure computations whose operands are defined outside a loop into
+// the loop preheader
+bool hoistLoopInvariants(IRFunction& func);
+
+// Remove pure instructions whose results are never used
+bool eliminateDeadCode(IRFunction& func);
+
+// Runs a pipeline of passes repeatedly until none of them makes progress
+class PassManager {
+public:
+    void add(const std::string& name, IRPass pass);
+    void run(IRFunction& func);
+
+    // Constant folding, copy propagation, CSE, LICM and DCE
+    static PassManager standard();
+
+private:
+    std::vector<std::pair<std::string, IRPass>> passes;
+    static const int maxIterations = 8;
+};
+
+#endif // IR_PASSES_H
@@ -0,0 +1,287 @@
+#include "ir.h"
+#include <algorithm>
+
+DominatorTree::DominatorTree(const IRFunction& func) {
+    size_t blockCount = func.blocks.size();
+    rpo = func.reversePostOrder();
+    rpoIndex.assign(blockCount, -1);
+    for (size_t i = 0; i < rpo.size(); i++) {
+        rpoIndex[rpo[i]] = i;
+    }
+
+    std::vector<std::vector<int>> preds = func.predecessors();
+    idoms.assign(blockCount, -1);
+    idoms[0] = 0;
+
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (rpoIndex[a] > rpoIndex[b]) a = idoms[a];
+            while (rpoIndex[b] > rpoIndex[a]) b = idoms[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < rpo.size(); i++) {
+            int b = rpo[i];
+            int newIdom = -1;
+            for (int p : preds[b]) {
+                if (idoms[p] < 0) continue;
+                newIdom = newIdom < 0 ? p : intersect(p, newIdom);
+            }
+            if (idoms[b] != newIdom) {
+                idoms[b] = newIdom;
+                changed = true;
+            }
+        }
+    }
+
+    kids.assign(blockCount, {});
+    for (size_t i = 1; i < rpo.size(); i++) {
+        kids[idoms[rpo[i]]].push_back(rpo[i]);
+    }
+
+    // A join point is in the frontier of every block between each of its
+    // predecessors and its immediate dominator
+    frontiers.assign(blockCount, {});
+    for (int b : rpo) {
+        if (preds[b].size() < 2) continue;
+        for (int p : preds[b]) {
+            if (!reachable(p)) continue;
+            for (int runner = p; runner != idoms[b]; runner = idoms[runner]) {
+                auto& df = frontiers[runner];
+                if (std::find(df.begin(), df.end(), b) == df.end()) {
+                    df.push_back(b);
+                }
+            }
+        }
+    }
+}
+
+bool DominatorTree::dominates(int a, int b) const {
+    if (!reachable(b)) return false;
+    while (b != a && b != 0) {
+        b = idoms[b];
+    }
+    return b == a;
+}
+
+void removeUnreachableBlocks(IRFunction& func) {
+    std::vector<bool> reachable(func.blocks.size());
+    for (int b : func.reversePostOrder()) {
+        reachable[b] = true;
+    }
+
+    std::vector<int> order;
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        if (!reachable[b]) continue;
+        order.push_back(b);
+        for (auto& instr : func.blocks[b].instrs) {
+            if (instr.op != IROp::PHI) break;
+            for (size_t i = instr.phiBlocks.size(); i-- > 0;) {
+                if (!reachable[instr.phiBlocks[i]]) {
+                    instr.phiBlocks.erase(instr.phiBlocks.begin() + i);
+                    instr.args.erase(instr.args.begin() + i);
+                }
+            }
+        }
+    }
+    if (order.size() != func.blocks.size()) {
+        func.renumberBlocks(order);
+    }
+}
+
+void constructSSA(IRFunction& func) {
+    removeUnreachableBlocks(func);
+    DominatorTree dom(func);
+    std::vector<std::vector<int>> preds = func.predecessors();
+    size_t blockCount = func.blocks.size();
+    int originalCount = func.vregCount;
+
+    // Only vregs defined more than once (the locals) need renaming
+    std::vector<int> defCount(originalCount);
+    std::vector<std::vector<int>> defBlocks(originalCount);
+    for (size_t b = 0; b < blockCount; b++) {
+        for (const auto& instr : func.blocks[b].instrs) {
+            if (instr.dst < 0) continue;
+            defCount[instr.dst]++;
+            auto& blocks = defBlocks[instr.dst];
+            if (blocks.empty() || blocks.back() != (int)b) blocks.push_back(b);
+        }
+    }
+
+    // Place PHIs on the iterated dominance frontier. phiVars[b] records the
+    // original vreg of each PHI at the head of block b.
+    std::vector<std::vector<int>> phiVars(blockCount);
+    for (int v = 0; v < originalCount; v++) {
+        if (defCount[v] < 2) continue;
+        std::vector<bool> hasPhi(blockCount), queued(blockCount);
+        std::vector<int> worklist = defBlocks[v];
+        for (int b : worklist) queued[b] = true;
+        while (!worklist.empty()) {
+            int b = worklist.back();
+            worklist.pop_back();
+            for (int d : dom.frontier(b)) {
+                if (hasPhi[d]) continue;
+                hasPhi[d] = true;
+
+                IRInstr phi(IROp::PHI);
+                phi.dst = v;
+                phi.phiBlocks = preds[d];
+                phi.args.assign(preds[d].size(), -1);
+                auto& instrs = func.blocks[d].instrs;
+                instrs.insert(instrs.begin() + phiVars[d].size(), phi);
+                phiVars[d].push_back(v);
+
+                if (!queued[d]) {
+                    queued[d] = true;
+                    worklist.push_back(d);
+                }
+            }
+        }
+    }
+
+    // Reads of a local on a path with no assignment see zero
+    int undef = func.newVReg();
+    IRInstr zero(IROp::CONST);
+    zero.dst = undef;
+    func.blocks[0].instrs.insert(func.blocks[0].instrs.begin(), zero);
+
+    // Rename along the dominator tree, keeping a stack of the current SSA
+    // name of each local
+    std::vector<std::vector<int>> stacks(originalCount);
+    auto current = [&](int v) {
+        if (v >= originalCount || defCount[v] < 2) return v;
+        return stacks[v].empty() ? undef : stacks[v].back();
+    };
+
+    std::vector<std::pair<int, size_t>> work;  // (block, renamed-def mark)
+    std::vector<int> pushed;
+    work.push_back({0, 0});
+    std::vector<bool> visited(blockCount);
+    while (!work.empty()) {
+        int b = work.back().first;
+        if (visited[b]) {
+            // All dominated blocks done: pop this block's definitions
+            while (pushed.size() > work.back().second) {
+                stacks[pushed.back()].pop_back();
+                pushed.pop_back();
+            }
+            work.pop_back();
+            continue;
+        }
+        visited[b] = true;
+        work.back().second = pushed.size();
+
+        for (auto& instr : func.blocks[b].instrs) {
+            if (instr.op != IROp::PHI) {
+                for (int& arg : instr.args) arg = current(arg);
+            }
+            if (instr.dst >= 0 && instr.dst < originalCount && defCount[instr.dst] >= 2) {
+                int v = instr.dst;
+                instr.dst = func.newVReg(func.types[v]);
+                stacks[v].push_back(instr.dst);
+                pushed.push_back(v);
+            }
+        }
+
+        for (int s : func.successors(b)) {
+            auto& instrs = func.blocks[s].instrs;
+            for (size_t k = 0; k < phiVars[s].size(); k++) {
+                IRInstr& phi = instrs[k];
+                for (size_t i = 0; i < phi.phiBlocks.size(); i++) {
+                    if (phi.phiBlocks[i] == b) phi.args[i] = current(phiVars[s][k]);
+                }
+            }
+        }
+
+        const auto& children = dom.children(b);
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            work.push_back({*it, 0});
+        }
+    }
+}
+
+void destructSSA(IRFunction& func) {
+    size_t originalBlocks = func.blocks.size();
+    std::vector<std::vector<int>> splitAfter(originalBlocks);
+
+    for (size_t b = 0; b < originalBlocks; b++) {
+        auto& head = func.blocks[b].instrs;
+        if (head.empty() || head[0].op != IROp::PHI) continue;
+
+        // Each incoming edge gets its copies at the end of the predecessor.
+        // If the predecessor has another successor the edge is critical and
+        // the copies go in a new block on the edge instead.
+        std::vector<int> edgePreds = head[0].phiBlocks;
+        for (size_t i = 0; i < edgePreds.size(); i++) {
+            int pred = edgePreds[i];
+            int copyBlock = pred;
+            if (func.successors(pred).size() > 1) {
+                copyBlock = func.newBlock();
+                IRInstr jump(IROp::JUMP);
+                jump.target = b;
+                func.blocks[copyBlock].instrs.push_back(jump);
+                func.retarget(pred, b, copyBlock);
+                splitAfter[pred].push_back(copyBlock);
+            }
+
+            // PHIs read their inputs simultaneously; if one input is another
+            // PHI's result, copy through temporaries so no input is
+            // overwritten before it is read
+            std::vector<std::pair<int, int>> copies;  // (dst, src)
+            bool overlap = false;
+            for (const auto& phi : func.blocks[b].instrs) {
+                if (phi.op != IROp::PHI) break;
+                copies.push_back({phi.dst, phi.args[i]});
+            }
+            for (const auto& copy : copies) {
+                for (const auto& other : copies) {
+                    if (copy.second == other.first && copy.first != other.first) overlap = true;
+                }
+            }
+
+            std::vector<IRInstr> moves;
+            auto move = [&](int dst, int src) {
+                IRInstr instr(IROp::MOVE);
+                instr.dst = dst;
+                instr.args = {src};
+                moves.push_back(instr);
+            };
+            if (overlap) {
+                std::vector<int> temps;
+                for (const auto& copy : copies) {
+                    temps.push_back(func.newVReg(func.types[copy.first]));
+                    move(temps.back(), copy.second);
+                }
+                for (size_t c = 0; c < copies.size(); c++) {
+                    move(copies[c].first, temps[c]);
+                }
+            } else {
+                for (const auto& copy : copies) {
+                    if (copy.first != copy.second) move(copy.first, copy.second);
+                }
+            }
+
+            auto& instrs = func.blocks[copyBlock].instrs;
+            instrs.insert(instrs.end() - 1, moves.begin(), moves.end());
+        }
+
+        auto& instrs = func.blocks[b].instrs;
+        auto firstNonPhi = std::find_if(instrs.begin(), instrs.end(),
+                                        [](const IRInstr& instr) { return instr.op != IROp::PHI; });
+        instrs.erase(instrs.begin(), firstNonPhi);
+    }
+
+    // Lay each edge block out right after the block it was split from
+    std::vector<int> order;
+    for (size_t b = 0; b < originalBlocks; b++) {
+        order.push_back(b);
+        for (int split : splitAfter[b]) order.push_back(split);
+    }
+    if (order.size() != originalBlocks) {
+        func.renumberBlocks(order);
+    }
+}
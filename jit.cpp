@@ -1,31 +1,18 @@
 #include "jit.h"
-#include <sys/mman.h>
-#include <unistd.h>
 #include <cstring>
 #include <stdexcept>
 #include <iostream>
 
 JITCompiler::JITCompiler(Interpreter* interp) : interpreter(interp), stackOffset(0) {}
 
-JITCompiler::~JITCompiler() {
-    for (void* page : allocatedPages) {
-        munmap(page, 4096);
-    }
-}
-
-void* JITCompiler::allocateExecutableMemory(size_t size) {
-    size_t pageSize = (size + 4095) & ~4095;
-    void* ptr = mmap(nullptr, pageSize, PROT_READ | PROT_WRITE | PROT_EXEC,
-                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (ptr == MAP_FAILED) {
-        throw std::runtime_error("Failed to allocate executable memory");
-    }
-    allocatedPages.push_back(ptr);
-    return ptr;
-}
+JITCompiler::~JITCompiler() {}
 
-void JITCompiler::freeExecutableMemory(void* ptr, size_t size) {
-    munmap(ptr, size);
+void* JITCompiler::installCode() {
+    CodeCache::WriteScope writable(codeCache);
+    uint8_t* execMem = codeCache.allocate(code.size());
+    memcpy(execMem, code.data(), code.size());
+    __builtin___clear_cache((char*)execMem, (char*)execMem + code.size());
+    return execMem;
 }
 
 void JITCompiler::emit(uint8_t byte) {
@@ -126,10 +113,7 @@ void* JITCompiler::compileFunction(FunctionDefNode* func) {
 
     emitEpilogue();
 
-    void* execMem = allocateExecutableMemory(code.size());
-    memcpy(execMem, code.data(), code.size());
-
-    return execMem;
+    return installCode();
 }
 
 void JITCompiler::executeJIT(BlockNode* root) {
@@ -139,6 +123,8 @@ void JITCompiler::executeJIT(BlockNode* root) {
         if (stmt->type == ASTNodeType::FUNCTION_DEF) {
             FunctionDefNode* funcDef = static_cast<FunctionDefNode*>(stmt.get());
             void* compiledFunc = compileFunction(funcDef);
+            auto old = compiledFunctions.find(funcDef->name);
+            if (old != compiledFunctions.end()) codeCache.release(old->second);
             compiledFunctions[funcDef->name] = compiledFunc;
             interpreter->functions[funcDef->name] = funcDef;
         } else {
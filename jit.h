@@ -3,6 +3,7 @@
 
 #include "ast.h"
 #include "interpreter.h"
+#include "code_cache.h"
 #include <vector>
 #include <map>
 #include <cstdint>
@@ -17,11 +18,10 @@ public:
 
 private:
     Interpreter* interpreter;
-    std::map<std::string, void*> compiledFunctions;
-    std::vector<void*> allocatedPages;
+    std::map<Symbol, void*> compiledFunctions;
+    CodeCache codeCache;
 
-    void* allocateExecutableMemory(size_t size);
-    void freeExecutableMemory(void* ptr, size_t size);
+    void* installCode();
 
     std::vector<uint8_t> code;
     std::map<std::string, int> localVars;
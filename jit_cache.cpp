@@ -0,0 +1,445 @@
+#include "jit_cache.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// File layout version, checked along with the key
+static const uint32_t CACHE_MAGIC = 0x4C4A4331;  // "LJC1"
+
+// 64-bit FNV-1a
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static void hashBytes(uint64_t& h, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ bytes[i]) * FNV_PRIME;
+    }
+}
+
+static void hashValue(uint64_t& h, uint64_t value) {
+    hashBytes(h, &value, sizeof(value));
+}
+
+static void hashString(uint64_t& h, const std::string& s) {
+    hashValue(h, s.size());
+    hashBytes(h, s.data(), s.size());
+}
+
+// Everything that affects what a node means, children included; absent
+// children hash differently from empty ones
+static void hashNode(uint64_t& h, const ASTNode* node) {
+    if (!node) {
+        hashValue(h, ~0ULL);
+        return;
+    }
+    hashValue(h, (uint64_t)node->type);
+
+    switch (node->type) {
+        case ASTNodeType::INTEGER:
+            hashValue(h, static_cast<const IntegerNode*>(node)->value);
+            break;
+        case ASTNodeType::BOOLEAN:
+            hashValue(h, static_cast<const BooleanNode*>(node)->value);
+            break;
+        case ASTNodeType::STRING:
+            hashString(h, static_cast<const StringNode*>(node)->value().asString());
+            break;
+        case ASTNodeType::VARIABLE: {
+            const VariableNode* var = static_cast<const VariableNode*>(node);
+            hashString(h, var->name.str());
+            hashValue(h, var->slot);
+            break;
+        }
+        case ASTNodeType::BINARY_OP: {
+            const BinaryOpNode* binOp = static_cast<const BinaryOpNode*>(node);
+            hashValue(h, (uint64_t)binOp->op);
+            hashNode(h, binOp->left.get());
+            hashNode(h, binOp->right.get());
+            break;
+        }
+        case ASTNodeType::UNARY_OP: {
+            const UnaryOpNode* unOp = static_cast<const UnaryOpNode*>(node);
+            hashValue(h, (uint64_t)unOp->op);
+            hashNode(h, unOp->operand.get());
+            break;
+        }
+        case ASTNodeType::ASSIGNMENT: {
+            const AssignmentNode* assign = static_cast<const AssignmentNode*>(node);
+            hashString(h, assign->variable.str());
+            hashValue(h, assign->isLocal);
+            hashValue(h, assign->slot);
+            hashNode(h, assign->value.get());
+            break;
+        }
+        case ASTNodeType::FUNCTION_DEF: {
+            const FunctionDefNode* func = static_cast<const FunctionDefNode*>(node);
+            hashString(h, func->name.str());
+            hashValue(h, func->params.size());
+            for (const auto& param : func->params) hashString(h, param.str());
+            hashValue(h, func->frameSize);
+            hashNode(h, func->body.get());
+            break;
+        }
+        case ASTNodeType::FUNCTION_CALL: {
+            const FunctionCallNode* call = static_cast<const FunctionCallNode*>(node);
+            hashString(h, call->name.str());
+            hashValue(h, call->args.size());
+            for (const auto& arg : call->args) hashNode(h, arg.get());
+            break;
+        }
+        case ASTNodeType::RETURN:
+            hashNode(h, static_cast<const ReturnNode*>(node)->value.get());
+            break;
+        case ASTNodeType::IF_STMT: {
+            const IfNode* ifNode = static_cast<const IfNode*>(node);
+            hashNode(h, ifNode->condition.get());
+            hashNode(h, ifNode->thenBlock.get());
+            hashNode(h, ifNode->elseBlock.get());
+            break;
+        }
+        case ASTNodeType::WHILE_STMT: {
+            const WhileNode* whileNode = static_cast<const WhileNode*>(node);
+            hashNode(h, whileNode->condition.get());
+            hashNode(h, whileNode->body.get());
+            break;
+        }
+        case ASTNodeType::BLOCK: {
+            const BlockNode* block = static_cast<const BlockNode*>(node);
+            hashValue(h, block->statements.size());
+            for (const auto& stmt : block->statements) hashNode(h, stmt.get());
+            break;
+        }
+        case ASTNodeType::PRINT: {
+            const PrintNode* print = static_cast<const PrintNode*>(node);
+            hashValue(h, print->args.size());
+            for (const auto& arg : print->args) hashNode(h, arg.get());
+            break;
+        }
+        case ASTNodeType::TYPE_ANNOTATION:
+            break;
+    }
+}
+
+uint64_t JitCache::hashFunction(const FunctionDefNode* func) {
+    uint64_t h = FNV_OFFSET;
+    hashNode(h, func);
+    return h;
+}
+
+uint64_t JitCache::key(const FunctionDefNode* func, const std::vector<uint8_t>& paramTypes,
+                       const std::string& compiler) {
+    uint64_t h = FNV_OFFSET;
+    hashString(h, compiler);
+    hashValue(h, hashFunction(func));
+    hashValue(h, paramTypes.size());
+    hashBytes(h, paramTypes.data(), paramTypes.size());
+    return h;
+}
+
+static void collectNodes(ASTNode* node, std::vector<ASTNode*>& order) {
+    if (!node) return;
+    order.push_back(node);
+
+    switch (node->type) {
+        case ASTNodeType::BINARY_OP: {
+            BinaryOpNode* binOp = static_cast<BinaryOpNode*>(node);
+            collectNodes(binOp->left.get(), order);
+            collectNodes(binOp->right.get(), order);
+            break;
+        }
+        case ASTNodeType::UNARY_OP:
+            collectNodes(static_cast<UnaryOpNode*>(node)->operand.get(), order);
+            break;
+        case ASTNodeType::ASSIGNMENT:
+            collectNodes(static_cast<AssignmentNode*>(node)->value.get(), order);
+            break;
+        case ASTNodeType::FUNCTION_DEF:
+            collectNodes(static_cast<FunctionDefNode*>(node)->body.get(), order);
+            break;
+        case ASTNodeType::FUNCTION_CALL:
+            for (auto& arg : static_cast<FunctionCallNode*>(node)->args) collectNodes(arg.get(), order);
+            break;
+        case ASTNodeType::RETURN:
+            collectNodes(static_cast<ReturnNode*>(node)->value.get(), order);
+            break;
+        case ASTNodeType::IF_STMT: {
+            IfNode* ifNode = static_cast<IfNode*>(node);
+            collectNodes(ifNode->condition.get(), order);
+            collectNodes(ifNode->thenBlock.get(), order);
+            collectNodes(ifNode->elseBlock.get(), order);
+            break;
+        }
+        case ASTNodeType::WHILE_STMT: {
+            WhileNode* whileNode = static_cast<WhileNode*>(node);
+            collectNodes(whileNode->condition.get(), order);
+            collectNodes(whileNode->body.get(), order);
+            break;
+        }
+        case ASTNodeType::BLOCK:
+            for (auto& stmt : static_cast<BlockNode*>(node)->statements) collectNodes(stmt.get(), order);
+            break;
+        case ASTNodeType::PRINT:
+            for (auto& arg : static_cast<PrintNode*>(node)->args) collectNodes(arg.get(), order);
+            break;
+        default:
+            break;
+    }
+}
+
+std::vector<ASTNode*> JitCache::nodes(const FunctionDefNode* func) {
+    std::vector<ASTNode*> order;
+    collectNodes(func->body.get(), order);
+    return order;
+}
+
+JitCache::JitCache(const std::string& dir) : dir(dir) {
+    // One level only; a missing parent just means nothing gets cached
+    mkdir(dir.c_str(), 0777);
+}
+
+std::string JitCache::path(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.jit", (unsigned long long)key);
+    return dir + name;
+}
+
+// Native-endian serialization; the key already covers the architecture
+class CacheWriter {
+public:
+    std::vector<uint8_t> data;
+
+    void u32(uint32_t v) { bytes(&v, 4); }
+    void u64(uint64_t v) { bytes(&v, 8); }
+    void string(const std::string& s) {
+        u32(s.size());
+        bytes(s.data(), s.size());
+    }
+    void bytes(const void* p, size_t size) {
+        const uint8_t* b = (const uint8_t*)p;
+        data.insert(data.end(), b, b + size);
+    }
+};
+
+class CacheReader {
+public:
+    CacheReader(const std::vector<uint8_t>& data) : data(data) {}
+    bool ok = true;
+
+    uint32_t u32() {
+        uint32_t v = 0;
+        bytes(&v, 4);
+        return v;
+    }
+    uint64_t u64() {
+        uint64_t v = 0;
+        bytes(&v, 8);
+        return v;
+    }
+    std::string string() {
+        uint32_t size = u32();
+        if (!check(size)) return "";
+        std::string s((const char*)data.data() + pos, size);
+        pos += size;
+        return s;
+    }
+    void bytes(void* p, size_t size) {
+        if (!check(size)) return;
+        std::copy(data.data() + pos, data.data() + pos + size, (uint8_t*)p);
+        pos += size;
+    }
+    // Counts come from the file, so are checked against what is left
+    // before anything is sized by them
+    uint32_t count() {
+        uint32_t n = u32();
+        return check(n) ? n : 0;
+    }
+    bool atEnd() const { return ok && pos == data.size(); }
+
+private:
+    const std::vector<uint8_t>& data;
+    size_t pos = 0;
+
+    bool check(size_t size) {
+        if (!ok || data.size() - pos < size) ok = false;
+        return ok;
+    }
+};
+
+bool JitCache::load(uint64_t key, CachedFunction& entry) const {
+    std::vector<uint8_t> data;
+    if (dir.empty()) {
+        auto it = memory.find(key);
+        if (it == memory.end()) return false;
+        data = it->second;
+    } else {
+        std::ifstream file(path(key), std::ios::binary);
+        if (!file) return false;
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // The code is run as it is, so a damaged file must not get past here
+    if (data.size() < sizeof(uint64_t)) return false;
+    size_t payload = data.size() - sizeof(uint64_t);
+    uint64_t sum = FNV_OFFSET, stored;
+    hashBytes(sum, data.data(), payload);
+    memcpy(&stored, data.data() + payload, sizeof(stored));
+    if (sum != stored) return false;
+    data.resize(payload);
+
+    CacheReader in(data);
+    if (in.u32() != CACHE_MAGIC || in.u64() != key) return false;
+
+    entry.code.resize(in.count());
+    in.bytes(entry.code.data(), entry.code.size());
+
+    entry.relocations.resize(in.count());
+    for (auto& reloc : entry.relocations) {
+        reloc.offset = in.u32();
+        reloc.kind = (Relocation::Kind)in.u32();
+        reloc.symbol = in.string();
+        if (reloc.offset >= entry.code.size() || reloc.kind > Relocation::GLOBALS) return false;
+    }
+
+    entry.calls.resize(in.count());
+    for (auto& call : entry.calls) {
+        call.callOffset = in.u32();
+        call.veneerOffset = in.u32();
+        call.key = in.string();
+        call.name = in.string();
+        call.argTypes.resize(in.count());
+        in.bytes(call.argTypes.data(), call.argTypes.size());
+        if (call.callOffset >= entry.code.size() || call.veneerOffset >= entry.code.size()) return false;
+    }
+
+    entry.deopts.resize(in.count());
+    for (auto& deopt : entry.deopts) {
+        deopt.printed = in.u32();
+        deopt.path.resize(in.count());
+        for (auto& node : deopt.path) node = in.u32();
+    }
+
+    entry.inlined.resize(in.count());
+    for (auto& callee : entry.inlined) {
+        callee.first = in.string();
+        callee.second = in.u64();
+    }
+
+    entry.results.resize(in.count());
+    for (auto& result : entry.results) {
+        result.first = in.string();
+        result.second = in.u32();
+    }
+
+    entry.globals.resize(in.count());
+    for (auto& global : entry.globals) {
+        global.first = in.string();
+        global.second = in.u32();
+    }
+    return in.atEnd();
+}
+
+void JitCache::store(uint64_t key, const CachedFunction& entry) {
+    CacheWriter out;
+    out.u32(CACHE_MAGIC);
+    out.u64(key);
+
+    out.u32(entry.code.size());
+    out.bytes(entry.code.data(), entry.code.size());
+
+    out.u32(entry.relocations.size());
+    for (const auto& reloc : entry.relocations) {
+        out.u32(reloc.offset);
+        out.u32(reloc.kind);
+        out.string(reloc.symbol);
+    }
+
+    out.u32(entry.calls.size());
+    for (const auto& call : entry.calls) {
+        out.u32(call.callOffset);
+        out.u32(call.veneerOffset);
+        out.string(call.key);
+        out.string(call.name);
+        out.u32(call.argTypes.size());
+        out.bytes(call.argTypes.data(), call.argTypes.size());
+    }
+
+    out.u32(entry.deopts.size());
+    for (const auto& deopt : entry.deopts) {
+        out.u32(deopt.printed);
+        out.u32(deopt.path.size());
+        for (uint32_t node : deopt.path) out.u32(node);
+    }
+
+    out.u32(entry.inlined.size());
+    for (const auto& callee : entry.inlined) {
+        out.string(callee.first);
+        out.u64(callee.second);
+    }
+
+    out.u32(entry.results.size());
+    for (const auto& result : entry.results) {
+        out.string(result.first);
+        out.u32(result.second);
+    }
+
+    out.u32(entry.globals.size());
+    for (const auto& global : entry.globals) {
+        out.string(global.first);
+        out.u32(global.second);
+    }
+
+    uint64_t sum = FNV_OFFSET;
+    hashBytes(sum, out.data.data(), out.data.size());
+    out.u64(sum);
+    if (dir.empty()) {
+        memory[key] = std::move(out.data);
+        return;
+    }
+
+    // Written aside and renamed into place, so that runs sharing the
+    // directory never see half a file
+    std::string target = path(key);
+    std::string temp = target + "." + std::to_string(getpid());
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file.write((const char*)out.data.data(), out.data.size());
+        if (!file) {
+            file.close();
+            remove(temp.c_str());
+            return;
+        }
+    }
+    if (rename(temp.c_str(), target.c_str()) != 0) remove(temp.c_str());
+}
+
+// An image is the entries one after the other, each with its key and size
+std::vector<uint8_t> JitCache::pack() const {
+    CacheWriter out;
+    out.u32(CACHE_MAGIC);
+    out.u32(memory.size());
+    for (const auto& entry : memory) {
+        out.u64(entry.first);
+        out.u32(entry.second.size());
+        out.bytes(entry.second.data(), entry.second.size());
+    }
+    return out.data;
+}
+
+bool JitCache::unpack(const uint8_t* data, size_t size) {
+    std::vector<uint8_t> image(data, data + size);
+    CacheReader in(image);
+    if (in.u32() != CACHE_MAGIC) return false;
+    uint32_t count = in.u32();
+    for (uint32_t i = 0; i < count && in.ok; i++) {
+        uint64_t key = in.u64();
+        std::vector<uint8_t> entry(in.count());
+        in.bytes(entry.data(), entry.size());
+        memory[key] = std::move(entry);
+    }
+    return in.atEnd();
+}
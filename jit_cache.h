@@ -0,0 +1,94 @@
+#ifndef JIT_CACHE_H
+#define JIT_CACHE_H
+
+#include "ast.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// A value embedded in compiled code that is only valid in the process that
+// generated it, and where it is
+struct Relocation {
+    enum Kind : uint8_t {
+        HELPER,          // address of the runtime helper named by symbol
+        STRING,          // interned string whose contents are symbol
+        GLOBALS          // address of the global variable table
+    };
+    uint32_t offset;     // as passed to CodeGenerator::patchAddress
+    Kind kind;
+    std::string symbol;
+};
+
+// A compiled function as stored on disk: code before linking, with what
+// it takes to place it in another process
+struct CachedFunction {
+    std::vector<uint8_t> code;
+    std::vector<Relocation> relocations;
+
+    // Direct calls, each through a veneer in the code
+    struct Call {
+        uint32_t callOffset;
+        uint32_t veneerOffset;
+        std::string key;                // call target key
+        std::string name;
+        std::vector<uint8_t> argTypes;  // IRTypes
+    };
+    std::vector<Call> calls;
+
+    // Deoptimization points, in order; the path is statement numbers
+    // (see JitCache::nodes)
+    struct Deopt {
+        std::vector<uint32_t> path;
+        uint32_t printed;
+    };
+    std::vector<Deopt> deopts;
+
+    // Functions inlined into the code, with the hash of the definition
+    // that was inlined
+    std::vector<std::pair<std::string, uint64_t>> inlined;
+
+    // Result types the code speculates on, by callee (IRTypes)
+    std::vector<std::pair<std::string, uint8_t>> results;
+
+    // Globals the code reads or writes, with the slots it addresses them
+    // by
+    std::vector<std::pair<std::string, uint32_t>> globals;
+};
+
+// Compiled functions saved in a directory, one file per key, for later
+// runs to load instead of compiling again; or kept in memory, to be packed
+// into an image that goes with the program (see aot.h). Failing to read or
+// write the cache is never an error: the function is compiled as usual.
+class JitCache {
+public:
+    JitCache() = default;
+    explicit JitCache(const std::string& dir);
+
+    // Hash of a function definition's source (name, parameters, body)
+    static uint64_t hashFunction(const FunctionDefNode* func);
+
+    // Key of a function compiled for given parameter types by a given
+    // compiler
+    static uint64_t key(const FunctionDefNode* func, const std::vector<uint8_t>& paramTypes,
+                        const std::string& compiler);
+
+    // The nodes of a function body in preorder, which is how deopt paths
+    // are numbered
+    static std::vector<ASTNode*> nodes(const FunctionDefNode* func);
+
+    bool load(uint64_t key, CachedFunction& entry) const;
+    void store(uint64_t key, const CachedFunction& entry);
+
+    // All entries of an in-memory cache as one image, and back
+    std::vector<uint8_t> pack() const;
+    bool unpack(const uint8_t* data, size_t size);
+
+private:
+    std::string dir;  // empty for an in-memory cache
+    std::map<uint64_t, std::vector<uint8_t>> memory;
+
+    std::string path(uint64_t key) const;
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstddef>
+#include <string>
+
+// The text of a STRING token: a span of the source, or for a string with
+// escapes, of the lexer's own copy. Valid until the next yysetinput. Plain
+// data, since it lives in the parser's value union. (An IDENTIFIER comes
+// as a Symbol.)
+struct TokenText {
+    const char* text;
+    size_t length;
+
+    std::string str() const { return std::string(text, length); }
+};
+
+// Make yylex scan the given source in place; it must stay valid until
+// parsing is done
+void yysetinput(const char* data, size_t size);
+
+#endif // LEXER_H
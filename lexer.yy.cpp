@@ -1,163 +1,154 @@
 // Hand-written lexer (replacement for flex-generated lexer.yy.cpp)
 // Compatible with bison-generated parser.tab.hpp
-#include <cstdio>
+//
+// Scans the whole source in place (see yysetinput): no per-character
+// reads, and strings come out as spans of the source rather than copies,
+// of any length. Identifiers are interned as they are scanned.
+#include <climits>
 #include <cstring>
-#include <cstdlib>
-#include <cctype>
+#include <deque>
 #include <string>
 #include "ast.h"
+#include "lexer.h"
 #include "parser.tab.hpp"
 
-FILE* yyin = nullptr;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 int yylineno = 1;
-static char yytext_buffer[4096];
-char* yytext = yytext_buffer;
 
 extern YYSTYPE yylval;
 
-static int current_char = -2; // -2 = uninitialized
+static const char* pos = "";
+static const char* end = pos;
 
-static int next_char() {
-    if (!yyin) return EOF;
-    return fgetc(yyin);
-}
+// Strings with escapes, unescaped; a deque so they never move
+static std::deque<std::string> unescaped;
 
-static int peek_char() {
-    if (current_char == -2) {
-        current_char = next_char();
-    }
-    return current_char;
+void yysetinput(const char* data, size_t size) {
+    pos = data;
+    end = data + size;
+    yylineno = 1;
+    unescaped.clear();
 }
 
-static void consume_char() {
-    current_char = -2;
-}
+static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+static bool isIdentStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+static bool isIdentChar(char c) { return isIdentStart(c) || isDigit(c); }
 
 static void skip_whitespace() {
-    while (true) {
-        int c = peek_char();
-        if (c == ' ' || c == '\t' || c == '\r') {
-            consume_char();
-        } else if (c == '\n') {
-            consume_char();
+#ifdef __SSE2__
+    // Indentation comes in long runs: 16 bytes at a time, counting the
+    // newlines among them
+    while (end - pos >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)pos);
+        __m128i newline = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+        __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                                  _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+                                     _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), newline));
+        unsigned blanks = _mm_movemask_epi8(blank);
+        unsigned newlines = _mm_movemask_epi8(newline);
+        if (blanks != 0xFFFF) {
+            int run = __builtin_ctz(~blanks);
+            yylineno += __builtin_popcount(newlines & ((1u << run) - 1));
+            pos += run;
+            return;
+        }
+        yylineno += __builtin_popcount(newlines);
+        pos += 16;
+    }
+#endif
+    while (pos < end) {
+        char c = *pos;
+        if (c == '\n') {
             yylineno++;
-        } else {
+        } else if (c != ' ' && c != '\t' && c != '\r') {
             break;
         }
+        pos++;
     }
 }
 
 static void skip_line_comment() {
-    // Already consumed first '-', check for second
-    int c = peek_char();
-    if (c == '-') {
-        consume_char();
-        // Skip to end of line
-        while ((c = peek_char()) != EOF && c != '\n') {
-            consume_char();
-        }
-    }
+    // Both '-' already consumed; the newline is left for skip_whitespace
+    const char* newline = (const char*)memchr(pos, '\n', end - pos);
+    pos = newline ? newline : end;
 }
 
 static int scan_number() {
-    int pos = 0;
-
-    while (true) {
-        int c = peek_char();
-        if (isdigit(c)) {
-            if (pos < 4094) yytext[pos++] = c;
-            consume_char();
-        } else {
-            break;
-        }
+    // Saturating, as atoll does
+    long long value = 0;
+    while (pos < end && isDigit(*pos)) {
+        int digit = *pos++ - '0';
+        value = value > (LLONG_MAX - digit) / 10 ? LLONG_MAX : value * 10 + digit;
     }
-    yytext[pos] = '\0';
-    yylval.ival = atoll(yytext);
+    yylval.ival = value;
     return INTEGER;
 }
 
+struct Keyword {
+    const char* text;
+    size_t length;
+    int token;
+};
+
+static const Keyword keywords[] = {
+    {"function", 8, FUNCTION}, {"end", 3, END},       {"if", 2, IF},         {"then", 4, THEN},
+    {"else", 4, ELSE},         {"elseif", 6, ELSEIF}, {"while", 5, WHILE},   {"do", 2, DO},
+    {"return", 6, RETURN},     {"local", 5, LOCAL},   {"and", 3, AND},       {"or", 2, OR},
+    {"not", 3, NOT},           {"type", 4, TYPE},     {"print", 5, PRINT},   {"true", 4, BOOLEAN},
+    {"false", 5, BOOLEAN},
+};
+
 static int scan_identifier_or_keyword() {
-    int pos = 0;
+    const char* start = pos;
+    while (pos < end && isIdentChar(*pos)) pos++;
+    size_t length = pos - start;
 
-    while (true) {
-        int c = peek_char();
-        if (isalnum(c) || c == '_') {
-            if (pos < 4094) yytext[pos++] = c;
-            consume_char();
-        } else {
-            break;
+    for (const Keyword& keyword : keywords) {
+        if (keyword.length == length && memcmp(keyword.text, start, length) == 0) {
+            if (keyword.token == BOOLEAN) yylval.bval = start[0] == 't';
+            return keyword.token;
         }
     }
-    yytext[pos] = '\0';
-
-    // Check for keywords
-    if (strcmp(yytext, "function") == 0) return FUNCTION;
-    if (strcmp(yytext, "end") == 0) return END;
-    if (strcmp(yytext, "if") == 0) return IF;
-    if (strcmp(yytext, "then") == 0) return THEN;
-    if (strcmp(yytext, "else") == 0) return ELSE;
-    if (strcmp(yytext, "elseif") == 0) return ELSEIF;
-    if (strcmp(yytext, "while") == 0) return WHILE;
-    if (strcmp(yytext, "do") == 0) return DO;
-    if (strcmp(yytext, "return") == 0) return RETURN;
-    if (strcmp(yytext, "local") == 0) return LOCAL;
-    if (strcmp(yytext, "and") == 0) return AND;
-    if (strcmp(yytext, "or") == 0) return OR;
-    if (strcmp(yytext, "not") == 0) return NOT;
-    if (strcmp(yytext, "type") == 0) return TYPE;
-    if (strcmp(yytext, "print") == 0) return PRINT;
-    if (strcmp(yytext, "true") == 0) {
-        yylval.bval = true;
-        return BOOLEAN;
-    }
-    if (strcmp(yytext, "false") == 0) {
-        yylval.bval = false;
-        return BOOLEAN;
-    }
 
     // It's an identifier
-    yylval.sval = strdup(yytext);
+    yylval.sym = Symbol::intern(start, length);
     return IDENTIFIER;
 }
 
 static int scan_string() {
-    int pos = 0;
-
-    consume_char(); // consume opening quote
-
-    while (true) {
-        int c = peek_char();
-        if (c == EOF || c == '\n') {
-            // Unterminated string
-            yytext[pos] = '\0';
-            yylval.sval = strdup(yytext);
-            return STRING;
-        }
-        consume_char();
+    pos++;  // opening quote
+
+    // Most strings have no escapes and are used as they are
+    const char* start = pos;
+    while (pos < end && *pos != '"' && *pos != '\\' && *pos != '\n') pos++;
+    if (pos == end || *pos != '\\') {
+        // Closed, or unterminated at the end of the line or the input
+        yylval.sval = {start, (size_t)(pos - start)};
+        if (pos < end && *pos == '"') pos++;
+        return STRING;
+    }
 
-        if (c == '"') {
-            // End of string
-            break;
-        }
-        if (c == '\\') {
+    std::string text(start, pos);
+    while (pos < end && *pos != '\n') {
+        char c = *pos++;
+        if (c == '"') break;
+        if (c == '\\' && pos < end) {
             // Escape sequence
-            int escaped = peek_char();
-            if (escaped != EOF) {
-                consume_char();
-                switch (escaped) {
-                    case 'n': c = '\n'; break;
-                    case 't': c = '\t'; break;
-                    case 'r': c = '\r'; break;
-                    case '\\': c = '\\'; break;
-                    case '"': c = '"'; break;
-                    default: c = escaped; break;
-                }
+            char escaped = *pos++;
+            switch (escaped) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                default: c = escaped; break;
             }
         }
-        if (pos < 4094) yytext[pos++] = c;
+        text += c;
     }
-    yytext[pos] = '\0';
-    yylval.sval = strdup(yytext);
+    unescaped.push_back(std::move(text));
+    yylval.sval = {unescaped.back().data(), unescaped.back().size()};
     return STRING;
 }
 
@@ -165,99 +156,57 @@ int yylex() {
     while (true) {
         skip_whitespace();
 
-        int c = peek_char();
-
-        if (c == EOF) {
+        if (pos == end) {
             return 0; // End of input
         }
+        char c = *pos;
 
         // Single character tokens
         if (c == '+' || c == '*' || c == '/' || c == '%' ||
             c == '(' || c == ')' || c == ',' || c == ':') {
-            consume_char();
-            yytext[0] = c;
-            yytext[1] = '\0';
+            pos++;
             return c;
         }
 
         // Minus or comment
         if (c == '-') {
-            consume_char();
-            if (peek_char() == '-') {
+            pos++;
+            if (pos < end && *pos == '-') {
+                pos++;
                 skip_line_comment();
                 continue;
             }
-            yytext[0] = '-';
-            yytext[1] = '\0';
             return '-';
         }
 
-        // Equals or comparison
-        if (c == '=') {
-            consume_char();
-            if (peek_char() == '=') {
-                consume_char();
-                yytext[0] = '=';
-                yytext[1] = '=';
-                yytext[2] = '\0';
-                return EQ;
-            }
-            yytext[0] = '=';
-            yytext[1] = '\0';
-            return '=';
-        }
-
-        // Not equals
-        if (c == '~') {
-            consume_char();
-            if (peek_char() == '=') {
-                consume_char();
-                yytext[0] = '~';
-                yytext[1] = '=';
-                yytext[2] = '\0';
-                return NE;
-            }
-            // Unknown token, skip
-            continue;
-        }
-
-        // Less than or less equal
-        if (c == '<') {
-            consume_char();
-            if (peek_char() == '=') {
-                consume_char();
-                yytext[0] = '<';
-                yytext[1] = '=';
-                yytext[2] = '\0';
-                return LE;
+        // Two-character operators, or the first character alone
+        char next = pos + 1 < end ? pos[1] : '\0';
+        if (c == '=' || c == '~' || c == '<' || c == '>') {
+            pos++;
+            if (next == '=') {
+                pos++;
+                switch (c) {
+                    case '=': return EQ;
+                    case '~': return NE;
+                    case '<': return LE;
+                    default: return GE;
+                }
             }
-            yytext[0] = '<';
-            yytext[1] = '\0';
-            return LT;
-        }
-
-        // Greater than or greater equal
-        if (c == '>') {
-            consume_char();
-            if (peek_char() == '=') {
-                consume_char();
-                yytext[0] = '>';
-                yytext[1] = '=';
-                yytext[2] = '\0';
-                return GE;
+            switch (c) {
+                case '=': return '=';
+                case '<': return LT;
+                case '>': return GT;
+                default: continue;  // Unknown token, skip
             }
-            yytext[0] = '>';
-            yytext[1] = '\0';
-            return GT;
         }
 
         // Numbers
-        if (isdigit(c)) {
+        if (isDigit(c)) {
             return scan_number();
         }
 
         // Identifiers and keywords
-        if (isalpha(c) || c == '_') {
+        if (isIdentStart(c)) {
             return scan_identifier_or_keyword();
         }
 
@@ -267,7 +216,7 @@ int yylex() {
         }
 
         // Unknown character, skip
-        consume_char();
+        pos++;
     }
 }
 
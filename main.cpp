@@ -1,18 +1,41 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <cstring>
 #include "ast.h"
 #include "interpreter.h"
 #include "native_jit.h"
+#include "resolver.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "aot.h"
+#include "lexer.h"
+#include "source.h"
 
-extern FILE* yyin;
 extern int yyparse();
 extern BlockNode* programRoot;
 
 void printUsage(const char* progName) {
-    std::cerr << "Usage: " << progName << " [--jit] <filename.lua>" << std::endl;
+    std::cerr << "Usage: " << progName << " [--jit | --interp] <filename.lua>" << std::endl;
+    std::cerr << "       " << progName << " --aot <filename.lua> -o <output.o>" << std::endl;
     std::cerr << "  --jit: Enable native JIT compilation" << std::endl;
+    std::cerr << "  --interp: Run on the AST interpreter instead of the bytecode VM" << std::endl;
+    std::cerr << "  --jit-call-threshold=N: Compile a function after N calls (default 100)" << std::endl;
+    std::cerr << "  --jit-loop-threshold=N: Compile a function after N loop iterations (default 1000)" << std::endl;
+    std::cerr << "  --jit-cache=DIR: Keep compiled functions in DIR and reuse them in later runs" << std::endl;
+    std::cerr << "  --aot: Compile ahead of time into an object to link with libluau_rt.a" << std::endl;
+}
+
+// Parses the N of "--flag=N"; returns false if arg is not that flag
+static bool parseThreshold(const char* arg, const char* flag, uint32_t& value) {
+    size_t len = strlen(flag);
+    if (strncmp(arg, flag, len) != 0 || arg[len] != '=') return false;
+    char* end;
+    unsigned long n = strtoul(arg + len + 1, &end, 10);
+    if (*end || end == arg + len + 1 || n == 0 || n > UINT32_MAX) {
+        std::cerr << "Error: Invalid value in " << arg << std::endl;
+        exit(1);
+    }
+    value = n;
+    return true;
 }
 
 int main(int argc, char** argv) {
@@ -22,53 +45,77 @@ int main(int argc, char** argv) {
     }
 
     bool useJIT = false;
+    bool useInterpreter = false;
+    Interpreter interp;
     const char* filename = nullptr;
+    const char* cacheDir = nullptr;
+    bool aot = false;
+    const char* outputFile = nullptr;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--jit") == 0) {
             useJIT = true;
+        } else if (strcmp(argv[i], "--aot") == 0) {
+            aot = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (strcmp(argv[i], "--interp") == 0) {
+            useInterpreter = true;
+        } else if (parseThreshold(argv[i], "--jit-call-threshold", interp.callThreshold) ||
+                   parseThreshold(argv[i], "--jit-loop-threshold", interp.loopThreshold)) {
+            // Thresholds only matter together with --jit
+        } else if (strncmp(argv[i], "--jit-cache=", 12) == 0 && argv[i][12]) {
+            cacheDir = argv[i] + 12;
         } else if (argv[i][0] != '-') {
             filename = argv[i];
         }
     }
 
-    if (!filename) {
+    if (!filename || (aot && !outputFile)) {
         printUsage(argv[0]);
         return 1;
     }
 
-    yyin = fopen(filename, "r");
-    if (!yyin) {
+    SourceFile source;
+    if (!source.open(filename)) {
         std::cerr << "Error: Cannot open file " << filename << std::endl;
         return 1;
     }
 
+    Arena arena;
+    parseArena = &arena;
+    yysetinput(source.data(), source.size());
     if (yyparse() != 0) {
         std::cerr << "Error: Failed to parse " << filename << std::endl;
-        fclose(yyin);
         return 1;
     }
 
-    fclose(yyin);
-
     if (!programRoot) {
         std::cerr << "Error: No program to execute" << std::endl;
         return 1;
     }
 
     try {
-        Interpreter interp;
-        if (useJIT) {
+        resolveSlots(programRoot, interp.globals);
+        if (aot) {
+            // The object carries the source, parsed again when it runs
+            writeAotObject(outputFile, std::string(source.data(), source.size()), programRoot);
+        } else if (useJIT) {
             NativeJIT jit(&interp);
+            if (cacheDir) jit.useDiskCache(cacheDir);
             jit.execute(programRoot);
-        } else {
+        } else if (useInterpreter) {
             interp.execute(programRoot);
+        } else {
+            BytecodeCompiler compiler;
+            std::unique_ptr<Module> module = compiler.compile(programRoot);
+            VM vm(*module);
+            vm.run();
         }
     } catch (const std::exception& e) {
         std::cerr << "Runtime error: " << e.what() << std::endl;
         return 1;
     }
 
-    delete programRoot;
     return 0;
 }
@@ -1,116 +1,147 @@
 #include "native_jit.h"
-#include <sys/mman.h>
-#include <unistd.h>
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
 
+// Inlining budgets, in AST nodes: per callee (more for one hot enough to
+// have been compiled on its own), and in total per compiled function
+static const size_t INLINE_SIZE = 24;
+static const size_t HOT_INLINE_SIZE = 64;
+static const size_t MAX_INLINED_SIZE = 400;
+
+// Budget of a compiled main chunk, in IR instructions: the statements
+// after a hot top-level loop that would go past it are left to the
+// interpreter
+static const size_t MAX_CHUNK_SIZE = 2000;
+
+// Part of the key of every function in the on-disk cache; bump it when
+// the code generated for the same input changes
+static const int JIT_CACHE_VERSION = 4;
+
+static std::vector<uint8_t> typeBytes(const std::vector<IRType>& types) {
+    std::vector<uint8_t> bytes;
+    for (IRType type : types) bytes.push_back((uint8_t)type);
+    return bytes;
+}
+
 // Static member for runtime callbacks
 NativeJIT* NativeJIT::currentJIT = nullptr;
 
 NativeJIT::NativeJIT(Interpreter* interp)
-    : interpreter(interp), localVarCount(0) {
+    : interpreter(interp), builder(nullptr) {
     codegen.reset(createCodeGenerator());
     currentJIT = this;
+    interpreter->jit = this;
 }
 
 NativeJIT::~NativeJIT() {
-    // Free all allocated executable memory
-    for (auto& page : allocatedPages) {
-        munmap(page.first, page.second);
-    }
     if (currentJIT == this) {
         currentJIT = nullptr;
     }
+    if (interpreter->jit == this) {
+        interpreter->jit = nullptr;
+    }
 }
 
-void* NativeJIT::allocateExecutableMemory(size_t size) {
-    // Round up to page size
-    size_t pageSize = sysconf(_SC_PAGESIZE);
-    size_t allocSize = (size + pageSize - 1) & ~(pageSize - 1);
-
-    void* ptr = mmap(nullptr, allocSize,
-                     PROT_READ | PROT_WRITE | PROT_EXEC,
-                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+void NativeJIT::retire(void* code) {
+    if (code) retiredCode.push_back(code);
+}
 
-    if (ptr == MAP_FAILED) {
-        throw std::runtime_error("Failed to allocate executable memory");
+void NativeJIT::reclaim() {
+    if (nativeDepth > 0 || retiredCode.empty()) return;
+
+    // Call sites inside freed code are forgotten, so that nothing patches
+    // them when their callee changes
+    for (void* code : retiredCode) {
+        uint8_t* begin = (uint8_t*)code;
+        uint8_t* end = begin + codeCache.blockSize(code);
+        for (auto& entry : callTargets) {
+            auto& sites = entry.second.sites;
+            sites.erase(std::remove_if(sites.begin(), sites.end(),
+                                       [&](const LinkedCallSite& site) {
+                                           return site.call >= begin && site.call < end;
+                                       }),
+                        sites.end());
+        }
+        deoptBases.erase((const uint8_t*)code);
+        codeCache.release(code);
     }
-
-    allocatedPages.push_back({ptr, allocSize});
-    return ptr;
+    retiredCode.clear();
 }
 
-void NativeJIT::collectLocals(ASTNode* node, std::set<std::string>& locals) {
+// The frame slots of the locals a function body uses, and the names of
+// its globals
+static void collectVariables(ASTNode* node, std::set<int>& locals, std::set<Symbol>& globals) {
     if (!node) return;
 
     switch (node->type) {
         case ASTNodeType::ASSIGNMENT: {
             AssignmentNode* assign = static_cast<AssignmentNode*>(node);
-            if (functionParams.find(assign->variable) == functionParams.end()) {
-                locals.insert(assign->variable);
+            if (assign->slot >= 0) {
+                locals.insert(assign->slot);
+            } else {
+                globals.insert(assign->variable);
             }
-            collectLocals(assign->value.get(), locals);
+            collectVariables(assign->value.get(), locals, globals);
             break;
         }
         case ASTNodeType::VARIABLE: {
             VariableNode* var = static_cast<VariableNode*>(node);
-            if (functionParams.find(var->name) == functionParams.end()) {
-                locals.insert(var->name);
+            if (var->slot >= 0) {
+                locals.insert(var->slot);
+            } else {
+                globals.insert(var->name);
             }
             break;
         }
         case ASTNodeType::BINARY_OP: {
             BinaryOpNode* binOp = static_cast<BinaryOpNode*>(node);
-            collectLocals(binOp->left.get(), locals);
-            collectLocals(binOp->right.get(), locals);
+            collectVariables(binOp->left.get(), locals, globals);
+            collectVariables(binOp->right.get(), locals, globals);
             break;
         }
         case ASTNodeType::UNARY_OP: {
             UnaryOpNode* unOp = static_cast<UnaryOpNode*>(node);
-            collectLocals(unOp->operand.get(), locals);
+            collectVariables(unOp->operand.get(), locals, globals);
             break;
         }
         case ASTNodeType::IF_STMT: {
             IfNode* ifNode = static_cast<IfNode*>(node);
-            collectLocals(ifNode->condition.get(), locals);
-            collectLocals(ifNode->thenBlock.get(), locals);
-            if (ifNode->elseBlock) {
-                collectLocals(ifNode->elseBlock.get(), locals);
-            }
+            collectVariables(ifNode->condition.get(), locals, globals);
+            collectVariables(ifNode->thenBlock.get(), locals, globals);
+            collectVariables(ifNode->elseBlock.get(), locals, globals);
             break;
         }
         case ASTNodeType::WHILE_STMT: {
             WhileNode* whileNode = static_cast<WhileNode*>(node);
-            collectLocals(whileNode->condition.get(), locals);
-            collectLocals(whileNode->body.get(), locals);
+            collectVariables(whileNode->condition.get(), locals, globals);
+            collectVariables(whileNode->body.get(), locals, globals);
             break;
         }
         case ASTNodeType::BLOCK: {
             BlockNode* block = static_cast<BlockNode*>(node);
             for (auto& stmt : block->statements) {
-                collectLocals(stmt.get(), locals);
+                collectVariables(stmt.get(), locals, globals);
             }
             break;
         }
         case ASTNodeType::RETURN: {
             ReturnNode* retNode = static_cast<ReturnNode*>(node);
-            if (retNode->value) {
-                collectLocals(retNode->value.get(), locals);
-            }
+            collectVariables(retNode->value.get(), locals, globals);
             break;
         }
         case ASTNodeType::FUNCTION_CALL: {
             FunctionCallNode* call = static_cast<FunctionCallNode*>(node);
             for (auto& arg : call->args) {
-                collectLocals(arg.get(), locals);
+                collectVariables(arg.get(), locals, globals);
             }
             break;
         }
         case ASTNodeType::PRINT: {
             PrintNode* print = static_cast<PrintNode*>(node);
             for (auto& arg : print->args) {
-                collectLocals(arg.get(), locals);
+                collectVariables(arg.get(), locals, globals);
             }
             break;
         }
@@ -119,167 +150,808 @@ void NativeJIT::collectLocals(ASTNode* node, std::set<std::string>& locals) {
     }
 }
 
-void NativeJIT::compileExpression(ASTNode* node) {
-    if (!node) {
-        codegen->emitLoadImmediate(0);
-        return;
-    }
+// Type names for error messages, and the letters in call target keys
+static const char* typeNames[] = {"int", "bool", "string", "nil"};
+
+static_assert((int)IRType::INT == (int)ValueType::INTEGER && (int)IRType::BOOL == (int)ValueType::BOOLEAN &&
+              (int)IRType::STRING == (int)ValueType::STRING && (int)IRType::NIL == (int)ValueType::NONE,
+              "IRType doubles as the ValueType tag in compiled code");
+
+// Call targets are keyed by callee and argument types, e.g. "f(is)"
+static std::string targetKey(Symbol name, const std::vector<IRType>& types) {
+    std::string key = name.str() + "(";
+    for (IRType type : types) key += "ibsn"[(int)type];
+    return key + ")";
+}
+
+// Whether compiled code specialized for 'type' can take 'value'. Nil reads
+// as 0, which suits every type but a string.
+static bool fits(const Value& value, IRType type) {
+    return value.type == (ValueType)type || (value.isNone() && type != IRType::STRING);
+}
+
+// Statements that assign to variables, in the order they appear
+static void collectAssignments(ASTNode* node, std::vector<AssignmentNode*>& assignments) {
+    if (!node) return;
 
     switch (node->type) {
-        case ASTNodeType::INTEGER: {
-            IntegerNode* intNode = static_cast<IntegerNode*>(node);
-            codegen->emitLoadImmediate(intNode->value);
+        case ASTNodeType::ASSIGNMENT:
+            assignments.push_back(static_cast<AssignmentNode*>(node));
+            break;
+        case ASTNodeType::IF_STMT: {
+            IfNode* ifNode = static_cast<IfNode*>(node);
+            collectAssignments(ifNode->thenBlock.get(), assignments);
+            collectAssignments(ifNode->elseBlock.get(), assignments);
             break;
         }
-
-        case ASTNodeType::BOOLEAN: {
-            BooleanNode* boolNode = static_cast<BooleanNode*>(node);
-            codegen->emitLoadBool(boolNode->value);
+        case ASTNodeType::WHILE_STMT:
+            collectAssignments(static_cast<WhileNode*>(node)->body.get(), assignments);
+            break;
+        case ASTNodeType::BLOCK:
+            for (auto& stmt : static_cast<BlockNode*>(node)->statements) {
+                collectAssignments(stmt.get(), assignments);
+            }
+            break;
+        default:
             break;
+    }
+}
+
+// Size of a function body in AST nodes, if it can be inlined: it calls
+// nothing, defines nothing and keeps to its own locals
+static bool inlineSize(ASTNode* node, size_t& size) {
+    if (!node) return true;
+    size++;
+
+    switch (node->type) {
+        case ASTNodeType::FUNCTION_CALL:
+        case ASTNodeType::FUNCTION_DEF:
+            return false;
+        case ASTNodeType::VARIABLE:
+            return static_cast<VariableNode*>(node)->slot >= 0;
+        case ASTNodeType::ASSIGNMENT: {
+            AssignmentNode* assign = static_cast<AssignmentNode*>(node);
+            return assign->slot >= 0 && inlineSize(assign->value.get(), size);
         }
+        case ASTNodeType::BINARY_OP: {
+            BinaryOpNode* binOp = static_cast<BinaryOpNode*>(node);
+            return inlineSize(binOp->left.get(), size) && inlineSize(binOp->right.get(), size);
+        }
+        case ASTNodeType::UNARY_OP:
+            return inlineSize(static_cast<UnaryOpNode*>(node)->operand.get(), size);
+        case ASTNodeType::IF_STMT: {
+            IfNode* ifNode = static_cast<IfNode*>(node);
+            return inlineSize(ifNode->condition.get(), size) && inlineSize(ifNode->thenBlock.get(), size) &&
+                   inlineSize(ifNode->elseBlock.get(), size);
+        }
+        case ASTNodeType::WHILE_STMT: {
+            WhileNode* whileNode = static_cast<WhileNode*>(node);
+            return inlineSize(whileNode->condition.get(), size) && inlineSize(whileNode->body.get(), size);
+        }
+        case ASTNodeType::BLOCK:
+            for (auto& stmt : static_cast<BlockNode*>(node)->statements) {
+                if (!inlineSize(stmt.get(), size)) return false;
+            }
+            return true;
+        case ASTNodeType::RETURN:
+            return inlineSize(static_cast<ReturnNode*>(node)->value.get(), size);
+        case ASTNodeType::PRINT:
+            for (auto& arg : static_cast<PrintNode*>(node)->args) {
+                if (!inlineSize(arg.get(), size)) return false;
+            }
+            return true;
+        default:
+            return true;
+    }
+}
 
-        case ASTNodeType::VARIABLE: {
-            VariableNode* varNode = static_cast<VariableNode*>(node);
-            auto it = localVarMap.find(varNode->name);
-            if (it != localVarMap.end()) {
-                codegen->emitLoadLocal(it->second);
-            } else {
-                throw std::runtime_error("Undefined variable in JIT: " + varNode->name);
+// Return statements of a function body
+static void collectReturns(ASTNode* node, std::vector<ReturnNode*>& returns) {
+    if (!node) return;
+
+    switch (node->type) {
+        case ASTNodeType::RETURN:
+            returns.push_back(static_cast<ReturnNode*>(node));
+            break;
+        case ASTNodeType::IF_STMT: {
+            IfNode* ifNode = static_cast<IfNode*>(node);
+            collectReturns(ifNode->thenBlock.get(), returns);
+            collectReturns(ifNode->elseBlock.get(), returns);
+            break;
+        }
+        case ASTNodeType::WHILE_STMT:
+            collectReturns(static_cast<WhileNode*>(node)->body.get(), returns);
+            break;
+        case ASTNodeType::BLOCK:
+            for (auto& stmt : static_cast<BlockNode*>(node)->statements) {
+                collectReturns(stmt.get(), returns);
             }
             break;
+        default:
+            break;
+    }
+}
+
+// Whether a statement is, or has inside it, the given loop
+static bool containsLoop(ASTNode* node, const WhileNode* loop) {
+    if (!node) return false;
+
+    switch (node->type) {
+        case ASTNodeType::IF_STMT: {
+            IfNode* ifNode = static_cast<IfNode*>(node);
+            return containsLoop(ifNode->thenBlock.get(), loop) || containsLoop(ifNode->elseBlock.get(), loop);
         }
+        case ASTNodeType::WHILE_STMT:
+            return node == loop || containsLoop(static_cast<WhileNode*>(node)->body.get(), loop);
+        case ASTNodeType::BLOCK:
+            for (auto& stmt : static_cast<BlockNode*>(node)->statements) {
+                if (containsLoop(stmt.get(), loop)) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
 
+IRType NativeJIT::parameterType(uint8_t mask, const std::string& what) {
+    // Nothing observed yet: speculate on an integer, guarded like the rest
+    if (mask == 0) return IRType::INT;
+    for (int type = 0; type <= (int)IRType::NIL; type++) {
+        if (mask == 1 << type) return (IRType)type;
+    }
+    throw std::runtime_error("Polymorphic " + what);
+}
+
+IRType NativeJIT::returnType(Symbol callee) {
+    FunctionDefNode* def = interpreter->definition(callee);
+    const Interpreter::FunctionProfile* profile = def ? interpreter->profile(def) : nullptr;
+    IRType type = parameterType(profile ? profile->returnTypes : 0, "result of " + callee.str());
+    assumedResults[callee] = type;
+    return type;
+}
+
+int NativeJIT::inferType(ASTNode* node) {
+    if (!node) return (int)IRType::NIL;
+
+    switch (node->type) {
+        case ASTNodeType::INTEGER: return (int)IRType::INT;
+        case ASTNodeType::BOOLEAN: return (int)IRType::BOOL;
+        case ASTNodeType::STRING: return (int)IRType::STRING;
+        case ASTNodeType::VARIABLE: {
+            VariableNode* var = static_cast<VariableNode*>(node);
+            if (var->slot < 0) {
+                auto it = globalTypes.find(var->name);
+                return it == globalTypes.end() ? -1 : (int)it->second;
+            }
+            auto it = localTypes.find(var->slot);
+            return it == localTypes.end() ? -1 : (int)it->second;
+        }
         case ASTNodeType::BINARY_OP: {
             BinaryOpNode* binOp = static_cast<BinaryOpNode*>(node);
+            if (binOp->op == BinaryOpType::ADD) {
+                // '+' concatenates as soon as either side is a string
+                int left = inferType(binOp->left.get());
+                int right = inferType(binOp->right.get());
+                if (left == (int)IRType::STRING || right == (int)IRType::STRING) return (int)IRType::STRING;
+                return left < 0 || right < 0 ? -1 : (int)IRType::INT;
+            }
+            return binOp->op <= BinaryOpType::MOD ? (int)IRType::INT : (int)IRType::BOOL;
+        }
+        case ASTNodeType::UNARY_OP:
+            return static_cast<UnaryOpNode*>(node)->op == UnaryOpType::NOT ? (int)IRType::BOOL
+                                                                           : (int)IRType::INT;
+        case ASTNodeType::FUNCTION_CALL:
+            return (int)returnType(static_cast<FunctionCallNode*>(node)->name);
+        default:
+            return -1;
+    }
+}
+
+void NativeJIT::inferTypes(ASTNode* body) {
+    std::vector<AssignmentNode*> assignments;
+    collectAssignments(body, assignments);
+
+    // Propagate until nothing changes; a variable that would need two
+    // types can't be specialized
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (AssignmentNode* assign : assignments) {
+            if (assign->slot < 0) continue;
+            int type = inferType(assign->value.get());
+            if (type < 0) continue;
+            auto it = localTypes.find(assign->slot);
+            if (it == localTypes.end()) {
+                localTypes[assign->slot] = (IRType)type;
+                changed = true;
+            } else if ((int)it->second != type) {
+                throw std::runtime_error("Variable " + assign->variable.str() + " is both " +
+                                         typeNames[(int)it->second] + " and " + typeNames[type]);
+            }
+        }
+    }
+}
+
+void NativeJIT::speculateGlobals(ASTNode* body) {
+    std::set<int> locals;
+    std::set<Symbol> names;
+    collectVariables(body, locals, names);
+    GlobalTable& globals = interpreter->globals;
+    for (const auto& name : names) {
+        int index = globals.find(name);
+        if (index < 0) continue;
+        long long type = globals[index].type;
+        if (type != GlobalTable::UNDEFINED && type != (long long)ValueType::NONE) globalTypes[name] = (IRType)type;
+    }
+
+    // Unlike a local, a global may change its type: the first one assigned
+    // is as good a guess as any
+    std::vector<AssignmentNode*> assignments;
+    collectAssignments(body, assignments);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (AssignmentNode* assign : assignments) {
+            if (assign->slot >= 0 || globalTypes.count(assign->variable)) continue;
+            int type = inferType(assign->value.get());
+            if (type >= 0) {
+                globalTypes[assign->variable] = (IRType)type;
+                changed = true;
+            }
+        }
+    }
+}
+
+void NativeJIT::declareLocals(IRFunction& ir, ASTNode* body) {
+    std::set<int> locals;
+    std::set<Symbol> globals;
+    collectVariables(body, locals, globals);
+
+    // Locals that aren't parameters start out as 0 (an empty string)
+    for (int local : locals) {
+        if (localVarMap.find(local) != localVarMap.end()) continue;
+        IRType type = localTypes.count(local) ? localTypes[local] : IRType::INT;
+        localTypes[local] = type;
+        int vreg = ir.newVReg(type);
+        localVarMap[local] = vreg;
+        builder->emitMove(vreg, emitInitialValue(type));
+    }
+}
+
+int NativeJIT::emitInitialValue(IRType type) {
+    return builder->emitConst(type == IRType::STRING ? Value::interned("").bits() : 0, type);
+}
+
+int NativeJIT::truthy(int vreg) {
+    switch (builder->function().types[vreg]) {
+        case IRType::BOOL: return vreg;
+        case IRType::INT: return builder->emitBinary(IROp::CMP_NE, vreg, builder->emitConst(0));
+        default: return builder->emitConst(1, IRType::BOOL);  // strings and nil
+    }
+}
 
-            // Compile left operand
-            compileExpression(binOp->left.get());
-            codegen->emitPush();
+int NativeJIT::compileExpression(ASTNode* node) {
+    if (!node) {
+        return builder->emitConst(0, IRType::NIL);
+    }
+
+    switch (node->type) {
+        case ASTNodeType::INTEGER: {
+            IntegerNode* intNode = static_cast<IntegerNode*>(node);
+            return builder->emitConst(intNode->value);
+        }
 
-            // Compile right operand
-            compileExpression(binOp->right.get());
+        case ASTNodeType::BOOLEAN: {
+            BooleanNode* boolNode = static_cast<BooleanNode*>(node);
+            return builder->emitConst(boolNode->value ? 1 : 0, IRType::BOOL);
+        }
 
-            // Pop left into secondary register
-            codegen->emitPop();
+        case ASTNodeType::STRING: {
+            return builder->emitConst(static_cast<StringNode*>(node)->bits, IRType::STRING);
+        }
 
-            // Emit binary operation
-            switch (binOp->op) {
-                case BinaryOpType::ADD: codegen->emitAdd(); break;
-                case BinaryOpType::SUB: codegen->emitSub(); break;
-                case BinaryOpType::MUL: codegen->emitMul(); break;
-                case BinaryOpType::DIV: codegen->emitDiv(); break;
-                case BinaryOpType::MOD: codegen->emitMod(); break;
-                case BinaryOpType::EQ:  codegen->emitCompareEq(); break;
-                case BinaryOpType::NE:  codegen->emitCompareNe(); break;
-                case BinaryOpType::LT:  codegen->emitCompareLt(); break;
-                case BinaryOpType::LE:  codegen->emitCompareLe(); break;
-                case BinaryOpType::GT:  codegen->emitCompareGt(); break;
-                case BinaryOpType::GE:  codegen->emitCompareGe(); break;
-                case BinaryOpType::AND: codegen->emitAnd(); break;
-                case BinaryOpType::OR:  codegen->emitOr(); break;
+        case ASTNodeType::VARIABLE: {
+            VariableNode* varNode = static_cast<VariableNode*>(node);
+            if (varNode->slot < 0) {
+                return compileGlobalLoad(varNode->name, varNode->global);
             }
-            break;
+            auto it = localVarMap.find(varNode->slot);
+            if (it != localVarMap.end()) {
+                return it->second;
+            }
+            throw std::runtime_error("Undefined variable in JIT: " + varNode->name.str());
         }
 
+        case ASTNodeType::BINARY_OP:
+            return compileBinary(static_cast<BinaryOpNode*>(node));
+
         case ASTNodeType::UNARY_OP: {
             UnaryOpNode* unOp = static_cast<UnaryOpNode*>(node);
-            compileExpression(unOp->operand.get());
+            int operand = compileExpression(unOp->operand.get());
+            IRType type = builder->function().types[operand];
             switch (unOp->op) {
-                case UnaryOpType::NOT: codegen->emitNot(); break;
-                case UnaryOpType::NEG: codegen->emitNeg(); break;
+                case UnaryOpType::NOT:
+                    return builder->emitUnary(IROp::NOT, truthy(operand));
+                case UnaryOpType::NEG:
+                    if (type != IRType::INT && type != IRType::NIL) {
+                        throw std::runtime_error(std::string("Cannot negate ") + typeNames[(int)type] + " in JIT");
+                    }
+                    return builder->emitUnary(IROp::NEG, operand);
             }
             break;
         }
 
-        case ASTNodeType::FUNCTION_CALL: {
-            FunctionCallNode* call = static_cast<FunctionCallNode*>(node);
-            int argCount = call->args.size();
+        case ASTNodeType::FUNCTION_CALL:
+            return compileCall(static_cast<FunctionCallNode*>(node), true);
 
-            // Push each argument using jit_push_arg helper
-            for (int i = 0; i < argCount; i++) {
-                compileExpression(call->args[i].get());
-                codegen->emitSetCallArg(0);  // Pass value as first arg
-                codegen->emitCallRuntime((void*)&jit_push_arg, 1);
-            }
+        default:
+            break;
+    }
+    throw std::runtime_error("Unsupported expression type in JIT");
+}
 
-            // Call the function using jit_call_func helper
-            codegen->emitLoadStringPtr(call->name.c_str());
-            codegen->emitSetCallArg(0);
-            codegen->emitCallRuntime((void*)&jit_call_func, 1);
-            // Result is in return register (rax/x0)
+int NativeJIT::compileBinary(BinaryOpNode* node) {
+    int left = compileExpression(node->left.get());
+    int right = compileExpression(node->right.get());
+    IRType leftType = builder->function().types[left];
+    IRType rightType = builder->function().types[right];
+    auto typeError = [&]() {
+        return std::runtime_error(std::string("Unsupported operand types in JIT: ") +
+                                  typeNames[(int)leftType] + " and " + typeNames[(int)rightType]);
+    };
+    auto numeric = [](IRType type) { return type == IRType::INT || type == IRType::NIL; };
+
+    IROp op = IROp::ADD;
+    switch (node->op) {
+        case BinaryOpType::ADD:
+            if (leftType == IRType::STRING || rightType == IRType::STRING) {
+                if (leftType == IRType::BOOL || rightType == IRType::BOOL) throw typeError();
+                return builder->emitCallRuntime((void*)&runtimeConcat,
+                                                {left, builder->emitConst((int)leftType),
+                                                 right, builder->emitConst((int)rightType)},
+                                                IRType::STRING);
+            }
+            op = IROp::ADD;
             break;
+        case BinaryOpType::SUB: op = IROp::SUB; break;
+        case BinaryOpType::MUL: op = IROp::MUL; break;
+        case BinaryOpType::DIV: op = IROp::DIV; break;
+        case BinaryOpType::MOD: op = IROp::MOD; break;
+        case BinaryOpType::LT:  op = IROp::CMP_LT; break;
+        case BinaryOpType::LE:  op = IROp::CMP_LE; break;
+        case BinaryOpType::GT:  op = IROp::CMP_GT; break;
+        case BinaryOpType::GE:  op = IROp::CMP_GE; break;
+
+        case BinaryOpType::EQ:
+        case BinaryOpType::NE: {
+            // Values of different types, and nil, are never equal
+            IROp cmp = node->op == BinaryOpType::EQ ? IROp::CMP_EQ : IROp::CMP_NE;
+            if (leftType == rightType && (leftType == IRType::INT || leftType == IRType::BOOL)) {
+                return builder->emitBinary(cmp, left, right);
+            }
+            if (leftType == IRType::STRING && rightType == IRType::STRING) {
+                int equal = builder->emitCallRuntime((void*)&runtimeStringEquals, {left, right}, IRType::BOOL);
+                return cmp == IROp::CMP_EQ ? equal : builder->emitUnary(IROp::NOT, equal);
+            }
+            return builder->emitConst(cmp == IROp::CMP_NE, IRType::BOOL);
         }
 
-        default:
-            throw std::runtime_error("Unsupported expression type in JIT");
+        case BinaryOpType::AND:
+            return builder->emitBinary(IROp::AND, truthy(left), truthy(right));
+        case BinaryOpType::OR:
+            return builder->emitBinary(IROp::OR, truthy(left), truthy(right));
     }
+
+    if (!numeric(leftType) || !numeric(rightType)) throw typeError();
+    if (op == IROp::DIV || op == IROp::MOD) return compileDivision(op, left, right);
+    return builder->emitBinary(op, left, right);
+}
+
+// The machine instruction traps on a zero divisor, and on LLONG_MIN / -1.
+// Divisors of 0 and -1 go to runtimeDivide instead, which raises the
+// interpreter's error or wraps as it does. It does not deoptimize, as
+// the division may be in an inlined callee.
+int NativeJIT::compileDivision(IROp op, int left, int right) {
+    IRFunction& func = builder->function();
+    // A literal divisor is checked here (constants are fresh vregs, so
+    // its CONST is the only definition)
+    for (const IRInstr& instr : func.blocks[builder->currentBlock()].instrs) {
+        if (instr.op == IROp::CONST && instr.dst == right && instr.imm != 0 && instr.imm != -1) {
+            return builder->emitBinary(op, left, right);
+        }
+    }
+
+    int result = func.newVReg(IRType::INT);
+    int slowBlock = func.newBlock();
+    int fastBlock = func.newBlock();
+    int endBlock = func.newBlock();
+    int slow = builder->emitBinary(IROp::OR, builder->emitBinary(IROp::CMP_EQ, right, builder->emitConst(0)),
+                                   builder->emitBinary(IROp::CMP_EQ, right, builder->emitConst(-1)));
+    builder->emitBranch(slow, slowBlock, fastBlock);
+
+    builder->setBlock(fastBlock);
+    builder->emitMove(result, builder->emitBinary(op, left, right));
+    builder->emitJump(endBlock);
+
+    builder->setBlock(slowBlock);
+    builder->emitMove(result, builder->emitCallRuntime((void*)&runtimeDivide,
+                                                       {left, right, builder->emitConst(op == IROp::MOD)},
+                                                       IRType::INT));
+    builder->emitJump(endBlock);
+
+    builder->setBlock(endBlock);
+    return result;
+}
+
+int NativeJIT::compileCall(FunctionCallNode* node, bool useResult, bool tail) {
+    std::vector<int> args;
+    std::vector<IRType> argTypes;
+    for (auto& arg : node->args) {
+        args.push_back(compileExpression(arg.get()));
+        argTypes.push_back(builder->function().types[args.back()]);
+    }
+
+    // A function returning a call to itself, with the same argument
+    // types, starts over in place with new parameters; its locals are
+    // assigned before they are read again
+    if (tail && tailEntry >= 0 && node->name == currentDef->name && argTypes == tailParamTypes &&
+        interpreter->definition(node->name) == currentDef) {
+        IRFunction& func = builder->function();
+        std::vector<int> temps;
+        for (int arg : args) {
+            temps.push_back(func.newVReg(func.types[arg]));
+            builder->emitMove(temps.back(), arg);
+        }
+        for (size_t i = 0; i < temps.size(); i++) {
+            builder->emitMove(localVarMap[i], temps[i]);
+        }
+        builder->emitJump(tailEntry);
+        return -1;
+    }
+
+    // Small leaf functions are spliced in; their result type is known
+    // statically, so they need no guard either
+    if (FunctionDefNode* callee = inlineCandidate(node->name)) {
+        int result = compileInline(callee, args);
+        if (result >= 0) {
+            IRType type = builder->function().types[result];
+            statementCalls.push_back({result, type});
+            if (tail) builder->emitReturn(result, builder->emitConst((int)type));
+            return result;
+        }
+    }
+
+    std::string key = targetKey(node->name, argTypes);
+    CallTarget& target = callTargets[key];
+    target.name = node->name;
+    target.argTypes = argTypes;
+
+    // A result nobody looks at needs no guard, and neither does one that
+    // is returned as it is, type tag and all. The arguments of a tail call
+    // take the place of this function's own, so there can't be more of
+    // them; a call with more returns normally.
+    if (tail && argsBase >= 0 && args.size() <= currentDef->params.size()) {
+        builder->emitTailCall(key, argsBase, args);
+        return -1;
+    }
+    if (tail) {
+        int result = builder->emitCall(key, args, IRType::INT);
+        builder->emitReturn(result, builder->emitResultType());
+        return -1;
+    }
+    // Whatever the callee runs may assign to globals
+    knownGlobals.clear();
+    if (!useResult) {
+        return builder->emitCall(key, args, IRType::NIL);
+    }
+    IRType expected = returnType(node->name);
+    int result = builder->emitCall(key, args, expected);
+    emitResultGuard(result, expected);
+    return result;
+}
+
+FunctionDefNode* NativeJIT::inlineCandidate(Symbol name) {
+    FunctionDefNode* callee = interpreter->definition(name);
+    if (!callee) return nullptr;
+
+    // Only callees the interpreter has seen run; hot ones (compiled on
+    // their own) get a bigger budget
+    const Interpreter::FunctionProfile* profile = interpreter->profile(callee);
+    if (!profile || (profile->calls == 0 && profile->state != Interpreter::FunctionProfile::NATIVE)) {
+        return nullptr;
+    }
+    size_t budget = profile->state == Interpreter::FunctionProfile::NATIVE ? HOT_INLINE_SIZE : INLINE_SIZE;
+
+    size_t size = 0;
+    if (!inlineSize(callee->body.get(), size) || size > budget || inlinedSize + size > MAX_INLINED_SIZE) {
+        return nullptr;
+    }
+    return callee;
+}
+
+int NativeJIT::compileInline(FunctionDefNode* callee, const std::vector<int>& args) {
+    IRFunction& func = builder->function();
+
+    // The callee gets its own variables, typed for these arguments; the
+    // caller's compiler state comes back afterwards
+    auto savedVars = std::move(localVarMap);
+    auto savedTypes = std::move(localTypes);
+    auto savedPath = statementPath;
+    auto savedCalls = statementCalls;
+    size_t savedPrinted = printedArgs;
+    int savedExit = inlineExit;
+    int savedResult = inlineResult;
+    localVarMap.clear();
+    localTypes.clear();
+
+    // If the body turns out not to compile, the IR emitted for it goes
+    int block = builder->currentBlock();
+    size_t instrCount = func.blocks[block].instrs.size();
+    size_t blockCount = func.blocks.size();
+    int vregCount = func.vregCount;
+
+    int result = -1;
+    try {
+        const auto& params = callee->params;
+        for (size_t i = 0; i < params.size(); i++) {
+            localTypes[i] = i < args.size() ? func.types[args[i]] : IRType::NIL;
+        }
+        inferTypes(callee->body.get());
+
+        // Every way out has to produce the same type; falling off the end
+        // produces nil
+        std::vector<ReturnNode*> returns;
+        collectReturns(callee->body.get(), returns);
+        ASTNode* last = callee->body.get();
+        if (last && last->type == ASTNodeType::BLOCK) {
+            auto& statements = static_cast<BlockNode*>(last)->statements;
+            last = statements.empty() ? nullptr : statements.back().get();
+        }
+        bool fallsOff = !last || last->type != ASTNodeType::RETURN;
+        int type = fallsOff ? (int)IRType::NIL : -1;
+        for (ReturnNode* ret : returns) {
+            int returned = inferType(ret->value.get());
+            if (returned < 0) returned = (int)IRType::INT;
+            if (type >= 0 && returned != type) throw std::runtime_error("Mixed return types");
+            type = returned;
+        }
+
+        // Parameters are copies of the arguments
+        for (size_t i = 0; i < params.size(); i++) {
+            int vreg = func.newVReg(localTypes[i]);
+            localVarMap[i] = vreg;
+            builder->emitMove(vreg, i < args.size() ? args[i] : builder->emitConst(0, IRType::NIL));
+        }
+        declareLocals(func, callee->body.get());
+
+        // 'return' assigns the result and leaves through the exit block
+        inlineExit = func.newBlock();
+        inlineResult = func.newVReg((IRType)type);
+        compileStatement(callee->body.get());
+        if (fallsOff) builder->emitMove(inlineResult, builder->emitConst(0, IRType::NIL));
+        builder->emitJump(inlineExit);
+        builder->setBlock(inlineExit);
+
+        result = inlineResult;
+        inlineSize(callee->body.get(), inlinedSize);
+        inlinedCallees.insert(callee->name);
+    } catch (const std::runtime_error&) {
+        func.blocks.resize(blockCount);
+        func.blocks[block].instrs.resize(instrCount, IRInstr(IROp::CONST));
+        func.vregCount = vregCount;
+        func.types.resize(vregCount);
+        builder->setBlock(block);
+    }
+
+    localVarMap = std::move(savedVars);
+    localTypes = std::move(savedTypes);
+    statementPath = std::move(savedPath);
+    statementCalls = std::move(savedCalls);
+    printedArgs = savedPrinted;
+    inlineExit = savedExit;
+    inlineResult = savedResult;
+    return result;
+}
+
+void NativeJIT::emitResultGuard(int result, IRType expected) {
+    int type = builder->emitResultType();
+    emitGuard(builder->emitBinary(IROp::CMP_EQ, type, builder->emitConst((int)expected)), result, type);
+    statementCalls.push_back({result, expected});
+}
+
+void NativeJIT::emitGuard(int ok, int result, int resultType) {
+    IRFunction& func = builder->function();
+    int deoptBlock = func.newBlock();
+    int continueBlock = func.newBlock();
+    builder->emitBranch(ok, continueBlock, deoptBlock);
+
+    builder->setBlock(deoptBlock);
+    emitDeopt(result, resultType, false);
+
+    builder->setBlock(continueBlock);
+}
+
+void NativeJIT::emitDeopt(int result, int resultType, bool exit) {
+    IRFunction& func = builder->function();
+
+    // Hand the frame over to the interpreter, along with the results of
+    // the calls this statement has made
+    for (const auto& local : localVarMap) {
+        builder->emitCallRuntime((void*)&runtimeDeoptSlot,
+                                 {builder->emitConst(local.first), local.second,
+                                  builder->emitConst((int)func.types[local.second])});
+    }
+    for (const auto& call : statementCalls) {
+        builder->emitCallRuntime((void*)&runtimeDeoptReplay,
+                                 {call.first, builder->emitConst((int)call.second)});
+    }
+    if (result >= 0) {
+        builder->emitCallRuntime((void*)&runtimeDeoptReplay, {result, resultType});
+    }
+
+    int point = deoptPoints.size() - firstDeoptPoint;
+    deoptPoints.push_back({currentDef, osrLoop, statementPath, printedArgs, nullptr, exit});
+    int value = builder->emitCallRuntime((void*)&runtimeDeopt, {builder->emitConst(point)}, IRType::INT);
+    builder->emitReturn(value, builder->emitResultType());
+}
+
+int NativeJIT::compileGlobalLoad(Symbol name, int index) {
+    int offset = index * sizeof(GlobalTable::Slot);
+    int base = globalBase;
+    usedGlobals[name] = index;
+
+    // Nothing but the type speculated on will do, undefined included
+    IRType type;
+    auto known = knownGlobals.find(name);
+    if (known != knownGlobals.end()) {
+        type = known->second;
+    } else {
+        type = globalTypes.count(name) ? globalTypes[name] : IRType::INT;
+        int tag = builder->emitLoad(base, offset + GlobalTable::TYPE_OFFSET);
+        emitGuard(builder->emitBinary(IROp::CMP_EQ, tag, builder->emitConst((int)type)));
+        knownGlobals[name] = type;
+    }
+    return builder->emitLoad(base, offset + GlobalTable::BITS_OFFSET, type);
+}
+
+void NativeJIT::compileGlobalStore(Symbol name, int index, int value) {
+    IRFunction& func = builder->function();
+    int offset = index * sizeof(GlobalTable::Slot);
+    int base = globalBase;
+    usedGlobals[name] = index;
+    IRType type = func.types[value];
+    int tag = builder->emitConst((int)type);
+    auto store = [&]() {
+        int slot = builder->emitBinary(IROp::ADD, base, builder->emitConst(offset));
+        builder->emitCallRuntime((void*)&runtimeStoreGlobal, {slot, value, tag});
+    };
+
+    // A string takes a reference, and one the slot held has to be let go
+    // of; anything else is stored in place
+    auto known = knownGlobals.find(name);
+    if (type == IRType::STRING || (known != knownGlobals.end() && known->second == IRType::STRING)) {
+        store();
+    } else {
+        int endBlock = -1;
+        if (known == knownGlobals.end()) {
+            int old = builder->emitLoad(base, offset + GlobalTable::TYPE_OFFSET);
+            int isString = builder->emitBinary(IROp::CMP_EQ, old, builder->emitConst((int)IRType::STRING));
+            int releaseBlock = func.newBlock();
+            int inPlaceBlock = func.newBlock();
+            endBlock = func.newBlock();
+            builder->emitBranch(isString, releaseBlock, inPlaceBlock);
+            builder->setBlock(releaseBlock);
+            store();
+            builder->emitJump(endBlock);
+            builder->setBlock(inPlaceBlock);
+        }
+        builder->emitStore(base, offset + GlobalTable::BITS_OFFSET, value);
+        builder->emitStore(base, offset + GlobalTable::TYPE_OFFSET, tag);
+        if (endBlock >= 0) {
+            builder->emitJump(endBlock);
+            builder->setBlock(endBlock);
+        }
+    }
+    knownGlobals[name] = type;
+}
+
+// The globals known at a join point: those known the same on both ways in
+static std::map<Symbol, IRType> joinKnown(const std::map<Symbol, IRType>& a,
+                                          const std::map<Symbol, IRType>& b) {
+    std::map<Symbol, IRType> known;
+    for (const auto& entry : a) {
+        auto it = b.find(entry.first);
+        if (it != b.end() && it->second == entry.second) known.insert(entry);
+    }
+    return known;
 }
 
 void NativeJIT::compileStatement(ASTNode* node) {
     if (!node) return;
 
+    // Each statement is a place the interpreter can resume at
+    statementPath.push_back(node);
+    std::vector<std::pair<int, IRType>> savedCalls;
+    savedCalls.swap(statementCalls);
+
     switch (node->type) {
         case ASTNodeType::ASSIGNMENT: {
             AssignmentNode* assign = static_cast<AssignmentNode*>(node);
-            compileExpression(assign->value.get());
-            auto it = localVarMap.find(assign->variable);
-            if (it != localVarMap.end()) {
-                codegen->emitStoreLocal(it->second);
-            } else {
-                throw std::runtime_error("Undefined variable in JIT assignment: " + assign->variable);
+            if (assign->slot < 0) {
+                compileGlobalStore(assign->variable, assign->global, compileExpression(assign->value.get()));
+                break;
             }
+            int value = compileExpression(assign->value.get());
+            auto it = localVarMap.find(assign->slot);
+            if (it == localVarMap.end()) {
+                throw std::runtime_error("Undefined variable in JIT assignment: " + assign->variable.str());
+            }
+            IRFunction& func = builder->function();
+            if (func.types[value] != func.types[it->second]) {
+                throw std::runtime_error("Variable " + assign->variable.str() + " is both " +
+                                         typeNames[(int)func.types[it->second]] + " and " +
+                                         typeNames[(int)func.types[value]]);
+            }
+            builder->emitMove(it->second, value);
             break;
         }
 
         case ASTNodeType::IF_STMT: {
             IfNode* ifNode = static_cast<IfNode*>(node);
+            IRFunction& func = builder->function();
 
-            Label elseLabel = codegen->createLabel();
-            Label endLabel = codegen->createLabel();
+            int thenBlock = func.newBlock();
+            int elseBlock = ifNode->elseBlock ? func.newBlock() : -1;
+            int endBlock = func.newBlock();
 
             // Compile condition
-            compileExpression(ifNode->condition.get());
-
-            // Jump to else if false
-            codegen->emitJumpIfFalse(elseLabel);
+            int cond = truthy(compileExpression(ifNode->condition.get()));
+            builder->emitBranch(cond, thenBlock, elseBlock >= 0 ? elseBlock : endBlock);
 
             // Compile then block
+            auto known = knownGlobals;
+            builder->setBlock(thenBlock);
             compileStatement(ifNode->thenBlock.get());
-
-            if (ifNode->elseBlock) {
-                codegen->emitJump(endLabel);
-            }
-
-            // Else label
-            codegen->bindLabel(elseLabel);
+            builder->emitJump(endBlock);
+            std::swap(known, knownGlobals);
 
             // Compile else block
             if (ifNode->elseBlock) {
+                builder->setBlock(elseBlock);
                 compileStatement(ifNode->elseBlock.get());
-                codegen->bindLabel(endLabel);
+                builder->emitJump(endBlock);
             }
+
+            builder->setBlock(endBlock);
+            knownGlobals = joinKnown(known, knownGlobals);
             break;
         }
 
         case ASTNodeType::WHILE_STMT: {
             WhileNode* whileNode = static_cast<WhileNode*>(node);
+            IRFunction& func = builder->function();
 
-            Label loopStart = codegen->createLabel();
-            Label loopEnd = codegen->createLabel();
+            int headerBlock = func.newBlock();
+            int bodyBlock = func.newBlock();
+            int exitBlock = func.newBlock();
 
-            codegen->bindLabel(loopStart);
+            builder->emitJump(headerBlock);
+            if (whileNode == osrLoop) osrHeader = headerBlock;
 
-            // Compile condition
-            compileExpression(whileNode->condition.get());
-            codegen->emitJumpIfFalse(loopEnd);
+            // Compile condition; the back edge may bring globals of any type
+            knownGlobals.clear();
+            builder->setBlock(headerBlock);
+            int cond = truthy(compileExpression(whileNode->condition.get()));
+            builder->emitBranch(cond, bodyBlock, exitBlock);
+            auto known = knownGlobals;
 
-            // Compile body
+            // Compile body, then jump back to the condition
+            builder->setBlock(bodyBlock);
             compileStatement(whileNode->body.get());
+            builder->emitJump(headerBlock);
 
-            // Jump back to start
-            codegen->emitJump(loopStart);
-
-            codegen->bindLabel(loopEnd);
+            builder->setBlock(exitBlock);
+            knownGlobals = std::move(known);
             break;
         }
 
@@ -293,12 +965,22 @@ void NativeJIT::compileStatement(ASTNode* node) {
 
         case ASTNodeType::RETURN: {
             ReturnNode* retNode = static_cast<ReturnNode*>(node);
-            if (retNode->value) {
-                compileExpression(retNode->value.get());
-            } else {
-                codegen->emitLoadImmediate(0);
+            if (retNode->value && retNode->value->type == ASTNodeType::FUNCTION_CALL && inlineExit < 0) {
+                compileCall(static_cast<FunctionCallNode*>(retNode->value.get()), true, true);
+                break;
+            }
+            int value = retNode->value ? compileExpression(retNode->value.get())
+                                       : builder->emitConst(0, IRType::NIL);
+            IRFunction& func = builder->function();
+            if (inlineExit >= 0) {
+                if (func.types[value] != func.types[inlineResult]) {
+                    throw std::runtime_error("Mixed return types");
+                }
+                builder->emitMove(inlineResult, value);
+                builder->emitJump(inlineExit);
+                break;
             }
-            codegen->emitReturn();
+            builder->emitReturn(value, builder->emitConst((int)func.types[value]));
             break;
         }
 
@@ -306,31 +988,53 @@ void NativeJIT::compileStatement(ASTNode* node) {
             PrintNode* print = static_cast<PrintNode*>(node);
 
             for (size_t i = 0; i < print->args.size(); i++) {
+                printedArgs = i;
                 if (i > 0) {
                     // Print tab separator
-                    codegen->emitCallRuntime((void*)&runtimePrintTab, 0);
+                    builder->emitCallRuntime((void*)&runtimePrintTab, {});
                 }
 
-                // For simplicity, assume all print args are integers
-                // A full implementation would track types
-                compileExpression(print->args[i].get());
-                codegen->emitSetCallArg(0);
-                codegen->emitCallRuntime((void*)&runtimePrintInt, 1);
+                int value = compileExpression(print->args[i].get());
+                switch (builder->function().types[value]) {
+                    case IRType::INT:
+                        builder->emitCallRuntime((void*)&runtimePrintInt, {value});
+                        break;
+                    case IRType::BOOL:
+                        builder->emitCallRuntime((void*)&runtimePrintBool, {value});
+                        break;
+                    case IRType::STRING:
+                        builder->emitCallRuntime((void*)&runtimePrintString, {value});
+                        break;
+                    case IRType::NIL:
+                        builder->emitCallRuntime((void*)&runtimePrintNil, {});
+                        break;
+                }
             }
+            printedArgs = 0;
 
             // Print newline
-            codegen->emitCallRuntime((void*)&runtimePrintNewline, 0);
+            builder->emitCallRuntime((void*)&runtimePrintNewline, {});
             break;
         }
 
         case ASTNodeType::FUNCTION_DEF: {
-            // Function definitions are handled at the top level
+            FunctionDefNode* funcDef = static_cast<FunctionDefNode*>(node);
+            if (!mainChunk) {
+                // Defining (or redefining) a function takes the interpreter
+                throw std::runtime_error("Function definition in JIT: " + funcDef->name.str());
+            }
+            // The main chunk defines it as the interpreter would, but the
+            // code compiled so far may rely on a definition it replaces:
+            // the interpreter takes over then, and finds the work done
+            int redefined = builder->emitCallRuntime((void*)&runtimeDefineFunction,
+                                                     {builder->emitConst((long long)funcDef)}, IRType::BOOL);
+            emitGuard(builder->emitUnary(IROp::NOT, redefined));
             break;
         }
 
         case ASTNodeType::FUNCTION_CALL: {
             // Expression statement (call for side effects)
-            compileExpression(node);
+            compileCall(static_cast<FunctionCallNode*>(node), false);
             break;
         }
 
@@ -339,223 +1043,879 @@ void NativeJIT::compileStatement(ASTNode* node) {
             compileExpression(node);
             break;
     }
+
+    statementCalls.swap(savedCalls);
+    statementPath.pop_back();
 }
 
-CompiledFunc NativeJIT::compileFunction(FunctionDefNode* func) {
-    codegen->clear();
+void NativeJIT::beginCompile(FunctionDefNode* func) {
     localVarMap.clear();
-    functionParams.clear();
-    currentFunction = func->name;
+    localTypes.clear();
+    pendingCalls.clear();
+    statementPath.clear();
+    statementCalls.clear();
+    printedArgs = 0;
+    currentDef = func;
+    globalTypes.clear();
+    knownGlobals.clear();
+    usedGlobals.clear();
+    globalBase = -1;
+    argsBase = -1;
+    osrLoop = nullptr;
+    mainChunk = false;
+    inlineExit = -1;
+    inlineResult = -1;
+    inlinedSize = 0;
+    inlinedCallees.clear();
+    assumedResults.clear();
+    tailEntry = -1;
+    tailParamTypes.clear();
+    firstDeoptPoint = deoptPoints.size();
+}
 
-    // Map parameters to local slots
-    int slot = 0;
-    for (const auto& param : func->params) {
-        localVarMap[param] = slot++;
-        functionParams.insert(param);
-    }
+void NativeJIT::placeDeoptPoints(void* code) {
+    for (size_t i = firstDeoptPoint; i < deoptPoints.size(); i++) deoptPoints[i].code = code;
+    deoptBases[(const uint8_t*)code] = firstDeoptPoint;
+}
 
-    // Collect all local variables used in the function body
-    std::set<std::string> locals;
-    collectLocals(func->body.get(), locals);
+CompiledFunc NativeJIT::compileFunction(FunctionDefNode* func) {
+    beginCompile(func);
 
-    // Add locals that aren't parameters
-    for (const auto& local : locals) {
-        if (localVarMap.find(local) == localVarMap.end()) {
-            localVarMap[local] = slot++;
-        }
+    // Parameters take the types the interpreter has seen them have
+    const Interpreter::FunctionProfile* profile = interpreter->profile(func);
+    std::vector<IRType> paramTypes;
+    for (size_t i = 0; i < func->params.size(); i++) {
+        uint8_t mask = profile && i < profile->argTypes.size() ? profile->argTypes[i] : 0;
+        paramTypes.push_back(parameterType(mask, "parameter " + func->params[i].str()));
+        localTypes[i] = paramTypes.back();
     }
 
-    localVarCount = slot;
+    // A previous run may have compiled the same definition for the same
+    // types already
+    uint64_t cacheKey = 0;
+    if (jitCache) {
+        cacheKey = JitCache::key(func, typeBytes(paramTypes), compilerId());
+        if (CompiledFunc cached = loadCached(func, cacheKey, paramTypes)) return cached;
+    }
+    speculateGlobals(func->body.get());
+    inferTypes(func->body.get());
 
-    // Generate prologue
-    codegen->emitPrologue(localVarCount);
+    IRFunction ir;
+    ir.name = func->name.str();
+    IRBuilder irBuilder(ir);
+    builder = &irBuilder;
 
-    // Copy arguments from arg array to local slots
+    // Parameters are loaded from the args array on entry
     for (size_t i = 0; i < func->params.size(); i++) {
-        codegen->emitLoadArg(i);
-        codegen->emitStoreLocal(localVarMap[func->params[i]]);
+        int vreg = ir.newVReg(paramTypes[i]);
+        localVarMap[i] = vreg;
+        irBuilder.emitArg(vreg, i);
     }
-
-    // Compile function body
+    argsBase = irBuilder.emitArgs();
+    globalBase = irBuilder.emitGlobals();
+    declareLocals(ir, func->body.get());
+
+    // Compile function body, which self tail calls jump back to
+    tailEntry = ir.newBlock();
+    tailParamTypes = paramTypes;
+    irBuilder.emitJump(tailEntry);
+    irBuilder.setBlock(tailEntry);
     compileStatement(func->body.get());
 
-    // Default return 0 if no explicit return
-    codegen->emitLoadImmediate(0);
-    codegen->emitEpilogue();
-
-    // Allocate executable memory and copy code
-    const auto& code = codegen->getCode();
-    void* execMem = allocateExecutableMemory(code.size());
-    memcpy(execMem, code.data(), code.size());
+    // Falling off the end returns nil
+    irBuilder.emitReturn(irBuilder.emitConst(0, IRType::NIL), irBuilder.emitConst((int)IRType::NIL));
+    builder = nullptr;
 
     CompiledFuncInfo info;
-    info.code = execMem;
-    info.codeSize = code.size();
-    info.func = (CompiledFunc)execMem;
-
-    compiledFunctions[func->name] = info;
-
+    info.code = generateCode(ir, info.codeSize);
+    info.func = (CompiledFunc)info.code;
+    info.paramTypes = paramTypes;
+    info.inlined = inlinedCallees;
+    placeDeoptPoints(info.code);
+    if (jitCache) storeCached(func, cacheKey);
+
+    installFunction(func, info);
     return info.func;
 }
 
-bool NativeJIT::isCompiled(const std::string& name) const {
-    return compiledFunctions.find(name) != compiledFunctions.end();
-}
+void NativeJIT::installFunction(FunctionDefNode* func, const CompiledFuncInfo& info) {
+    entries[func] = info;
 
-long long NativeJIT::callCompiled(const std::string& name, long long* args, int argCount) {
-    auto it = compiledFunctions.find(name);
-    if (it != compiledFunctions.end()) {
-        return it->second.func(args, argCount);
+    // Callers compiled earlier (and recursive calls) now branch straight
+    // here, unless the function has been redefined in the meantime
+    if (interpreter->definition(func->name) == func) {
+        compiledFunctions[func->name] = info;
+        patchCallers(targetKey(func->name, info.paramTypes), info.code);
     }
-    throw std::runtime_error("Function not compiled: " + name);
 }
 
-void NativeJIT::execute(BlockNode* root) {
-    if (!root) return;
+void NativeJIT::useDiskCache(const std::string& dir) {
+    jitCache.reset(new JitCache(dir));
+}
 
-    // First pass: compile all functions
-    for (auto& stmt : root->statements) {
-        if (stmt->type == ASTNodeType::FUNCTION_DEF) {
-            FunctionDefNode* funcDef = static_cast<FunctionDefNode*>(stmt.get());
-            try {
-                compileFunction(funcDef);
-                // Also register with interpreter for fallback
-                interpreter->functions[funcDef->name] = funcDef;
-            } catch (const std::exception& e) {
-                // Fallback to interpreter for this function
-                std::cerr << "JIT compilation failed for " << funcDef->name
-                         << ": " << e.what() << ", using interpreter" << std::endl;
-                interpreter->functions[funcDef->name] = funcDef;
-            }
+// Function definitions anywhere in a program, outermost first
+static void collectFunctions(ASTNode* node, std::vector<FunctionDefNode*>& funcs) {
+    if (!node) return;
+
+    switch (node->type) {
+        case ASTNodeType::FUNCTION_DEF: {
+            FunctionDefNode* func = static_cast<FunctionDefNode*>(node);
+            funcs.push_back(func);
+            collectFunctions(func->body.get(), funcs);
+            break;
         }
+        case ASTNodeType::IF_STMT: {
+            IfNode* ifNode = static_cast<IfNode*>(node);
+            collectFunctions(ifNode->thenBlock.get(), funcs);
+            collectFunctions(ifNode->elseBlock.get(), funcs);
+            break;
+        }
+        case ASTNodeType::WHILE_STMT:
+            collectFunctions(static_cast<WhileNode*>(node)->body.get(), funcs);
+            break;
+        case ASTNodeType::BLOCK:
+            for (auto& stmt : static_cast<BlockNode*>(node)->statements) {
+                collectFunctions(stmt.get(), funcs);
+            }
+            break;
+        default:
+            break;
     }
+}
 
-    // Second pass: execute top-level statements
-    for (auto& stmt : root->statements) {
-        if (stmt->type != ASTNodeType::FUNCTION_DEF) {
-            executeStatement(stmt.get());
+std::vector<uint8_t> NativeJIT::precompile(BlockNode* program) {
+    std::vector<FunctionDefNode*> funcs;
+    collectFunctions(program, funcs);
+
+    // Each definition is compiled as if it were the one in effect, with
+    // nothing profiled
+    jitCache.reset(new JitCache());
+    for (FunctionDefNode* func : funcs) {
+        interpreter->functions.insert_or_assign(func->name, func);
+        reclaim();
+        try {
+            compileFunction(func);
+        } catch (const std::exception&) {
+            // Runs interpreted, and compiled as usual once hot
         }
     }
+    return jitCache->pack();
 }
 
-// Helper to evaluate expression, using JIT for function calls
-Value NativeJIT::evaluateWithJIT(ASTNode* node) {
-    if (!node) return Value();
+void NativeJIT::useImage(const uint8_t* image, size_t size) {
+    jitCache.reset(new JitCache());
+    jitCache->unpack(image, size);
+}
 
-    if (node->type == ASTNodeType::FUNCTION_CALL) {
-        FunctionCallNode* call = static_cast<FunctionCallNode*>(node);
-        if (isCompiled(call->name)) {
-            // Evaluate arguments recursively
-            std::vector<long long> args;
-            for (auto& arg : call->args) {
-                Value val = evaluateWithJIT(arg.get());
-                args.push_back(val.asInteger());
+std::string NativeJIT::compilerId() {
+    // The build stands in for everything that shapes generated code
+    return std::string("mini-luau-jit ") + std::to_string(JIT_CACHE_VERSION) +
+           (CodeGenerator::isX86_64() ? " x86-64 " : " arm64 ") + __DATE__ " " __TIME__;
+}
+
+void NativeJIT::storeCached(FunctionDefNode* func, uint64_t key) {
+    CachedFunction entry;
+    entry.code = codegen->getCode();
+    entry.relocations = relocations;
+    for (const auto& relocation : relocations) {
+        if (relocation.kind == Relocation::HELPER && relocation.symbol.empty()) return;
+    }
+
+    for (const auto& call : pendingCalls) {
+        const CallTarget& target = callTargets[call.callee];
+        entry.calls.push_back({(uint32_t)call.callOffset, (uint32_t)call.veneerOffset, call.callee,
+                               target.name.str(), typeBytes(target.argTypes)});
+    }
+
+    // Deopt paths by node number; code whose paths lead outside the
+    // function isn't cached
+    std::vector<ASTNode*> nodes = JitCache::nodes(func);
+    std::unordered_map<const ASTNode*, uint32_t> numbers;
+    for (size_t i = 0; i < nodes.size(); i++) numbers[nodes[i]] = i;
+    for (size_t i = firstDeoptPoint; i < deoptPoints.size(); i++) {
+        CachedFunction::Deopt deopt;
+        deopt.printed = deoptPoints[i].printed;
+        for (ASTNode* node : deoptPoints[i].path) {
+            auto it = numbers.find(node);
+            if (it == numbers.end()) return;
+            deopt.path.push_back(it->second);
+        }
+        entry.deopts.push_back(deopt);
+    }
+
+    for (const auto& name : inlinedCallees) {
+        entry.inlined.push_back({name.str(), JitCache::hashFunction(interpreter->definition(name))});
+    }
+    for (const auto& result : assumedResults) {
+        entry.results.push_back({result.first.str(), (uint8_t)result.second});
+    }
+    for (const auto& global : usedGlobals) {
+        entry.globals.push_back({global.first.str(), (uint32_t)global.second});
+    }
+    jitCache->store(key, entry);
+}
+
+CompiledFunc NativeJIT::loadCached(FunctionDefNode* func, uint64_t key, const std::vector<IRType>& paramTypes) {
+    CachedFunction entry;
+    if (!jitCache->load(key, entry)) return nullptr;
+
+    // The code may be used as it is if the functions it inlined (and its
+    // own name, which self tail calls rely on) still mean the same, its
+    // globals have the same slots, and everything it refers to can be
+    // found. Names come back as text and are interned again.
+    if (interpreter->definition(func->name) != func) return nullptr;
+    for (const auto& callee : entry.inlined) {
+        auto it = interpreter->functions.find(Symbol::intern(callee.first));
+        if (it == interpreter->functions.end() || JitCache::hashFunction(it->second) != callee.second) {
+            return nullptr;
+        }
+    }
+    for (const auto& global : entry.globals) {
+        if (interpreter->globals.find(Symbol::intern(global.first)) != (int)global.second) return nullptr;
+    }
+    for (const auto& result : entry.results) {
+        try {
+            if (returnType(Symbol::intern(result.first)) != (IRType)result.second) return nullptr;
+        } catch (const std::runtime_error&) {
+            return nullptr;
+        }
+    }
+    std::vector<uint64_t> addresses;
+    for (const auto& relocation : entry.relocations) {
+        switch (relocation.kind) {
+            case Relocation::HELPER: {
+                void* helper = helperAddress(relocation.symbol);
+                if (!helper) return nullptr;
+                addresses.push_back((uint64_t)helper);
+                break;
             }
-            long long result = callCompiled(call->name, args.data(), args.size());
-            return Value(result);
+            case Relocation::STRING:
+                addresses.push_back(Value::interned(relocation.symbol).bits());
+                break;
+            case Relocation::GLOBALS:
+                addresses.push_back((uint64_t)interpreter->globals.base());
+                break;
+        }
+    }
+    std::vector<ASTNode*> nodes = JitCache::nodes(func);
+    for (const auto& deopt : entry.deopts) {
+        for (uint32_t node : deopt.path) {
+            if (node >= nodes.size()) return nullptr;
         }
     }
 
-    // For other expressions, use interpreter
-    return interpreter->evaluate(node);
+    CodeCache::WriteScope writable(codeCache);
+    uint8_t* code = codeCache.allocate(entry.code.size());
+    memcpy(code, entry.code.data(), entry.code.size());
+    for (size_t i = 0; i < entry.relocations.size(); i++) {
+        codegen->patchAddress(code + entry.relocations[i].offset, addresses[i]);
+    }
+
+    for (const auto& deopt : entry.deopts) {
+        std::vector<ASTNode*> path;
+        for (uint32_t node : deopt.path) path.push_back(nodes[node]);
+        deoptPoints.push_back({func, nullptr, path, deopt.printed, nullptr, false});
+    }
+    placeDeoptPoints(code);
+
+    // Veneers start out at the stub, as freshly compiled ones do, and are
+    // linked like them
+    for (const auto& call : entry.calls) {
+        CallTarget& target = callTargets[call.key];
+        target.name = Symbol::intern(call.name);
+        target.argTypes.clear();
+        for (uint8_t type : call.argTypes) target.argTypes.push_back((IRType)type);
+        codegen->patchCallVeneerInfo(code + call.veneerOffset, &target);
+        codegen->patchCallVeneer(code + call.veneerOffset, (void*)&jit_call_stub);
+        pendingCalls.push_back({call.callOffset, call.veneerOffset, call.key});
+    }
+    linkCalls(code);
+    __builtin___clear_cache((char*)code, (char*)code + entry.code.size());
+
+    CompiledFuncInfo info;
+    info.code = code;
+    info.codeSize = entry.code.size();
+    info.func = (CompiledFunc)code;
+    info.paramTypes = paramTypes;
+    for (const auto& callee : entry.inlined) info.inlined.insert(Symbol::intern(callee.first));
+    installFunction(func, info);
+    return info.func;
 }
 
-void NativeJIT::executeStatement(ASTNode* stmt) {
-    if (!stmt) return;
+CompiledFunc NativeJIT::compileLoopEntry(FunctionDefNode* func, WhileNode* loop, const Value* frame,
+                                         std::vector<IRType>& types) {
+    beginCompile(func);
+
+    // The entry block takes over the whole interpreter frame: the args
+    // array holds every slot, parameters first, with the types they have
+    // right now
+    std::set<int> slots;
+    std::set<Symbol> globals;
+    for (size_t i = 0; i < func->params.size(); i++) slots.insert(i);
+    collectVariables(func->body.get(), slots, globals);
+    for (int slot : slots) {
+        const Value& value = frame[slot];
+        if (!value.isNone()) localTypes[slot] = (IRType)value.type;
+    }
+    speculateGlobals(func->body.get());
+    inferTypes(func->body.get());
+
+    IRFunction ir;
+    ir.name = func->name.str() + "@loop";
+    IRBuilder irBuilder(ir);
+    builder = &irBuilder;
+
+    types.assign(func->frameSize, IRType::NIL);
+    for (int slot : slots) {
+        IRType type = localTypes.count(slot) ? localTypes[slot] : IRType::INT;
+        localTypes[slot] = type;
+        types[slot] = type;
+        int vreg = ir.newVReg(type);
+        localVarMap[slot] = vreg;
+        irBuilder.emitArg(vreg, slot);
+    }
+    argsBase = irBuilder.emitArgs();
+    globalBase = irBuilder.emitGlobals();
+
+    // The function's own entry path is compiled as usual; the loop header
+    // is the only way in, apart from self tail calls
+    tailEntry = ir.newBlock();
+    for (size_t i = 0; i < func->params.size(); i++) tailParamTypes.push_back(localTypes[i]);
+    irBuilder.setBlock(tailEntry);
+    osrLoop = loop;
+    osrHeader = -1;
+    compileStatement(func->body.get());
+    irBuilder.emitReturn(irBuilder.emitConst(0, IRType::NIL), irBuilder.emitConst((int)IRType::NIL));
+    osrLoop = nullptr;
 
-    // Handle assignments specially to use JIT for function calls
-    if (stmt->type == ASTNodeType::ASSIGNMENT) {
-        AssignmentNode* assign = static_cast<AssignmentNode*>(stmt);
-        Value val = evaluateWithJIT(assign->value.get());
-        interpreter->variables[assign->variable] = val;
-        return;
+    if (osrHeader < 0) {
+        throw std::runtime_error("Loop not found in " + func->name.str());
     }
+    irBuilder.setBlock(0);
+    irBuilder.emitJump(osrHeader);
+    builder = nullptr;
+
+    size_t codeSize;
+    void* code = generateCode(ir, codeSize);
+    placeDeoptPoints(code);
+    return (CompiledFunc)code;
+}
 
-    // For direct function calls, use JIT if available
-    if (stmt->type == ASTNodeType::FUNCTION_CALL) {
-        FunctionCallNode* call = static_cast<FunctionCallNode*>(stmt);
-        if (isCompiled(call->name)) {
-            std::vector<long long> args;
-            for (auto& arg : call->args) {
-                Value val = evaluateWithJIT(arg.get());
-                args.push_back(val.asInteger());
-            }
-            callCompiled(call->name, args.data(), args.size());
-            return;
+CompiledFunc NativeJIT::compileChunk(BlockNode* chunk, WhileNode* loop) {
+    beginCompile(nullptr);
+    mainChunk = true;
+    speculateGlobals(chunk);
+
+    IRFunction ir;
+    ir.name = "main";
+    IRBuilder irBuilder(ir);
+    builder = &irBuilder;
+
+    // As for a loop in a function, the loop header is the only way in,
+    // so the statements before the one holding the loop are left out.
+    // Those after it are compiled as far as the budget goes; the
+    // interpreter runs the rest.
+    globalBase = irBuilder.emitGlobals();
+    irBuilder.setBlock(ir.newBlock());
+    osrLoop = loop;
+    osrHeader = -1;
+    statementPath.push_back(chunk);
+    auto& statements = chunk->statements;
+    size_t i = 0;
+    while (i < statements.size() && !containsLoop(statements[i].get(), loop)) i++;
+    for (size_t first = i; i < statements.size(); i++) {
+        size_t size = 0;
+        for (const auto& block : ir.blocks) size += block.instrs.size();
+        if (i > first && size > MAX_CHUNK_SIZE) {
+            statementPath.push_back(statements[i].get());
+            emitDeopt(-1, -1, true);
+            statementPath.pop_back();
+            break;
         }
+        compileStatement(statements[i].get());
     }
+    statementPath.pop_back();
+    if (i == statements.size()) {
+        irBuilder.emitReturn(irBuilder.emitConst(0, IRType::NIL), irBuilder.emitConst((int)IRType::NIL));
+    }
+    osrLoop = nullptr;
+
+    if (osrHeader < 0) {
+        throw std::runtime_error("Loop not found in the main chunk");
+    }
+    irBuilder.setBlock(0);
+    irBuilder.emitJump(osrHeader);
+    builder = nullptr;
+
+    size_t codeSize;
+    void* code = generateCode(ir, codeSize);
+    placeDeoptPoints(code);
+    return (CompiledFunc)code;
+}
+
+void* NativeJIT::generateCode(IRFunction& ir, size_t& codeSize) {
+    // Optimize in SSA form, then lower back to copies for the allocator
+    constructSSA(ir);
+    PassManager::standard().run(ir);
+    destructSSA(ir);
 
-    // Handle print specially
-    if (stmt->type == ASTNodeType::PRINT) {
-        PrintNode* print = static_cast<PrintNode*>(stmt);
-        for (size_t i = 0; i < print->args.size(); ++i) {
-            if (i > 0) std::cout << "\t";
-            Value val = evaluateWithJIT(print->args[i].get());
-            switch (val.type) {
-                case ValueType::INTEGER:
-                    std::cout << val.asInteger();
+    // Register allocation and code generation
+    RegAllocation alloc = allocateRegisters(ir, codegen->allocatableRegCount());
+    emitFunction(ir, alloc);
+
+    emitCallVeneers();
+
+    // Copy the code into the cache and link it while it is writable
+    const auto& code = codegen->getCode();
+    CodeCache::WriteScope writable(codeCache);
+    uint8_t* execMem = codeCache.allocate(code.size());
+    memcpy(execMem, code.data(), code.size());
+
+    linkCalls(execMem);
+    __builtin___clear_cache((char*)execMem, (char*)execMem + code.size());
+
+    codeSize = code.size();
+    return execMem;
+}
+
+void NativeJIT::emitFunction(const IRFunction& func, const RegAllocation& alloc) {
+    codegen->clear();
+    relocations.clear();
+    codegen->emitPrologue(alloc.spillSlots, alloc.usedRegs);
+
+    std::vector<Label> labels;
+    for (size_t i = 0; i < func.blocks.size(); i++) {
+        labels.push_back(codegen->createLabel());
+    }
+
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        codegen->bindLabel(labels[b]);
+        int next = b + 1;
+
+        for (const auto& instr : func.blocks[b].instrs) {
+            Operand dst = instr.dst >= 0 ? alloc[instr.dst] : Operand::imm(0);
+            auto arg = [&](int i) { return alloc[instr.args[i]]; };
+
+            switch (instr.op) {
+                case IROp::CONST:
+                    if (func.types[instr.dst] == IRType::STRING && instr.imm != 0 && !dst.isImm()) {
+                        // Interned strings are found again by their contents
+                        size_t at = codegen->emitMoveAddress(dst, instr.imm);
+                        std::string text = Value::fromBits(ValueType::STRING, instr.imm).asString();
+                        relocations.push_back({(uint32_t)at, Relocation::STRING, text});
+                    } else {
+                        codegen->emitMove(dst, Operand::imm(instr.imm));
+                    }
+                    break;
+                case IROp::MOVE:
+                    codegen->emitMove(dst, arg(0));
+                    break;
+                case IROp::ARG:
+                    codegen->emitLoadArg(dst, instr.imm);
                     break;
-                case ValueType::BOOLEAN:
-                    std::cout << (val.asBoolean() ? "true" : "false");
+                case IROp::ARGS:
+                    codegen->emitLoadArgs(dst);
                     break;
-                case ValueType::STRING:
-                    std::cout << val.asString();
+                case IROp::PHI:
+                    throw std::runtime_error("PHI reached code generation");
+
+                case IROp::ADD: codegen->emitBinary(ALUOp::ADD, dst, arg(0), arg(1)); break;
+                case IROp::SUB: codegen->emitBinary(ALUOp::SUB, dst, arg(0), arg(1)); break;
+                case IROp::MUL: codegen->emitBinary(ALUOp::MUL, dst, arg(0), arg(1)); break;
+                case IROp::DIV: codegen->emitBinary(ALUOp::DIV, dst, arg(0), arg(1)); break;
+                case IROp::MOD: codegen->emitBinary(ALUOp::MOD, dst, arg(0), arg(1)); break;
+                case IROp::AND: codegen->emitBinary(ALUOp::AND, dst, arg(0), arg(1)); break;
+                case IROp::OR:  codegen->emitBinary(ALUOp::OR, dst, arg(0), arg(1)); break;
+
+                case IROp::CMP_EQ: codegen->emitCompare(CondCode::EQ, dst, arg(0), arg(1)); break;
+                case IROp::CMP_NE: codegen->emitCompare(CondCode::NE, dst, arg(0), arg(1)); break;
+                case IROp::CMP_LT: codegen->emitCompare(CondCode::LT, dst, arg(0), arg(1)); break;
+                case IROp::CMP_LE: codegen->emitCompare(CondCode::LE, dst, arg(0), arg(1)); break;
+                case IROp::CMP_GT: codegen->emitCompare(CondCode::GT, dst, arg(0), arg(1)); break;
+                case IROp::CMP_GE: codegen->emitCompare(CondCode::GE, dst, arg(0), arg(1)); break;
+
+                case IROp::NOT: codegen->emitNot(dst, arg(0)); break;
+                case IROp::NEG: codegen->emitNeg(dst, arg(0)); break;
+
+                case IROp::CALL: {
+                    int argCount = instr.args.size();
+                    // Evaluate arguments into the per-call area on the stack
+                    codegen->emitAllocCallArgs(argCount);
+                    for (int i = 0; i < argCount; i++) {
+                        codegen->emitStoreCallArg(i, arg(i));
+                    }
+                    // Direct call, bound to the callee (or a veneer) at link time
+                    size_t callOffset = codegen->emitCallDirect(argCount);
+                    pendingCalls.push_back({callOffset, 0, instr.callee});
+                    codegen->emitGetResult(dst);
                     break;
-                case ValueType::NONE:
-                    std::cout << "nil";
+                }
+
+                case IROp::CALL_RUNTIME:
+                    for (size_t i = 0; i < instr.args.size(); i++) {
+                        codegen->emitSetCallArg(i, arg(i));
+                    }
+                    relocations.push_back({(uint32_t)codegen->emitCallRuntime(instr.runtimeFunc, instr.args.size()),
+                                           Relocation::HELPER, helperName(instr.runtimeFunc)});
+                    if (instr.dst >= 0) codegen->emitGetResult(dst);
+                    break;
+
+                case IROp::RESULT_TYPE:
+                    codegen->emitGetResultType(dst);
+                    break;
+
+                case IROp::GLOBALS: {
+                    size_t at = codegen->emitMoveAddress(dst, (uint64_t)interpreter->globals.base());
+                    relocations.push_back({(uint32_t)at, Relocation::GLOBALS, ""});
                     break;
+                }
+                case IROp::LOAD:
+                    codegen->emitLoad(dst, arg(0), instr.imm);
+                    break;
+                case IROp::STORE:
+                    codegen->emitStore(arg(0), instr.imm, arg(1));
+                    break;
+
+                case IROp::JUMP:
+                    // Fall through to the next block when possible
+                    if (instr.target != next) {
+                        codegen->emitJump(labels[instr.target]);
+                    }
+                    break;
+
+                case IROp::BRANCH:
+                    if (instr.target == next) {
+                        codegen->emitJumpIfFalse(arg(0), labels[instr.elseTarget]);
+                    } else {
+                        codegen->emitJumpIfTrue(arg(0), labels[instr.target]);
+                        if (instr.elseTarget != next) {
+                            codegen->emitJump(labels[instr.elseTarget]);
+                        }
+                    }
+                    break;
+
+                case IROp::RETURN:
+                    codegen->emitReturn(arg(0), arg(1));
+                    break;
+
+                case IROp::TAIL_CALL: {
+                    int argCount = instr.args.size() - 1;
+                    codegen->emitLoadTailCallArea(arg(0));
+                    for (int i = 0; i < argCount; i++) {
+                        codegen->emitStoreTailCallArg(i, arg(i + 1));
+                    }
+                    // Bound and linked like a direct call
+                    size_t jumpOffset = codegen->emitTailCallDirect(argCount);
+                    pendingCalls.push_back({jumpOffset, 0, instr.callee});
+                    break;
+                }
             }
         }
-        std::cout << std::endl;
+    }
+}
+
+void NativeJIT::emitCallVeneers() {
+    // One veneer per distinct callee, self-recursion included, so that
+    // every call site can be repointed when its callee is redefined
+    std::map<std::string, size_t> veneers;
+    for (auto& call : pendingCalls) {
+        auto it = veneers.find(call.callee);
+        if (it == veneers.end()) {
+            size_t offset = codegen->emitCallVeneer(&callTargets[call.callee], (void*)&jit_call_stub);
+            it = veneers.emplace(call.callee, offset).first;
+        }
+        call.veneerOffset = it->second;
+        codegen->bindCallDirect(call.callOffset, call.veneerOffset);
+    }
+}
+
+void NativeJIT::linkCalls(uint8_t* code) {
+    for (const auto& call : pendingCalls) {
+        LinkedCallSite site = {code + call.callOffset, code + call.veneerOffset};
+        CallTarget& target = callTargets[call.callee];
+        target.sites.push_back(site);
+
+        // Only code specialized for these argument types can be called directly
+        auto it = compiledFunctions.find(target.name);
+        if (it != compiledFunctions.end() && it->second.paramTypes == target.argTypes) {
+            codegen->patchCallVeneer(site.veneer, it->second.code);
+            codegen->patchCallSite(site.call, it->second.code);
+        }
+    }
+}
+
+void NativeJIT::patchCallers(const std::string& key, void* entry) {
+    auto it = callTargets.find(key);
+    if (it == callTargets.end()) return;
+
+    CodeCache::WriteScope writable(codeCache);
+    for (const auto& site : it->second.sites) {
+        // Out-of-range sites keep going through their veneer
+        codegen->patchCallVeneer(site.veneer, entry);
+        codegen->patchCallSite(site.call, entry);
+    }
+}
+
+void NativeJIT::unlinkCallers(CallTarget& target) {
+    // Back through the veneers to the stub, which looks the callee up again
+    target.def = nullptr;
+    CodeCache::WriteScope writable(codeCache);
+    for (const auto& site : target.sites) {
+        codegen->patchCallVeneer(site.veneer, (void*)&jit_call_stub);
+        codegen->patchCallSite(site.call, site.veneer);
+    }
+}
+
+void NativeJIT::functionRedefined(Symbol name) {
+    // Callers linked to the old definition, or caching it, let go of it
+    for (auto& entry : callTargets) {
+        if (entry.second.name == name) unlinkCallers(entry.second);
+    }
+    compiledFunctions.erase(name);
+
+    // The old definition's code is thrown out, and so is code that
+    // inlined it
+    std::vector<FunctionDefNode*> stale;
+    for (const auto& entry : entries) {
+        if (entry.first->name == name || entry.second.inlined.count(name)) {
+            stale.push_back(const_cast<FunctionDefNode*>(entry.first));
+        }
+    }
+    for (FunctionDefNode* funcDef : stale) discard(funcDef);
+
+    // So is the code of loops in it, and of the main chunk if it inlined
+    // it
+    for (auto it = loopEntries.begin(); it != loopEntries.end();) {
+        const LoopEntry& entry = it->second;
+        bool keep = (!entry.owner || entry.owner->name != name) && !entry.inlined.count(name);
+        if (keep) {
+            ++it;
+        } else {
+            retire((void*)entry.func);
+            it = loopEntries.erase(it);
+        }
+    }
+}
+
+void NativeJIT::invalidate(const DeoptPoint& point) {
+    // Code still running further up the stack may fail the same guard
+    // again; only the first time counts
+    if (point.loop) {
+        auto it = loopEntries.find(point.loop);
+        if (it != loopEntries.end() && (void*)it->second.func == point.code) {
+            retire(point.code);
+            it->second.func = nullptr;
+            it->second.deopts++;
+        }
         return;
     }
 
-    // Fallback to interpreter
-    interpreter->executeStatement(stmt);
+    auto it = entries.find(point.func);
+    if (it != entries.end() && it->second.code == point.code) discard(point.func);
+}
+
+void NativeJIT::discard(FunctionDefNode* funcDef) {
+    auto it = entries.find(funcDef);
+    auto target = callTargets.find(targetKey(funcDef->name, it->second.paramTypes));
+    if (target != callTargets.end()) unlinkCallers(target->second);
+    auto compiled = compiledFunctions.find(funcDef->name);
+    if (compiled != compiledFunctions.end() && compiled->second.code == it->second.code) {
+        compiledFunctions.erase(compiled);
+    }
+    retire(it->second.code);
+    entries.erase(it);
+    interpreter->deoptimized(funcDef);
+}
+
+bool NativeJIT::isCompiled(Symbol name) const {
+    return compiledFunctions.find(name) != compiledFunctions.end();
+}
+
+void NativeJIT::execute(BlockNode* root) {
+    // Everything starts out interpreted; the interpreter calls compileHot
+    // for functions that get hot, and enterLoop for hot loops, which at
+    // the top level compiles the main chunk
+    program = root;
+    interpreter->execute(root);
+}
+
+bool NativeJIT::compileHot(FunctionDefNode* funcDef) {
+    reclaim();
+    try {
+        compileFunction(funcDef);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "JIT compilation failed for " << funcDef->name.str()
+                  << ": " << e.what() << ", using interpreter" << std::endl;
+        return false;
+    }
+}
+
+NativeResult NativeJIT::toNative(const Value& value) {
+    if (value.type == ValueType::STRING) nativeTemps.push_back(value);
+    return {value.bits(), (long long)value.type};
 }
 
-// Static buffer for passing arguments to JIT-compiled functions
-static long long jit_call_args[16];
-static int jit_call_arg_index = 0;
+bool NativeJIT::callNative(FunctionDefNode* funcDef, std::vector<Value>& args, Value& result) {
+    auto it = entries.find(funcDef);
+    if (it == entries.end()) return false;
+
+    // Entry guard: the code is specialized for its parameter types
+    const std::vector<IRType>& types = it->second.paramTypes;
+    long long smallArgs[8];
+    std::vector<long long> largeArgs;
+    long long* nativeArgs = smallArgs;
+    if (args.size() > 8) {
+        largeArgs.resize(args.size());
+        nativeArgs = largeArgs.data();
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        if (!fits(args[i], types[i])) return false;
+        nativeArgs[i] = args[i].bits();
+    }
+
+    result = runNative(it->second.func, nativeArgs, args.size());
+    return true;
+}
 
-// Helper to push an arg for the next function call
-extern "C" void jit_push_arg(long long value) {
-    if (jit_call_arg_index < 16) {
-        jit_call_args[jit_call_arg_index++] = value;
+Value NativeJIT::runNative(CompiledFunc func, long long* args, int argCount) {
+    jmp_buf* outer = nativeExit;
+    jmp_buf exit;
+    nativeExit = &exit;
+    enterNative();
+    if (setjmp(exit)) {
+        nativeExit = outer;
+        leaveNative();
+        std::exception_ptr error = nativeError;
+        nativeError = nullptr;
+        std::rethrow_exception(error);
     }
+    NativeResult native = func(args, argCount);
+    nativeExit = outer;
+    // A string result may be held by nothing but what leaving releases
+    Value result = Value::fromBits((ValueType)native.type, native.bits);
+    leaveNative();
+    return result;
 }
 
-// Helper to call a function with accumulated args
-extern "C" long long jit_call_func(const char* name) {
-    if (!NativeJIT::currentJIT) {
-        return 0;
+template <typename F>
+NativeResult NativeJIT::guarded(F body) {
+    try {
+        return body();
+    } catch (...) {
+        currentJIT->nativeError = std::current_exception();
     }
+    longjmp(*currentJIT->nativeExit, 1);
+}
 
-    int argCount = jit_call_arg_index;
-    jit_call_arg_index = 0;  // Reset for next call
+void NativeJIT::enterNative() {
+    // Compiled code may hold the strings of globals as bare pointers too;
+    // those replaced meanwhile are kept with the rest
+    if (nativeDepth++ == 0) interpreter->globals.keepReplaced(&nativeTemps);
+}
 
-    std::string funcName(name);
+void NativeJIT::leaveNative() {
+    if (--nativeDepth == 0) {
+        interpreter->globals.keepReplaced(nullptr);
+        nativeTemps.clear();
+        reclaim();
+    }
+}
 
-    // Try JIT first
-    if (NativeJIT::currentJIT->isCompiled(funcName)) {
-        return NativeJIT::currentJIT->callCompiled(funcName, jit_call_args, argCount);
+bool NativeJIT::enterLoop(FunctionDefNode* funcDef, WhileNode* loop, Value* frame, Value& result) {
+    auto it = loopEntries.find(loop);
+    if (it == loopEntries.end() || (!it->second.func && it->second.deopts > 0 && it->second.deopts < 3)) {
+        // Failures are remembered and not reported: for a loop in a
+        // function, compiling the function reports the same problem.
+        // Code that deoptimized is compiled again with the new feedback.
+        LoopEntry& entry = loopEntries[loop];
+        try {
+            if (funcDef) {
+                entry.func = compileLoopEntry(funcDef, loop, frame, entry.types);
+                entry.owner = funcDef;
+            } else if (program) {
+                entry.func = compileChunk(program, loop);
+            }
+            entry.inlined = inlinedCallees;
+        } catch (const std::exception&) {
+            entry.func = nullptr;
+        }
+        if (!entry.func) entry.deopts = 3;
+        it = loopEntries.find(loop);
+    }
+    const LoopEntry& entry = it->second;
+    if (!entry.func || entry.owner != funcDef) return false;
+    CompiledFunc func = entry.func;
+
+    // Transfer the interpreter's frame into the args array, if it has the
+    // types the code was specialized for; the main chunk takes nothing
+    std::vector<long long> state;
+    if (funcDef) {
+        for (int i = 0; i < funcDef->frameSize; i++) {
+            if (!fits(frame[i], entry.types[i])) return false;
+            state.push_back(frame[i].bits());
+        }
     }
 
-    // Fallback to interpreter
-    return NativeJIT::runtimeCallUserFunc(name, jit_call_args, argCount);
+    result = runNative(func, state.data(), state.size());
+    return true;
+}
+
+// Veneers jump here until the callee is compiled for the argument types
+// at hand, and keep doing so if it never is
+extern "C" NativeResult jit_call_stub(long long* args, int argCount, NativeJIT::CallTarget* target) {
+    return NativeJIT::runtimeCallUserFunc(target, args, argCount);
 }
 
 // Runtime callbacks
+const std::vector<std::pair<std::string, void*>>& NativeJIT::runtimeHelpers() {
+    static const std::vector<std::pair<std::string, void*>> helpers = {
+        {"printInt", (void*)&runtimePrintInt},
+        {"printBool", (void*)&runtimePrintBool},
+        {"printString", (void*)&runtimePrintString},
+        {"printNil", (void*)&runtimePrintNil},
+        {"printTab", (void*)&runtimePrintTab},
+        {"printNewline", (void*)&runtimePrintNewline},
+        {"concat", (void*)&runtimeConcat},
+        {"stringEquals", (void*)&runtimeStringEquals},
+        {"divide", (void*)&runtimeDivide},
+        {"storeGlobal", (void*)&runtimeStoreGlobal},
+        {"defineFunction", (void*)&runtimeDefineFunction},
+        {"deoptSlot", (void*)&runtimeDeoptSlot},
+        {"deoptReplay", (void*)&runtimeDeoptReplay},
+        {"deopt", (void*)&runtimeDeopt},
+    };
+    return helpers;
+}
+
+std::string NativeJIT::helperName(void* helper) {
+    for (const auto& entry : runtimeHelpers()) {
+        if (entry.second == helper) return entry.first;
+    }
+    return "";
+}
+
+void* NativeJIT::helperAddress(const std::string& name) {
+    for (const auto& entry : runtimeHelpers()) {
+        if (entry.first == name) return entry.second;
+    }
+    return nullptr;
+}
+
 void NativeJIT::runtimePrintInt(long long value) {
     std::cout << value;
 }
 
-void NativeJIT::runtimePrintBool(int value) {
+void NativeJIT::runtimePrintBool(long long value) {
     std::cout << (value ? "true" : "false");
 }
 
-void NativeJIT::runtimePrintString(const char* value) {
-    std::cout << value;
+void NativeJIT::runtimePrintString(long long value) {
+    std::cout << reinterpret_cast<StringObject*>(value)->str;
+}
+
+void NativeJIT::runtimePrintNil() {
+    std::cout << "nil";
 }
 
 void NativeJIT::runtimePrintTab() {
@@ -566,48 +1926,95 @@ void NativeJIT::runtimePrintNewline() {
     std::cout << std::endl;
 }
 
-long long NativeJIT::runtimeCallUserFunc(const char* name, long long* args, int argCount) {
-    if (!currentJIT) {
-        throw std::runtime_error("No JIT context for runtime call");
-    }
+long long NativeJIT::runtimeConcat(long long left, long long leftType, long long right, long long rightType) {
+    Value result = Value::concatenate(Value::fromBits((ValueType)leftType, left),
+                                      Value::fromBits((ValueType)rightType, right));
+    return currentJIT->toNative(result).bits;
+}
 
-    std::string funcName(name);
+long long NativeJIT::runtimeStringEquals(long long left, long long right) {
+    return left == right ||
+           reinterpret_cast<StringObject*>(left)->str == reinterpret_cast<StringObject*>(right)->str;
+}
 
-    // Try JIT first
-    if (currentJIT->isCompiled(funcName)) {
-        return currentJIT->callCompiled(funcName, args, argCount);
-    }
+NativeResult NativeJIT::runtimeDivide(long long left, long long right, long long modulo) {
+    return guarded([&]() {
+        if (right == 0) throw std::runtime_error(modulo ? "Modulo by zero" : "Division by zero");
+        // By -1: LLONG_MIN / -1 wraps around to itself
+        long long quotient = (long long)(0ULL - (unsigned long long)left);
+        return NativeResult{modulo ? 0 : quotient, (long long)ValueType::INTEGER};
+    });
+}
 
-    // Fallback to interpreter
-    auto it = currentJIT->interpreter->functions.find(funcName);
-    if (it == currentJIT->interpreter->functions.end()) {
-        throw std::runtime_error("Undefined function: " + funcName);
-    }
+void NativeJIT::runtimeStoreGlobal(GlobalTable::Slot* slot, long long bits, long long type) {
+    currentJIT->interpreter->globals.store(*slot, Value::fromBits((ValueType)type, bits));
+}
 
-    FunctionDefNode* funcDef = it->second;
+long long NativeJIT::runtimeDefineFunction(FunctionDefNode* funcDef) {
+    return currentJIT->interpreter->define(funcDef);
+}
 
-    // Save interpreter state
-    std::map<std::string, Value> savedVars = currentJIT->interpreter->variables;
+void NativeJIT::runtimeDeoptSlot(long long index, long long bits, long long type) {
+    std::vector<Value>& slots = currentJIT->deoptSlots;
+    if (slots.size() <= (size_t)index) slots.resize(index + 1);
+    slots[index] = Value::fromBits((ValueType)type, bits);
+}
 
-    // Set up parameters
-    for (size_t i = 0; i < funcDef->params.size(); i++) {
-        if ((int)i < argCount) {
-            currentJIT->interpreter->variables[funcDef->params[i]] = Value(args[i]);
-        } else {
-            currentJIT->interpreter->variables[funcDef->params[i]] = Value();
-        }
-    }
+void NativeJIT::runtimeDeoptReplay(long long bits, long long type) {
+    currentJIT->deoptReplay.push_back(Value::fromBits((ValueType)type, bits));
+}
 
-    // Execute function body
-    Value result;
-    try {
-        currentJIT->interpreter->executeStatement(funcDef->body.get());
-    } catch (const ReturnException& e) {
-        result = e.value;
+NativeResult NativeJIT::runtimeDeopt(long long index) {
+    // The frame is found by the return address, which only this function
+    // has at hand
+    const uint8_t* caller = (const uint8_t*)__builtin_return_address(0);
+    return guarded([&]() { return currentJIT->deopt(caller, index); });
+}
+
+NativeResult NativeJIT::deopt(const uint8_t* caller, long long index) {
+    // Points are numbered from the first one in the code that calls, so
+    // compiled code holds no process-specific numbers
+    size_t base = std::prev(deoptBases.upper_bound(caller))->second;
+
+    // The interpreter may compile (and deoptimize) more code while it
+    // finishes this call, so take everything out first
+    DeoptPoint point = deoptPoints[base + index];
+    std::vector<Value> slots = std::move(deoptSlots);
+    std::vector<Value> replay = std::move(deoptReplay);
+    deoptSlots.clear();
+    deoptReplay.clear();
+    if (!point.exit) invalidate(point);
+
+    Value result = interpreter->resumeFunction(point.func, slots, point.path, replay, point.printed);
+    return toNative(result);
+}
+
+NativeResult NativeJIT::runtimeCallUserFunc(CallTarget* target, long long* args, int argCount) {
+    if (!currentJIT) {
+        throw std::runtime_error("No JIT context for runtime call");
     }
+    return guarded([&]() { return currentJIT->callUserFunc(target, args, argCount); });
+}
 
-    // Restore interpreter state
-    currentJIT->interpreter->variables = savedVars;
+NativeResult NativeJIT::callUserFunc(CallTarget* target, long long* args, int argCount) {
+    // The definition is looked up once, then cached until the name is
+    // redefined
+    if (!target->def) {
+        auto it = interpreter->functions.find(target->name);
+        if (it == interpreter->functions.end()) {
+            throw std::runtime_error("Undefined function: " + target->name.str());
+        }
+        target->def = it->second;
+    }
 
-    return result.asInteger();
+    // Box the arguments; the interpreter takes it from there, native code
+    // included if the callee has some that fits
+    FunctionDefNode* funcDef = target->def;
+    std::vector<Value> argValues;
+    for (size_t i = 0; i < funcDef->params.size(); i++) {
+        argValues.push_back((int)i < argCount ? Value::fromBits((ValueType)target->argTypes[i], args[i])
+                                              : Value());
+    }
+    Value result = interpreter->callFunction(funcDef, argValues);
+    return toNative(result);
 }
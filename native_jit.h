@@ -4,86 +4,340 @@
 #include "ast.h"
 #include "interpreter.h"
 #include "codegen.h"
+#include "code_cache.h"
+#include "jit_cache.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "ir_passes.h"
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <string>
 #include <memory>
+#include <exception>
+#include <csetjmp>
 
-// Compiled function signature: takes args array and count, returns result
-typedef long long (*CompiledFunc)(long long* args, int argCount);
+// What compiled code returns: a value's payload (see Value::bits) and its
+// ValueType, in the two return registers
+struct NativeResult {
+    long long bits;
+    long long type;
+};
 
-// Forward declarations for JIT runtime helpers (extern "C" for name mangling)
-extern "C" void jit_push_arg(long long value);
-extern "C" long long jit_call_func(const char* name);
+// Compiled function signature: takes args array and count, returns result
+typedef NativeResult (*CompiledFunc)(long long* args, int argCount);
 
-class NativeJIT {
+// Compiles functions the interpreter reports as hot (see HotCodeCompiler)
+class NativeJIT : public HotCodeCompiler {
 public:
+    // Call sites targeting one callee with one combination of argument
+    // types. They act as inline caches: each site (and its veneer) is
+    // patched to the callee once it is compiled for exactly those types,
+    // and the stub caches the definition it resolved the name to. Both go
+    // back to the stub when the name is redefined.
+    struct LinkedCallSite {
+        uint8_t* call;
+        uint8_t* veneer;
+    };
+    struct CallTarget {
+        Symbol name;
+        std::vector<IRType> argTypes;
+        std::vector<LinkedCallSite> sites;
+        FunctionDefNode* def = nullptr;
+    };
+
     NativeJIT(Interpreter* interp);
     ~NativeJIT();
 
-    // Execute the program with JIT compilation
+    // Execute the program, compiling functions as they get hot
     void execute(BlockNode* root);
 
+    bool compileHot(FunctionDefNode* funcDef) override;
+    bool callNative(FunctionDefNode* funcDef, std::vector<Value>& args, Value& result) override;
+    bool enterLoop(FunctionDefNode* funcDef, WhileNode* loop, Value* frame, Value& result) override;
+    void functionRedefined(Symbol name) override;
+
+    // Keep compiled functions in a directory, for later runs to load
+    // instead of compiling them again
+    void useDiskCache(const std::string& dir);
+
+    // Ahead of time: compile every function of a program, for the types
+    // assumed before anything is observed, into an image (see aot.h); and
+    // start from such an image. Functions that don't compile are left out,
+    // as is anything in the image that doesn't fit this build.
+    std::vector<uint8_t> precompile(BlockNode* program);
+    void useImage(const uint8_t* image, size_t size);
+
     // Compile a single function to native code
     CompiledFunc compileFunction(FunctionDefNode* func);
 
-    // Call a compiled function
-    long long callCompiled(const std::string& name, long long* args, int argCount);
-
     // Check if function is compiled
-    bool isCompiled(const std::string& name) const;
+    bool isCompiled(Symbol name) const;
 
     // Current JIT instance for runtime callbacks
     static NativeJIT* currentJIT;
 
-    // Runtime helper for calling user functions from JIT code
-    static long long runtimeCallUserFunc(const char* name, long long* args, int argCount);
+    // Runtime helper for calling user functions from JIT code: boxes the
+    // arguments and goes through the interpreter
+    static NativeResult runtimeCallUserFunc(CallTarget* target, long long* args, int argCount);
 
 private:
     Interpreter* interpreter;
     std::unique_ptr<CodeGenerator> codegen;
 
-    // Compiled functions
+    // Compiled functions, specialized for the parameter types the
+    // interpreter observed
     struct CompiledFuncInfo {
         void* code;
         size_t codeSize;
         CompiledFunc func;
+        std::vector<IRType> paramTypes;
+        std::set<Symbol> inlined;   // functions whose bodies it contains
+    };
+    std::unordered_map<Symbol, CompiledFuncInfo> compiledFunctions;
+    std::unordered_map<const FunctionDefNode*, CompiledFuncInfo> entries;  // for callNative
+
+    // On-stack replacement entries by loop; func is null if the loop
+    // can't be compiled. For a loop in a function (owner) the code is
+    // specialized for the types the slots had when it was compiled; a
+    // top-level loop enters the compiled main chunk, which checks the
+    // globals as it reads them.
+    struct LoopEntry {
+        CompiledFunc func = nullptr;
+        FunctionDefNode* owner = nullptr;
+        std::vector<IRType> types;
+        std::set<Symbol> inlined;
+        int deopts = 0;
+    };
+    std::unordered_map<const WhileNode*, LoopEntry> loopEntries;
+
+    // Where compiled code goes back to the interpreter when a guard
+    // fails, or where a main chunk compiled only in part ends: the
+    // function (or main chunk) and the statement to resume at, as
+    // Interpreter::resumeFunction takes them
+    struct DeoptPoint {
+        FunctionDefNode* func;       // null in the main chunk
+        WhileNode* loop;             // the loop, if the code is a loop entry
+        std::vector<ASTNode*> path;
+        size_t printed;
+        void* code;                  // the code containing the guard
+        bool exit;                   // the end of the code, not a failed guard
     };
-    std::map<std::string, CompiledFuncInfo> compiledFunctions;
+    std::vector<DeoptPoint> deoptPoints;
+
+    // Index of the first deopt point of the code starting at each address;
+    // compiled code numbers its points from there
+    std::map<const uint8_t*, size_t> deoptBases;
+    size_t firstDeoptPoint = 0;  // of the code being compiled
+
+    // Frame and replayed call results collected by a deoptimizing guard
+    std::vector<Value> deoptSlots;
+    std::vector<Value> deoptReplay;
+
+    // Strings created or passed on by runtime helpers, kept alive while
+    // compiled code holds bare pointers to them
+    std::vector<Value> nativeTemps;
+    int nativeDepth = 0;
+
+    // Callees referenced from compiled code (node addresses are stable)
+    std::map<std::string, CallTarget> callTargets;
+
+    // Direct calls emitted for the function being compiled
+    struct PendingCall {
+        size_t callOffset;
+        size_t veneerOffset;
+        std::string callee;
+    };
+    std::vector<PendingCall> pendingCalls;
+
+    // Executable memory. Code that is dropped may still be running
+    // further up the stack; it is freed once no compiled code is.
+    CodeCache codeCache;
+    std::vector<void*> retiredCode;
+
+    // Compiled functions saved from earlier runs or ahead of time, and the addresses in the
+    // code being emitted that would have to change to load it elsewhere
+    std::unique_ptr<JitCache> jitCache;
+    std::vector<Relocation> relocations;
 
-    // Memory pages for executable code
-    std::vector<std::pair<void*, size_t>> allocatedPages;
+    // The program being run, whose top level compiles as the main chunk
+    BlockNode* program = nullptr;
 
     // Current function being compiled
-    std::string currentFunction;
-    std::map<std::string, int> localVarMap;
-    int localVarCount;
-    std::set<std::string> functionParams;
+    FunctionDefNode* currentDef = nullptr;
+    // Locals by frame slot (see resolveSlots), parameters first: the
+    // vreg holding each one, and its type
+    std::map<int, int> localVarMap;
+    std::map<int, IRType> localTypes;
+    // The incoming argument array, which tail calls pass theirs in (-1 in
+    // the main chunk, which has none)
+    int argsBase = -1;
+    IRBuilder* builder;
 
-    // Allocate executable memory
-    void* allocateExecutableMemory(size_t size);
+    // Globals: the types reads speculate on, those the code has already
+    // checked or stored since the last call or join point, and the slot of
+    // each one it uses. globalBase holds the address of the table.
+    std::map<Symbol, IRType> globalTypes;
+    std::map<Symbol, IRType> knownGlobals;
+    std::map<Symbol, int> usedGlobals;
+    int globalBase = -1;
 
-    // Collect all local variables used in a function
-    void collectLocals(ASTNode* node, std::set<std::string>& locals);
+    // Statement being compiled, for deoptimization: the chain of nested
+    // statements leading to it, the results of the guarded calls it has
+    // made so far, and how many print arguments it has printed
+    std::vector<ASTNode*> statementPath;
+    std::vector<std::pair<int, IRType>> statementCalls;
+    size_t printedArgs = 0;
 
-    // Compile AST nodes to native code
-    void compileExpression(ASTNode* node);
+    // Function being inlined: where its 'return' goes, and the vreg that
+    // receives the result
+    int inlineExit = -1;
+    int inlineResult = -1;
+    size_t inlinedSize = 0;
+    std::set<Symbol> inlinedCallees;
+
+    // Result types the code being compiled speculates on, by callee
+    std::map<Symbol, IRType> assumedResults;
+
+    // Start of the function body and its parameter types, for self tail
+    // calls
+    int tailEntry = -1;
+    std::vector<IRType> tailParamTypes;
+    WhileNode* osrLoop = nullptr;  // loop whose header gets the entry jump
+    int osrHeader = -1;
+    bool mainChunk = false;        // functions may be defined
+
+    // Drop compiled code, and free what was dropped when that is safe
+    void retire(void* code);
+    void reclaim();
+
+    // Emit veneers for the current function's calls, then register and
+    // patch them once the code has been placed
+    void emitCallVeneers();
+    void linkCalls(uint8_t* code);
+    void patchCallers(const std::string& key, void* entry);
+    void unlinkCallers(CallTarget& target);
+
+    // Loop entry points: the rest of a function's body from a loop header
+    // on, taking the whole interpreter frame as arguments; or as much of
+    // the rest of the program from a top-level loop on as the budget
+    // allows, compiled as an implicit function taking nothing
+    CompiledFunc compileLoopEntry(FunctionDefNode* func, WhileNode* loop, const Value* frame,
+                                  std::vector<IRType>& types);
+    CompiledFunc compileChunk(BlockNode* chunk, WhileNode* loop);
+
+    // Optimize, allocate and emit an IR function into executable memory
+    void* generateCode(IRFunction& ir, size_t& codeSize);
+
+    // Reset the per-function compiler state
+    void beginCompile(FunctionDefNode* func);
+
+    // Number the deopt points of the code just generated from firstDeoptPoint
+    void placeDeoptPoints(void* code);
+
+    // Make a compiled function callable
+    void installFunction(FunctionDefNode* func, const CompiledFuncInfo& info);
+
+    // The on-disk cache: the code just generated is saved, or code saved
+    // earlier placed and linked (null if there is none that fits)
+    static std::string compilerId();
+    void storeCached(FunctionDefNode* func, uint64_t key);
+    CompiledFunc loadCached(FunctionDefNode* func, uint64_t key, const std::vector<IRType>& paramTypes);
+
+    // Static types: locals get one type for the whole function, inferred
+    // from what is assigned to them, starting from the given types
+    void inferTypes(ASTNode* body);
+    int inferType(ASTNode* node);        // an IRType, or -1 if not known yet
+    IRType returnType(Symbol callee);
+    IRType parameterType(uint8_t mask, const std::string& what);
+
+    // Globals are typed by what they hold when the code is compiled, or
+    // else by what it assigns to them
+    void speculateGlobals(ASTNode* body);
+
+    // Translate AST nodes to IR; expressions return the result vreg,
+    // whose static type is in the IR function
+    int compileExpression(ASTNode* node);
+    int compileBinary(BinaryOpNode* node);
+    int compileDivision(IROp op, int left, int right);
+    // A call; with tail set, 'return' of the call, which becomes a jump
+    // when the function calls itself
+    int compileCall(FunctionCallNode* node, bool useResult, bool tail = false);
+
+    // Inlining: a small leaf function the call can be replaced by, and
+    // its body compiled in place (the result vreg, or -1 if it can't be)
+    FunctionDefNode* inlineCandidate(Symbol name);
+    int compileInline(FunctionDefNode* callee, const std::vector<int>& args);
+    int truthy(int vreg);
     void compileStatement(ASTNode* node);
-    void compileBlock(BlockNode* block);
 
-    // Execute a statement (interpreter fallback or JIT)
-    void executeStatement(ASTNode* stmt);
+    // Access to a global slot in place; a read is guarded by the type it
+    // speculates on
+    int compileGlobalLoad(Symbol name, int index);
+    void compileGlobalStore(Symbol name, int index, int value);
+    void declareLocals(IRFunction& ir, ASTNode* body);
+    int emitInitialValue(IRType type);
+
+    // A guard: compiled code continues if ok is true, and otherwise
+    // deoptimizes, handing the interpreter the results of the calls the
+    // statement has made, plus result if there is one
+    void emitGuard(int ok, int result = -1, int resultType = -1);
+    // The deoptimizing path itself; an exit leaves the code in place
+    void emitDeopt(int result, int resultType, bool exit);
+    void emitResultGuard(int result, IRType expected);
+
+    // Drop the compiled code of a function that deoptimized, so callers
+    // go through the interpreter until it is compiled again
+    void invalidate(const DeoptPoint& point);
+    void discard(FunctionDefNode* funcDef);
 
-    // Evaluate expression using JIT for function calls
-    Value evaluateWithJIT(ASTNode* node);
+    // Lower register-allocated IR through the code generator
+    void emitFunction(const IRFunction& func, const RegAllocation& alloc);
 
-    // Runtime helpers (called from generated code)
+    // Hand a value to compiled code, keeping a string alive meanwhile
+    NativeResult toNative(const Value& value);
+
+    // Around running compiled code: what it holds is released once no
+    // compiled code is running any more
+    void enterNative();
+    void leaveNative();
+
+    // Errors can't unwind through compiled code. A runtime helper that
+    // gets one (guarded) jumps back to where compiled code was entered
+    // (runNative), which throws it again; otherwise it returns the result.
+    jmp_buf* nativeExit = nullptr;
+    std::exception_ptr nativeError;
+    Value runNative(CompiledFunc func, long long* args, int argCount);
+    template <typename F> static NativeResult guarded(F body);
+
+    // Runtime helpers (called from generated code), and their names in
+    // the on-disk cache
+    static const std::vector<std::pair<std::string, void*>>& runtimeHelpers();
+    static std::string helperName(void* helper);
+    static void* helperAddress(const std::string& name);
     static void runtimePrintInt(long long value);
-    static void runtimePrintBool(int value);
-    static void runtimePrintString(const char* value);
+    static void runtimePrintBool(long long value);
+    static void runtimePrintString(long long value);
+    static void runtimePrintNil();
     static void runtimePrintTab();
     static void runtimePrintNewline();
+    static long long runtimeConcat(long long left, long long leftType, long long right, long long rightType);
+    static long long runtimeStringEquals(long long left, long long right);
+    static NativeResult runtimeDivide(long long left, long long right, long long modulo);
+    static void runtimeStoreGlobal(GlobalTable::Slot* slot, long long bits, long long type);
+    static long long runtimeDefineFunction(FunctionDefNode* funcDef);
+    static void runtimeDeoptSlot(long long index, long long bits, long long type);
+    static void runtimeDeoptReplay(long long bits, long long type);
+    static NativeResult runtimeDeopt(long long point);
+
+    // What runtimeDeopt and runtimeCallUserFunc do, once errors are guarded
+    NativeResult deopt(const uint8_t* caller, long long point);
+    NativeResult callUserFunc(CallTarget* target, long long* args, int argCount);
 };
 
+// Entry of call veneers whose callee isn't compiled for the argument types
+// at hand: goes through the interpreter
+extern "C" NativeResult jit_call_stub(long long* args, int argCount, NativeJIT::CallTarget* target);
+
 #endif // NATIVE_JIT_H
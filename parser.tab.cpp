@@ -0,0 +1,1837 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison implementation for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* C LALR(1) parser skeleton written by Richard Stallman, by
+   simplifying the original so-called "semantic" parser.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+/* All symbols defined below should begin with yy or YY, to avoid
+   infringing on user name space.  This should be done even for local
+   variables, as they might otherwise be expanded by user macros.
+   There are some unavoidable exceptions within include files to
+   define necessary library symbols; they are noted "INFRINGES ON
+   USER NAME SPACE" below.  */
+
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
+
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
+
+/* Skeleton name.  */
+#define YYSKELETON_NAME "yacc.c"
+
+/* Pure parsers.  */
+#define YYPURE 0
+
+/* Push parsers.  */
+#define YYPUSH 0
+
+/* Pull parsers.  */
+#define YYPULL 1
+
+
+
+
+/* First part of user prologue.  */
+#line 6 "parser.y"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "ast.h"
+
+extern int yylex();
+extern int yylineno;
+void yyerror(const char* s);
+
+BlockNode* programRoot = nullptr;
+Arena* parseArena = nullptr;
+
+// Everything the parser makes lives in the arena
+template <typename T, typename... Args>
+static T* make(Args&&... args) {
+    static_assert(std::is_trivially_destructible<T>::value, "Nodes are never destroyed");
+    return parseArena->make<T>(std::forward<Args>(args)...);
+}
+
+// Lists being parsed: the items of each list are on top of one of these
+// stacks, from the index its nonterminal carries, until the list is
+// complete and copied into the arena. Lists nest, so only the innermost
+// one is ever growing.
+static std::vector<NodeRef> pendingNodes;
+static std::vector<Symbol> pendingSymbols;
+
+template <typename T>
+static ArenaList<T> takeList(std::vector<T>& pending, size_t start) {
+    ArenaList<T> list(pending.data() + start, pending.size() - start);
+    pending.resize(start);
+    return list;
+}
+
+#line 107 "parser.tab.cpp"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "parser.tab.hpp"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_INTEGER = 3,                    /* INTEGER  */
+  YYSYMBOL_BOOLEAN = 4,                    /* BOOLEAN  */
+  YYSYMBOL_STRING = 5,                     /* STRING  */
+  YYSYMBOL_IDENTIFIER = 6,                 /* IDENTIFIER  */
+  YYSYMBOL_FUNCTION = 7,                   /* FUNCTION  */
+  YYSYMBOL_END = 8,                        /* END  */
+  YYSYMBOL_IF = 9,                         /* IF  */
+  YYSYMBOL_THEN = 10,                      /* THEN  */
+  YYSYMBOL_ELSE = 11,                      /* ELSE  */
+  YYSYMBOL_ELSEIF = 12,                    /* ELSEIF  */
+  YYSYMBOL_WHILE = 13,                     /* WHILE  */
+  YYSYMBOL_DO = 14,                        /* DO  */
+  YYSYMBOL_RETURN = 15,                    /* RETURN  */
+  YYSYMBOL_LOCAL = 16,                     /* LOCAL  */
+  YYSYMBOL_TYPE = 17,                      /* TYPE  */
+  YYSYMBOL_PRINT = 18,                     /* PRINT  */
+  YYSYMBOL_EQ = 19,                        /* EQ  */
+  YYSYMBOL_NE = 20,                        /* NE  */
+  YYSYMBOL_LT = 21,                        /* LT  */
+  YYSYMBOL_LE = 22,                        /* LE  */
+  YYSYMBOL_GT = 23,                        /* GT  */
+  YYSYMBOL_GE = 24,                        /* GE  */
+  YYSYMBOL_AND = 25,                       /* AND  */
+  YYSYMBOL_OR = 26,                        /* OR  */
+  YYSYMBOL_NOT = 27,                       /* NOT  */
+  YYSYMBOL_28_ = 28,                       /* '+'  */
+  YYSYMBOL_29_ = 29,                       /* '-'  */
+  YYSYMBOL_30_ = 30,                       /* '*'  */
+  YYSYMBOL_31_ = 31,                       /* '/'  */
+  YYSYMBOL_32_ = 32,                       /* '%'  */
+  YYSYMBOL_UNARY = 33,                     /* UNARY  */
+  YYSYMBOL_34_ = 34,                       /* '('  */
+  YYSYMBOL_35_ = 35,                       /* ')'  */
+  YYSYMBOL_36_ = 36,                       /* '='  */
+  YYSYMBOL_37_ = 37,                       /* ':'  */
+  YYSYMBOL_38_ = 38,                       /* ','  */
+  YYSYMBOL_YYACCEPT = 39,                  /* $accept  */
+  YYSYMBOL_program = 40,                   /* program  */
+  YYSYMBOL_statement_list = 41,            /* statement_list  */
+  YYSYMBOL_statement = 42,                 /* statement  */
+  YYSYMBOL_assignment = 43,                /* assignment  */
+  YYSYMBOL_opt_type_annotation = 44,       /* opt_type_annotation  */
+  YYSYMBOL_type_annotation = 45,           /* type_annotation  */
+  YYSYMBOL_function_def = 46,              /* function_def  */
+  YYSYMBOL_param_list = 47,                /* param_list  */
+  YYSYMBOL_param_list_items = 48,          /* param_list_items  */
+  YYSYMBOL_function_call = 49,             /* function_call  */
+  YYSYMBOL_arg_list = 50,                  /* arg_list  */
+  YYSYMBOL_arg_list_items = 51,            /* arg_list_items  */
+  YYSYMBOL_if_stmt = 52,                   /* if_stmt  */
+  YYSYMBOL_while_stmt = 53,                /* while_stmt  */
+  YYSYMBOL_block = 54,                     /* block  */
+  YYSYMBOL_return_stmt = 55,               /* return_stmt  */
+  YYSYMBOL_expression = 56,                /* expression  */
+  YYSYMBOL_logical_or_expr = 57,           /* logical_or_expr  */
+  YYSYMBOL_logical_and_expr = 58,          /* logical_and_expr  */
+  YYSYMBOL_comparison_expr = 59,           /* comparison_expr  */
+  YYSYMBOL_additive_expr = 60,             /* additive_expr  */
+  YYSYMBOL_multiplicative_expr = 61,       /* multiplicative_expr  */
+  YYSYMBOL_unary_expr = 62,                /* unary_expr  */
+  YYSYMBOL_primary_expr = 63               /* primary_expr  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
+
+
+
+#ifdef short
+# undef short
+#endif
+
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
+
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
+#else
+typedef short yytype_uint8;
+#endif
+
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
+#else
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
+#endif
+
+#ifndef YYSIZE_T
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
+#endif
+
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_int8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
+#endif
+
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
+#endif
+
+/* Suppress unused-variable warnings by "using" E.  */
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
+#else
+# define YY_USE(E) /* empty */
+#endif
+
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
+#else
+# define YY_INITIAL_VALUE(Value) Value
+#endif
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if !defined yyoverflow
+
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
+
+# ifdef YYSTACK_USE_ALLOCA
+#  if YYSTACK_USE_ALLOCA
+#   ifdef __GNUC__
+#    define YYSTACK_ALLOC __builtin_alloca
+#   elif defined __BUILTIN_VA_ARG_INCR
+#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
+#   elif defined _AIX
+#    define YYSTACK_ALLOC __alloca
+#   elif defined _MSC_VER
+#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
+#    define alloca _alloca
+#   else
+#    define YYSTACK_ALLOC alloca
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
+#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
+#     endif
+#    endif
+#   endif
+#  endif
+# endif
+
+# ifdef YYSTACK_ALLOC
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
+# else
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
+#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+# endif
+#endif /* !defined yyoverflow */
+
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+
+/* A type that is properly aligned for any stack member.  */
+union yyalloc
+{
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
+
+/* The size of the maximum gap between one aligned stack and the next.  */
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
+
+/* The size of an array large to enough to hold all stacks, each with
+   N elements.  */
+# define YYSTACK_BYTES(N) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
+      + YYSTACK_GAP_MAXIMUM)
+
+# define YYCOPY_NEEDED 1
+
+/* Relocate STACK from its old location to the new one.  The
+   local variables YYSIZE and YYSTACKSIZE give the old and new number of
+   elements in the stack, and YYPTR gives the new location of the
+   stack.  Advance YYPTR to a properly aligned location for the next
+   stack.  */
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
+
+#endif
+
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
+
+/* YYFINAL -- State number of the termination state.  */
+#define YYFINAL  3
+/* YYLAST -- Last index in YYTABLE.  */
+#define YYLAST   85
+
+/* YYNTOKENS -- Number of terminals.  */
+#define YYNTOKENS  39
+/* YYNNTS -- Number of nonterminals.  */
+#define YYNNTS  25
+/* YYNRULES -- Number of rules.  */
+#define YYNRULES  60
+/* YYNSTATES -- Number of states.  */
+#define YYNSTATES  108
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   283
+
+
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
+{
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,    32,     2,     2,
+      34,    35,    30,    28,    38,    29,     2,    31,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,    37,     2,
+       2,    36,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
+       5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    33
+};
+
+#if YYDEBUG
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
+{
+       0,    78,    78,    82,    83,    90,    91,    92,    93,    94,
+      95,    96,   102,   105,   111,   112,   116,   120,   126,   127,
+     131,   135,   142,   148,   149,   153,   157,   164,   167,   173,
+     179,   183,   186,   192,   196,   197,   203,   204,   210,   211,
+     214,   217,   220,   223,   226,   232,   233,   236,   242,   243,
+     246,   249,   255,   256,   259,   265,   266,   267,   268,   269,
+     270
+};
+#endif
+
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
+/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
+static const char *const yytname[] =
+{
+  "\"end of file\"", "error", "\"invalid token\"", "INTEGER", "BOOLEAN",
+  "STRING", "IDENTIFIER", "FUNCTION", "END", "IF", "THEN", "ELSE",
+  "ELSEIF", "WHILE", "DO", "RETURN", "LOCAL", "TYPE", "PRINT", "EQ", "NE",
+  "LT", "LE", "GT", "GE", "AND", "OR", "NOT", "'+'", "'-'", "'*'", "'/'",
+  "'%'", "UNARY", "'('", "')'", "'='", "':'", "','", "$accept", "program",
+  "statement_list", "statement", "assignment", "opt_type_annotation",
+  "type_annotation", "function_def", "param_list", "param_list_items",
+  "function_call", "arg_list", "arg_list_items", "if_stmt", "while_stmt",
+  "block", "return_stmt", "expression", "logical_or_expr",
+  "logical_and_expr", "comparison_expr", "additive_expr",
+  "multiplicative_expr", "unary_expr", "primary_expr", YY_NULLPTR
+};
+
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
+{
+  return yytname[yysymbol];
+}
+#endif
+
+#define YYPACT_NINF (-65)
+
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
+
+#define YYTABLE_NINF (-1)
+
+#define yytable_value_is_error(Yyn) \
+  0
+
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int8 yypact[] =
+{
+     -65,     6,    43,   -65,    21,    14,    19,    19,    19,    23,
+      13,   -65,   -65,   -65,   -65,   -65,   -65,   -65,    19,    19,
+      17,   -65,   -65,   -65,    20,    19,    19,    19,   -65,    50,
+       4,    38,    -5,    12,    -4,   -65,   -65,    51,   -65,    27,
+      19,    31,    29,   -65,   -65,    62,   -65,   -65,    34,   -65,
+      19,    19,    19,    19,    19,    19,    19,    19,    19,    19,
+      19,    19,    19,   -65,    64,    35,    37,   -65,    19,    27,
+      40,    39,   -65,    43,    -1,    38,    -5,    12,    12,    12,
+      12,    12,    12,    -4,    -4,   -65,   -65,   -65,    65,   -65,
+     -65,    19,   -65,   -65,   -65,    27,    70,   -65,   -65,   -65,
+     -65,   -65,    27,    71,    72,   -65,   -65,   -65
+};
+
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
+{
+       3,     0,     2,     1,     0,     0,     0,     0,    32,     0,
+       0,     4,     5,     6,     7,     8,     9,    10,    23,     0,
+       0,    55,    56,    57,    58,     0,     0,     0,    59,     0,
+      33,    34,    36,    38,    45,    48,    52,     0,    31,    14,
+      23,     0,    24,    25,    13,    18,    53,    54,     0,     3,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     3,     0,     0,     0,    22,     0,    14,
+       0,    19,    60,    30,     0,    35,    37,    39,    40,    41,
+      42,    43,    44,    46,    47,    49,    50,    51,     0,    16,
+      15,     0,    11,    26,    20,    14,     0,    27,     3,    29,
+      12,     3,    14,     0,     0,    21,    28,    17
+};
+
+/* YYPGOTO[NTERM-NUM].  */
+static const yytype_int8 yypgoto[] =
+{
+     -65,   -65,    78,   -65,   -65,   -64,   -65,   -65,   -65,   -65,
+       1,    41,   -65,   -65,   -65,   -59,   -65,    -6,   -65,    32,
+      33,   -20,   -47,   -17,   -65
+};
+
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_int8 yydefgoto[] =
+{
+       0,     1,    73,    11,    12,    65,    90,    13,    70,    71,
+      28,    41,    42,    15,    16,    74,    17,    43,    30,    31,
+      32,    33,    34,    35,    36
+};
+
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_int8 yytable[] =
+{
+      29,    37,    38,    14,    88,    94,     3,    97,    46,    47,
+      98,    83,    84,    44,    52,    53,    54,    55,    56,    57,
+      20,    48,    21,    22,    23,    24,    60,    61,    62,    39,
+      50,   101,    77,    78,    79,    80,    81,    82,   105,   103,
+      58,    59,   104,    85,    86,    87,    25,    40,    26,     4,
+       5,    45,     6,    27,    18,    18,     7,    19,     8,     9,
+      49,    10,    93,    51,    64,    63,    67,    68,    69,    72,
+      89,    91,    92,    99,    14,    95,   102,    96,     2,   106,
+     107,    66,    75,     0,    76,   100
+};
+
+static const yytype_int8 yycheck[] =
+{
+       6,     7,     8,     2,    63,    69,     0,     8,    25,    26,
+      11,    58,    59,    19,    19,    20,    21,    22,    23,    24,
+       6,    27,     3,     4,     5,     6,    30,    31,    32,     6,
+      26,    95,    52,    53,    54,    55,    56,    57,   102,    98,
+      28,    29,   101,    60,    61,    62,    27,    34,    29,     6,
+       7,    34,     9,    34,    34,    34,    13,    36,    15,    16,
+      10,    18,    68,    25,    37,    14,    35,    38,     6,    35,
+       6,    36,    35,     8,    73,    35,     6,    38,     0,     8,
+       8,    40,    50,    -1,    51,    91
+};
+
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
+{
+       0,    40,    41,     0,     6,     7,     9,    13,    15,    16,
+      18,    42,    43,    46,    49,    52,    53,    55,    34,    36,
+       6,     3,     4,     5,     6,    27,    29,    34,    49,    56,
+      57,    58,    59,    60,    61,    62,    63,    56,    56,     6,
+      34,    50,    51,    56,    56,    34,    62,    62,    56,    10,
+      26,    25,    19,    20,    21,    22,    23,    24,    28,    29,
+      30,    31,    32,    14,    37,    44,    50,    35,    38,     6,
+      47,    48,    35,    41,    54,    58,    59,    60,    60,    60,
+      60,    60,    60,    61,    61,    62,    62,    62,    54,     6,
+      45,    36,    35,    56,    44,    35,    38,     8,    11,     8,
+      56,    44,     6,    54,    54,    44,     8,     8
+};
+
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    39,    40,    41,    41,    42,    42,    42,    42,    42,
+      42,    42,    43,    43,    44,    44,    45,    46,    47,    47,
+      48,    48,    49,    50,    50,    51,    51,    52,    52,    53,
+      54,    55,    55,    56,    57,    57,    58,    58,    59,    59,
+      59,    59,    59,    59,    59,    60,    60,    60,    61,    61,
+      61,    61,    62,    62,    62,    63,    63,    63,    63,    63,
+      63
+};
+
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     1,     0,     2,     1,     1,     1,     1,     1,
+       1,     4,     5,     3,     0,     2,     1,     8,     0,     1,
+       2,     4,     4,     0,     1,     1,     3,     5,     7,     5,
+       1,     2,     1,     1,     1,     3,     1,     3,     1,     3,
+       3,     3,     3,     3,     3,     1,     3,     3,     1,     3,
+       3,     3,     1,     2,     2,     1,     1,     1,     1,     1,
+       3
+};
+
+
+enum { YYENOMEM = -2 };
+
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
+
+
+#define YYRECOVERING()  (!!yyerrstatus)
+
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
+
+
+/* Enable debugging if requested.  */
+#if YYDEBUG
+
+# ifndef YYFPRINTF
+#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYFPRINTF fprintf
+# endif
+
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
+
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+{
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  if (!yyvaluep)
+    return;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
+
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
+
+  yy_symbol_value_print (yyo, yykind, yyvaluep);
+  YYFPRINTF (yyo, ")");
+}
+
+/*------------------------------------------------------------------.
+| yy_stack_print -- Print the state stack from its BOTTOM up to its |
+| TOP (included).                                                   |
+`------------------------------------------------------------------*/
+
+static void
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
+{
+  YYFPRINTF (stderr, "Stack now");
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
+  YYFPRINTF (stderr, "\n");
+}
+
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
+
+
+/*------------------------------------------------.
+| Report that the YYRULE is going to be reduced.  |
+`------------------------------------------------*/
+
+static void
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule)
+{
+  int yylno = yyrline[yyrule];
+  int yynrhs = yyr2[yyrule];
+  int yyi;
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
+  /* The symbols being reduced.  */
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)]);
+      YYFPRINTF (stderr, "\n");
+    }
+}
+
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule); \
+} while (0)
+
+/* Nonzero means print parse trace.  It is left uninitialized so that
+   multiple parsers can coexist.  */
+int yydebug;
+#else /* !YYDEBUG */
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
+# define YY_STACK_PRINT(Bottom, Top)
+# define YY_REDUCE_PRINT(Rule)
+#endif /* !YYDEBUG */
+
+
+/* YYINITDEPTH -- initial size of the parser's stacks.  */
+#ifndef YYINITDEPTH
+# define YYINITDEPTH 200
+#endif
+
+/* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
+   if the built-in stack extension method is used).
+
+   Do not make this value too large; the results are undefined if
+   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
+   evaluated with infinite-precision integer arithmetic.  */
+
+#ifndef YYMAXDEPTH
+# define YYMAXDEPTH 10000
+#endif
+
+
+
+
+
+
+/*-----------------------------------------------.
+| Release the memory associated to this symbol.  |
+`-----------------------------------------------*/
+
+static void
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep)
+{
+  YY_USE (yyvaluep);
+  if (!yymsg)
+    yymsg = "Deleting";
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/* Lookahead token kind.  */
+int yychar;
+
+/* The semantic value of the lookahead symbol.  */
+YYSTYPE yylval;
+/* Number of syntax errors so far.  */
+int yynerrs;
+
+
+
+
+/*----------.
+| yyparse.  |
+`----------*/
+
+int
+yyparse (void)
+{
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
+
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
+
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
+
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
+
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
+  /* The variables used to return semantic value and location from the
+     action routines.  */
+  YYSTYPE yyval;
+
+
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+
+  /* The number of symbols on the RHS of the reduced rule.
+     Keep to zero when no symbol should be popped.  */
+  int yylen = 0;
+
+  YYDPRINTF ((stderr, "Starting parse\n"));
+
+  yychar = YYEMPTY; /* Cause a token to be read.  */
+
+  goto yysetstate;
+
+
+/*------------------------------------------------------------.
+| yynewstate -- push a new state, which is found in yystate.  |
+`------------------------------------------------------------*/
+yynewstate:
+  /* In all cases, when you get here, the value and location stacks
+     have just been pushed.  So pushing a state here evens the stacks.  */
+  yyssp++;
+
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
+
+  if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
+    {
+      /* Get the current used size of the three stacks, in elements.  */
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
+
+# if defined yyoverflow
+      {
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
+      }
+# else /* defined YYSTACK_RELOCATE */
+      /* Extend the stack our own way.  */
+      if (YYMAXDEPTH <= yystacksize)
+        YYNOMEM;
+      yystacksize *= 2;
+      if (YYMAXDEPTH < yystacksize)
+        yystacksize = YYMAXDEPTH;
+
+      {
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+#  undef YYSTACK_RELOCATE
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
+      }
+# endif
+
+      yyssp = yyss + yysize - 1;
+      yyvsp = yyvs + yysize - 1;
+
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
+
+      if (yyss + yystacksize - 1 <= yyssp)
+        YYABORT;
+    }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
+
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
+
+  goto yybackup;
+
+
+/*-----------.
+| yybackup.  |
+`-----------*/
+yybackup:
+  /* Do appropriate processing given the current state.  Read a
+     lookahead token if we need one and don't already have one.  */
+
+  /* First try to decide what to do without reference to lookahead token.  */
+  yyn = yypact[yystate];
+  if (yypact_value_is_default (yyn))
+    goto yydefault;
+
+  /* Not known => get a lookahead token if don't already have one.  */
+
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == YYEMPTY)
+    {
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex ();
+    }
+
+  if (yychar <= YYEOF)
+    {
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
+      YYDPRINTF ((stderr, "Now at end of input.\n"));
+    }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
+  else
+    {
+      yytoken = YYTRANSLATE (yychar);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+    }
+
+  /* If the proper action on seeing token YYTOKEN is to reduce or to
+     detect an error, take that action.  */
+  yyn += yytoken;
+  if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
+    goto yydefault;
+  yyn = yytable[yyn];
+  if (yyn <= 0)
+    {
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
+      yyn = -yyn;
+      goto yyreduce;
+    }
+
+  /* Count tokens shifted since error; after three, turn off error
+     status.  */
+  if (yyerrstatus)
+    yyerrstatus--;
+
+  /* Shift the lookahead token.  */
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
+  yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
+  goto yynewstate;
+
+
+/*-----------------------------------------------------------.
+| yydefault -- do the default action for the current state.  |
+`-----------------------------------------------------------*/
+yydefault:
+  yyn = yydefact[yystate];
+  if (yyn == 0)
+    goto yyerrlab;
+  goto yyreduce;
+
+
+/*-----------------------------.
+| yyreduce -- do a reduction.  |
+`-----------------------------*/
+yyreduce:
+  /* yyn is the number of a rule to reduce with.  */
+  yylen = yyr2[yyn];
+
+  /* If YYLEN is nonzero, implement the default value of the action:
+     '$$ = $1'.
+
+     Otherwise, the following line sets YYVAL to garbage.
+     This behavior is undocumented and Bison
+     users should not rely upon it.  Assigning to YYVAL
+     unconditionally makes the parser a bit smaller, and it avoids a
+     GCC warning that YYVAL may be used uninitialized.  */
+  yyval = yyvsp[1-yylen];
+
+
+  YY_REDUCE_PRINT (yyn);
+  switch (yyn)
+    {
+  case 2: /* program: statement_list  */
+#line 78 "parser.y"
+                   { programRoot = make<BlockNode>(takeList(pendingNodes, (yyvsp[0].list))); (yyval.block) = programRoot; }
+#line 1223 "parser.tab.cpp"
+    break;
+
+  case 3: /* statement_list: %empty  */
+#line 82 "parser.y"
+                { (yyval.list) = pendingNodes.size(); }
+#line 1229 "parser.tab.cpp"
+    break;
+
+  case 4: /* statement_list: statement_list statement  */
+#line 83 "parser.y"
+                               {
+        (yyval.list) = (yyvsp[-1].list);
+        if ((yyvsp[0].node)) pendingNodes.push_back((yyvsp[0].node));
+    }
+#line 1238 "parser.tab.cpp"
+    break;
+
+  case 5: /* statement: assignment  */
+#line 90 "parser.y"
+               { (yyval.node) = (yyvsp[0].node); }
+#line 1244 "parser.tab.cpp"
+    break;
+
+  case 6: /* statement: function_def  */
+#line 91 "parser.y"
+                   { (yyval.node) = (yyvsp[0].node); }
+#line 1250 "parser.tab.cpp"
+    break;
+
+  case 7: /* statement: function_call  */
+#line 92 "parser.y"
+                    { (yyval.node) = (yyvsp[0].node); }
+#line 1256 "parser.tab.cpp"
+    break;
+
+  case 8: /* statement: if_stmt  */
+#line 93 "parser.y"
+              { (yyval.node) = (yyvsp[0].node); }
+#line 1262 "parser.tab.cpp"
+    break;
+
+  case 9: /* statement: while_stmt  */
+#line 94 "parser.y"
+                 { (yyval.node) = (yyvsp[0].node); }
+#line 1268 "parser.tab.cpp"
+    break;
+
+  case 10: /* statement: return_stmt  */
+#line 95 "parser.y"
+                  { (yyval.node) = (yyvsp[0].node); }
+#line 1274 "parser.tab.cpp"
+    break;
+
+  case 11: /* statement: PRINT '(' arg_list ')'  */
+#line 96 "parser.y"
+                             {
+        (yyval.node) = make<PrintNode>(takeList(pendingNodes, (yyvsp[-1].list)));
+    }
+#line 1282 "parser.tab.cpp"
+    break;
+
+  case 12: /* assignment: LOCAL IDENTIFIER opt_type_annotation '=' expression  */
+#line 102 "parser.y"
+                                                        {
+        (yyval.node) = make<AssignmentNode>((yyvsp[-3].sym), (yyvsp[0].node), (yyvsp[-2].sym), true);
+    }
+#line 1290 "parser.tab.cpp"
+    break;
+
+  case 13: /* assignment: IDENTIFIER '=' expression  */
+#line 105 "parser.y"
+                                {
+        (yyval.node) = make<AssignmentNode>((yyvsp[-2].sym), (yyvsp[0].node));
+    }
+#line 1298 "parser.tab.cpp"
+    break;
+
+  case 14: /* opt_type_annotation: %empty  */
+#line 111 "parser.y"
+                { (yyval.sym) = Symbol(); }
+#line 1304 "parser.tab.cpp"
+    break;
+
+  case 15: /* opt_type_annotation: ':' type_annotation  */
+#line 112 "parser.y"
+                          { (yyval.sym) = (yyvsp[0].sym); }
+#line 1310 "parser.tab.cpp"
+    break;
+
+  case 16: /* type_annotation: IDENTIFIER  */
+#line 116 "parser.y"
+               { (yyval.sym) = (yyvsp[0].sym); }
+#line 1316 "parser.tab.cpp"
+    break;
+
+  case 17: /* function_def: FUNCTION IDENTIFIER '(' param_list ')' opt_type_annotation block END  */
+#line 120 "parser.y"
+                                                                         {
+        (yyval.node) = make<FunctionDefNode>((yyvsp[-6].sym), takeList(pendingSymbols, (yyvsp[-4].list)), (yyvsp[-1].block), (yyvsp[-2].sym));
+    }
+#line 1324 "parser.tab.cpp"
+    break;
+
+  case 18: /* param_list: %empty  */
+#line 126 "parser.y"
+                { (yyval.list) = pendingSymbols.size(); }
+#line 1330 "parser.tab.cpp"
+    break;
+
+  case 19: /* param_list: param_list_items  */
+#line 127 "parser.y"
+                       { (yyval.list) = (yyvsp[0].list); }
+#line 1336 "parser.tab.cpp"
+    break;
+
+  case 20: /* param_list_items: IDENTIFIER opt_type_annotation  */
+#line 131 "parser.y"
+                                   {
+        (yyval.list) = pendingSymbols.size();
+        pendingSymbols.push_back((yyvsp[-1].sym));
+    }
+#line 1345 "parser.tab.cpp"
+    break;
+
+  case 21: /* param_list_items: param_list_items ',' IDENTIFIER opt_type_annotation  */
+#line 135 "parser.y"
+                                                          {
+        (yyval.list) = (yyvsp[-3].list);
+        pendingSymbols.push_back((yyvsp[-1].sym));
+    }
+#line 1354 "parser.tab.cpp"
+    break;
+
+  case 22: /* function_call: IDENTIFIER '(' arg_list ')'  */
+#line 142 "parser.y"
+                                {
+        (yyval.node) = make<FunctionCallNode>((yyvsp[-3].sym), takeList(pendingNodes, (yyvsp[-1].list)));
+    }
+#line 1362 "parser.tab.cpp"
+    break;
+
+  case 23: /* arg_list: %empty  */
+#line 148 "parser.y"
+                { (yyval.list) = pendingNodes.size(); }
+#line 1368 "parser.tab.cpp"
+    break;
+
+  case 24: /* arg_list: arg_list_items  */
+#line 149 "parser.y"
+                     { (yyval.list) = (yyvsp[0].list); }
+#line 1374 "parser.tab.cpp"
+    break;
+
+  case 25: /* arg_list_items: expression  */
+#line 153 "parser.y"
+               {
+        (yyval.list) = pendingNodes.size();
+        pendingNodes.push_back((yyvsp[0].node));
+    }
+#line 1383 "parser.tab.cpp"
+    break;
+
+  case 26: /* arg_list_items: arg_list_items ',' expression  */
+#line 157 "parser.y"
+                                    {
+        (yyval.list) = (yyvsp[-2].list);
+        pendingNodes.push_back((yyvsp[0].node));
+    }
+#line 1392 "parser.tab.cpp"
+    break;
+
+  case 27: /* if_stmt: IF expression THEN block END  */
+#line 164 "parser.y"
+                                 {
+        (yyval.node) = make<IfNode>((yyvsp[-3].node), (yyvsp[-1].block));
+    }
+#line 1400 "parser.tab.cpp"
+    break;
+
+  case 28: /* if_stmt: IF expression THEN block ELSE block END  */
+#line 167 "parser.y"
+                                              {
+        (yyval.node) = make<IfNode>((yyvsp[-5].node), (yyvsp[-3].block), (yyvsp[-1].block));
+    }
+#line 1408 "parser.tab.cpp"
+    break;
+
+  case 29: /* while_stmt: WHILE expression DO block END  */
+#line 173 "parser.y"
+                                  {
+        (yyval.node) = make<WhileNode>((yyvsp[-3].node), (yyvsp[-1].block));
+    }
+#line 1416 "parser.tab.cpp"
+    break;
+
+  case 30: /* block: statement_list  */
+#line 179 "parser.y"
+                   { (yyval.block) = make<BlockNode>(takeList(pendingNodes, (yyvsp[0].list))); }
+#line 1422 "parser.tab.cpp"
+    break;
+
+  case 31: /* return_stmt: RETURN expression  */
+#line 183 "parser.y"
+                      {
+        (yyval.node) = make<ReturnNode>((yyvsp[0].node));
+    }
+#line 1430 "parser.tab.cpp"
+    break;
+
+  case 32: /* return_stmt: RETURN  */
+#line 186 "parser.y"
+             {
+        (yyval.node) = make<ReturnNode>(nullptr);
+    }
+#line 1438 "parser.tab.cpp"
+    break;
+
+  case 33: /* expression: logical_or_expr  */
+#line 192 "parser.y"
+                    { (yyval.node) = (yyvsp[0].node); }
+#line 1444 "parser.tab.cpp"
+    break;
+
+  case 34: /* logical_or_expr: logical_and_expr  */
+#line 196 "parser.y"
+                     { (yyval.node) = (yyvsp[0].node); }
+#line 1450 "parser.tab.cpp"
+    break;
+
+  case 35: /* logical_or_expr: logical_or_expr OR logical_and_expr  */
+#line 197 "parser.y"
+                                          {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::OR, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1458 "parser.tab.cpp"
+    break;
+
+  case 36: /* logical_and_expr: comparison_expr  */
+#line 203 "parser.y"
+                    { (yyval.node) = (yyvsp[0].node); }
+#line 1464 "parser.tab.cpp"
+    break;
+
+  case 37: /* logical_and_expr: logical_and_expr AND comparison_expr  */
+#line 204 "parser.y"
+                                           {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::AND, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1472 "parser.tab.cpp"
+    break;
+
+  case 38: /* comparison_expr: additive_expr  */
+#line 210 "parser.y"
+                  { (yyval.node) = (yyvsp[0].node); }
+#line 1478 "parser.tab.cpp"
+    break;
+
+  case 39: /* comparison_expr: comparison_expr EQ additive_expr  */
+#line 211 "parser.y"
+                                       {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::EQ, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1486 "parser.tab.cpp"
+    break;
+
+  case 40: /* comparison_expr: comparison_expr NE additive_expr  */
+#line 214 "parser.y"
+                                       {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::NE, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1494 "parser.tab.cpp"
+    break;
+
+  case 41: /* comparison_expr: comparison_expr LT additive_expr  */
+#line 217 "parser.y"
+                                       {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::LT, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1502 "parser.tab.cpp"
+    break;
+
+  case 42: /* comparison_expr: comparison_expr LE additive_expr  */
+#line 220 "parser.y"
+                                       {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::LE, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1510 "parser.tab.cpp"
+    break;
+
+  case 43: /* comparison_expr: comparison_expr GT additive_expr  */
+#line 223 "parser.y"
+                                       {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::GT, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1518 "parser.tab.cpp"
+    break;
+
+  case 44: /* comparison_expr: comparison_expr GE additive_expr  */
+#line 226 "parser.y"
+                                       {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::GE, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1526 "parser.tab.cpp"
+    break;
+
+  case 45: /* additive_expr: multiplicative_expr  */
+#line 232 "parser.y"
+                        { (yyval.node) = (yyvsp[0].node); }
+#line 1532 "parser.tab.cpp"
+    break;
+
+  case 46: /* additive_expr: additive_expr '+' multiplicative_expr  */
+#line 233 "parser.y"
+                                            {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::ADD, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1540 "parser.tab.cpp"
+    break;
+
+  case 47: /* additive_expr: additive_expr '-' multiplicative_expr  */
+#line 236 "parser.y"
+                                            {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::SUB, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1548 "parser.tab.cpp"
+    break;
+
+  case 48: /* multiplicative_expr: unary_expr  */
+#line 242 "parser.y"
+               { (yyval.node) = (yyvsp[0].node); }
+#line 1554 "parser.tab.cpp"
+    break;
+
+  case 49: /* multiplicative_expr: multiplicative_expr '*' unary_expr  */
+#line 243 "parser.y"
+                                         {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::MUL, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1562 "parser.tab.cpp"
+    break;
+
+  case 50: /* multiplicative_expr: multiplicative_expr '/' unary_expr  */
+#line 246 "parser.y"
+                                         {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::DIV, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1570 "parser.tab.cpp"
+    break;
+
+  case 51: /* multiplicative_expr: multiplicative_expr '%' unary_expr  */
+#line 249 "parser.y"
+                                         {
+        (yyval.node) = make<BinaryOpNode>(BinaryOpType::MOD, (yyvsp[-2].node), (yyvsp[0].node));
+    }
+#line 1578 "parser.tab.cpp"
+    break;
+
+  case 52: /* unary_expr: primary_expr  */
+#line 255 "parser.y"
+                 { (yyval.node) = (yyvsp[0].node); }
+#line 1584 "parser.tab.cpp"
+    break;
+
+  case 53: /* unary_expr: NOT unary_expr  */
+#line 256 "parser.y"
+                     {
+        (yyval.node) = make<UnaryOpNode>(UnaryOpType::NOT, (yyvsp[0].node));
+    }
+#line 1592 "parser.tab.cpp"
+    break;
+
+  case 54: /* unary_expr: '-' unary_expr  */
+#line 259 "parser.y"
+                                 {
+        (yyval.node) = make<UnaryOpNode>(UnaryOpType::NEG, (yyvsp[0].node));
+    }
+#line 1600 "parser.tab.cpp"
+    break;
+
+  case 55: /* primary_expr: INTEGER  */
+#line 265 "parser.y"
+            { (yyval.node) = make<IntegerNode>((yyvsp[0].ival)); }
+#line 1606 "parser.tab.cpp"
+    break;
+
+  case 56: /* primary_expr: BOOLEAN  */
+#line 266 "parser.y"
+              { (yyval.node) = make<BooleanNode>((yyvsp[0].bval)); }
+#line 1612 "parser.tab.cpp"
+    break;
+
+  case 57: /* primary_expr: STRING  */
+#line 267 "parser.y"
+             { (yyval.node) = make<StringNode>((yyvsp[0].sval).str()); }
+#line 1618 "parser.tab.cpp"
+    break;
+
+  case 58: /* primary_expr: IDENTIFIER  */
+#line 268 "parser.y"
+                 { (yyval.node) = make<VariableNode>((yyvsp[0].sym)); }
+#line 1624 "parser.tab.cpp"
+    break;
+
+  case 59: /* primary_expr: function_call  */
+#line 269 "parser.y"
+                    { (yyval.node) = (yyvsp[0].node); }
+#line 1630 "parser.tab.cpp"
+    break;
+
+  case 60: /* primary_expr: '(' expression ')'  */
+#line 270 "parser.y"
+                         { (yyval.node) = (yyvsp[-1].node); }
+#line 1636 "parser.tab.cpp"
+    break;
+
+
+#line 1640 "parser.tab.cpp"
+
+      default: break;
+    }
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
+
+  YYPOPSTACK (yylen);
+  yylen = 0;
+
+  *++yyvsp = yyval;
+
+  /* Now 'shift' the result of the reduction.  Determine what state
+     that goes to, based on the state we popped back to and the rule
+     number reduced by.  */
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
+
+  goto yynewstate;
+
+
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
+yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
+  /* If not already recovering from an error, report this error.  */
+  if (!yyerrstatus)
+    {
+      ++yynerrs;
+      yyerror (YY_("syntax error"));
+    }
+
+  if (yyerrstatus == 3)
+    {
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
+
+      if (yychar <= YYEOF)
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval);
+          yychar = YYEMPTY;
+        }
+    }
+
+  /* Else will try to reuse lookahead token after shifting the error
+     token.  */
+  goto yyerrlab1;
+
+
+/*---------------------------------------------------.
+| yyerrorlab -- error raised explicitly by YYERROR.  |
+`---------------------------------------------------*/
+yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
+
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYERROR.  */
+  YYPOPSTACK (yylen);
+  yylen = 0;
+  YY_STACK_PRINT (yyss, yyssp);
+  yystate = *yyssp;
+  goto yyerrlab1;
+
+
+/*-------------------------------------------------------------.
+| yyerrlab1 -- common code for both syntax error and YYERROR.  |
+`-------------------------------------------------------------*/
+yyerrlab1:
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
+
+  /* Pop stack until we find a state that shifts the error token.  */
+  for (;;)
+    {
+      yyn = yypact[yystate];
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
+
+      /* Pop the current state because it cannot handle the error token.  */
+      if (yyssp == yyss)
+        YYABORT;
+
+
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
+      YY_STACK_PRINT (yyss, yyssp);
+    }
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+
+  /* Shift the error token.  */
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
+
+  yystate = yyn;
+  goto yynewstate;
+
+
+/*-------------------------------------.
+| yyacceptlab -- YYACCEPT comes here.  |
+`-------------------------------------*/
+yyacceptlab:
+  yyresult = 0;
+  goto yyreturnlab;
+
+
+/*-----------------------------------.
+| yyabortlab -- YYABORT comes here.  |
+`-----------------------------------*/
+yyabortlab:
+  yyresult = 1;
+  goto yyreturnlab;
+
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
+yyexhaustedlab:
+  yyerror (YY_("memory exhausted"));
+  yyresult = 2;
+  goto yyreturnlab;
+
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYABORT or YYACCEPT.  */
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp);
+      YYPOPSTACK (1);
+    }
+#ifndef yyoverflow
+  if (yyss != yyssa)
+    YYSTACK_FREE (yyss);
+#endif
+
+  return yyresult;
+}
+
+#line 273 "parser.y"
+
+
+void yyerror(const char* s) {
+    fprintf(stderr, "Parse error at line %d: %s\n", yylineno, s);
+}
@@ -0,0 +1,123 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison interface for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+#ifndef YY_YY_PARSER_TAB_HPP_INCLUDED
+# define YY_YY_PARSER_TAB_HPP_INCLUDED
+/* Debug traces.  */
+#ifndef YYDEBUG
+# define YYDEBUG 0
+#endif
+#if YYDEBUG
+extern int yydebug;
+#endif
+/* "%code requires" blocks.  */
+#line 1 "parser.y"
+
+#include "lexer.h"
+#include "symbol.h"
+
+#line 54 "parser.tab.hpp"
+
+/* Token kinds.  */
+#ifndef YYTOKENTYPE
+# define YYTOKENTYPE
+  enum yytokentype
+  {
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    INTEGER = 258,                 /* INTEGER  */
+    BOOLEAN = 259,                 /* BOOLEAN  */
+    STRING = 260,                  /* STRING  */
+    IDENTIFIER = 261,              /* IDENTIFIER  */
+    FUNCTION = 262,                /* FUNCTION  */
+    END = 263,                     /* END  */
+    IF = 264,                      /* IF  */
+    THEN = 265,                    /* THEN  */
+    ELSE = 266,                    /* ELSE  */
+    ELSEIF = 267,                  /* ELSEIF  */
+    WHILE = 268,                   /* WHILE  */
+    DO = 269,                      /* DO  */
+    RETURN = 270,                  /* RETURN  */
+    LOCAL = 271,                   /* LOCAL  */
+    TYPE = 272,                    /* TYPE  */
+    PRINT = 273,                   /* PRINT  */
+    EQ = 274,                      /* EQ  */
+    NE = 275,                      /* NE  */
+    LT = 276,                      /* LT  */
+    LE = 277,                      /* LE  */
+    GT = 278,                      /* GT  */
+    GE = 279,                      /* GE  */
+    AND = 280,                     /* AND  */
+    OR = 281,                      /* OR  */
+    NOT = 282,                     /* NOT  */
+    UNARY = 283                    /* UNARY  */
+  };
+  typedef enum yytokentype yytoken_kind_t;
+#endif
+
+/* Value type.  */
+#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
+union YYSTYPE
+{
+#line 42 "parser.y"
+
+    long long ival;
+    bool bval;
+    TokenText sval;
+    Symbol sym;
+    ASTNode* node;
+    BlockNode* block;
+    size_t list;
+
+#line 109 "parser.tab.hpp"
+
+};
+typedef union YYSTYPE YYSTYPE;
+# define YYSTYPE_IS_TRIVIAL 1
+# define YYSTYPE_IS_DECLARED 1
+#endif
+
+
+extern YYSTYPE yylval;
+
+
+int yyparse (void);
+
+
+#endif /* !YY_YY_PARSER_TAB_HPP_INCLUDED  */
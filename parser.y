@@ -1,7 +1,13 @@
+%code requires {
+#include "lexer.h"
+#include "symbol.h"
+}
+
 %{
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 #include "ast.h"
 
 extern int yylex();
@@ -9,31 +15,53 @@ extern int yylineno;
 void yyerror(const char* s);
 
 BlockNode* programRoot = nullptr;
+Arena* parseArena = nullptr;
+
+// Everything the parser makes lives in the arena
+template <typename T, typename... Args>
+static T* make(Args&&... args) {
+    static_assert(std::is_trivially_destructible<T>::value, "Nodes are never destroyed");
+    return parseArena->make<T>(std::forward<Args>(args)...);
+}
+
+// Lists being parsed: the items of each list are on top of one of these
+// stacks, from the index its nonterminal carries, until the list is
+// complete and copied into the arena. Lists nest, so only the innermost
+// one is ever growing.
+static std::vector<NodeRef> pendingNodes;
+static std::vector<Symbol> pendingSymbols;
+
+template <typename T>
+static ArenaList<T> takeList(std::vector<T>& pending, size_t start) {
+    ArenaList<T> list(pending.data() + start, pending.size() - start);
+    pending.resize(start);
+    return list;
+}
 %}
 
 %union {
     long long ival;
     bool bval;
-    char* sval;
+    TokenText sval;
+    Symbol sym;
     ASTNode* node;
     BlockNode* block;
-    std::vector<std::unique_ptr<ASTNode>>* args;
-    std::vector<std::string>* params;
+    size_t list;
 }
 
 %token <ival> INTEGER
 %token <bval> BOOLEAN
-%token <sval> STRING IDENTIFIER
+%token <sval> STRING
+%token <sym> IDENTIFIER
 %token FUNCTION END IF THEN ELSE ELSEIF WHILE DO RETURN LOCAL TYPE PRINT
 %token EQ NE LT LE GT GE AND OR NOT
 
 %type <node> statement expression primary_expr unary_expr multiplicative_expr
 %type <node> additive_expr comparison_expr logical_and_expr logical_or_expr
 %type <node> function_def if_stmt while_stmt assignment return_stmt function_call
-%type <block> program statement_list block
-%type <args> arg_list arg_list_items
-%type <params> param_list param_list_items
-%type <sval> type_annotation opt_type_annotation
+%type <block> program block
+%type <list> statement_list arg_list arg_list_items param_list param_list_items
+%type <sym> type_annotation opt_type_annotation
 
 %left OR
 %left AND
@@ -47,14 +75,14 @@ BlockNode* programRoot = nullptr;
 %%
 
 program:
-    statement_list { programRoot = $1; $$ = $1; }
+    statement_list { programRoot = make<BlockNode>(takeList(pendingNodes, $1)); $$ = programRoot; }
     ;
 
 statement_list:
-    /* empty */ { $$ = new BlockNode(); }
+    /* empty */ { $$ = pendingNodes.size(); }
     | statement_list statement {
         $$ = $1;
-        if ($2) $$->addStatement($2);
+        if ($2) pendingNodes.push_back($2);
     }
     ;
 
@@ -66,29 +94,21 @@ statement:
     | while_stmt { $$ = $1; }
     | return_stmt { $$ = $1; }
     | PRINT '(' arg_list ')' {
-        PrintNode* pn = new PrintNode();
-        if ($3) {
-            pn->args = std::move(*$3);
-            delete $3;
-        }
-        $$ = pn;
+        $$ = make<PrintNode>(takeList(pendingNodes, $3));
     }
     ;
 
 assignment:
     LOCAL IDENTIFIER opt_type_annotation '=' expression {
-        $$ = new AssignmentNode($2, $5, $3 ? $3 : "");
-        free($2);
-        if ($3) free($3);
+        $$ = make<AssignmentNode>($2, $5, $3, true);
     }
     | IDENTIFIER '=' expression {
-        $$ = new AssignmentNode($1, $3);
-        free($1);
+        $$ = make<AssignmentNode>($1, $3);
     }
     ;
 
 opt_type_annotation:
-    /* empty */ { $$ = nullptr; }
+    /* empty */ { $$ = Symbol(); }
     | ':' type_annotation { $$ = $2; }
     ;
 
@@ -98,86 +118,73 @@ type_annotation:
 
 function_def:
     FUNCTION IDENTIFIER '(' param_list ')' opt_type_annotation block END {
-        $$ = new FunctionDefNode($2, *$4, $7, {}, $6 ? $6 : "");
-        free($2);
-        if ($6) free($6);
-        delete $4;
+        $$ = make<FunctionDefNode>($2, takeList(pendingSymbols, $4), $7, $6);
     }
     ;
 
 param_list:
-    /* empty */ { $$ = new std::vector<std::string>(); }
+    /* empty */ { $$ = pendingSymbols.size(); }
     | param_list_items { $$ = $1; }
     ;
 
 param_list_items:
     IDENTIFIER opt_type_annotation {
-        $$ = new std::vector<std::string>();
-        $$->push_back($1);
-        free($1);
-        if ($2) free($2);
+        $$ = pendingSymbols.size();
+        pendingSymbols.push_back($1);
     }
     | param_list_items ',' IDENTIFIER opt_type_annotation {
         $$ = $1;
-        $$->push_back($3);
-        free($3);
-        if ($4) free($4);
+        pendingSymbols.push_back($3);
     }
     ;
 
 function_call:
     IDENTIFIER '(' arg_list ')' {
-        FunctionCallNode* fc = new FunctionCallNode($1);
-        if ($3) {
-            fc->args = std::move(*$3);
-            delete $3;
-        }
-        $$ = fc;
-        free($1);
+        $$ = make<FunctionCallNode>($1, takeList(pendingNodes, $3));
     }
     ;
 
 arg_list:
-    /* empty */ { $$ = nullptr; }
+    /* empty */ { $$ = pendingNodes.size(); }
     | arg_list_items { $$ = $1; }
     ;
 
 arg_list_items:
     expression {
-        $$ = new std::vector<std::unique_ptr<ASTNode>>();
-        $$->push_back(std::unique_ptr<ASTNode>($1));
+        $$ = pendingNodes.size();
+        pendingNodes.push_back($1);
     }
     | arg_list_items ',' expression {
         $$ = $1;
-        $$->push_back(std::unique_ptr<ASTNode>($3));
+        pendingNodes.push_back($3);
     }
     ;
 
 if_stmt:
     IF expression THEN block END {
-        $$ = new IfNode($2, $4);
+        $$ = make<IfNode>($2, $4);
     }
     | IF expression THEN block ELSE block END {
-        $$ = new IfNode($2, $4, $6);
+        $$ = make<IfNode>($2, $4, $6);
     }
     ;
 
 while_stmt:
     WHILE expression DO block END {
-        $$ = new WhileNode($2, $4);
+        $$ = make<WhileNode>($2, $4);
     }
     ;
 
 block:
-    statement_list { $$ = $1; }
+    statement_list { $$ = make<BlockNode>(takeList(pendingNodes, $1)); }
     ;
 
 return_stmt:
     RETURN expression {
-        $$ = new ReturnNode($2);
+        $$ = make<ReturnNode>($2);
     }
     | RETURN {
-        $$ = new ReturnNode(nullptr);
+        $$ = make<ReturnNode>(nullptr);
     }
     ;
 
@@ -188,77 +195,77 @@ expression:
 logical_or_expr:
     logical_and_expr { $$ = $1; }
     | logical_or_expr OR logical_and_expr {
-        $$ = new BinaryOpNode(BinaryOpType::OR, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::OR, $1, $3);
     }
     ;
 
 logical_and_expr:
     comparison_expr { $$ = $1; }
     | logical_and_expr AND comparison_expr {
-        $$ = new BinaryOpNode(BinaryOpType::AND, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::AND, $1, $3);
     }
     ;
 
 comparison_expr:
     additive_expr { $$ = $1; }
     | comparison_expr EQ additive_expr {
-        $$ = new BinaryOpNode(BinaryOpType::EQ, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::EQ, $1, $3);
     }
     | comparison_expr NE additive_expr {
-        $$ = new BinaryOpNode(BinaryOpType::NE, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::NE, $1, $3);
     }
     | comparison_expr LT additive_expr {
-        $$ = new BinaryOpNode(BinaryOpType::LT, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::LT, $1, $3);
     }
     | comparison_expr LE additive_expr {
-        $$ = new BinaryOpNode(BinaryOpType::LE, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::LE, $1, $3);
     }
     | comparison_expr GT additive_expr {
-        $$ = new BinaryOpNode(BinaryOpType::GT, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::GT, $1, $3);
     }
     | comparison_expr GE additive_expr {
-        $$ = new BinaryOpNode(BinaryOpType::GE, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::GE, $1, $3);
     }
     ;
 
 additive_expr:
     multiplicative_expr { $$ = $1; }
     | additive_expr '+' multiplicative_expr {
-        $$ = new BinaryOpNode(BinaryOpType::ADD, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::ADD, $1, $3);
     }
     | additive_expr '-' multiplicative_expr {
-        $$ = new BinaryOpNode(BinaryOpType::SUB, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::SUB, $1, $3);
     }
     ;
 
 multiplicative_expr:
     unary_expr { $$ = $1; }
     | multiplicative_expr '*' unary_expr {
-        $$ = new BinaryOpNode(BinaryOpType::MUL, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::MUL, $1, $3);
     }
     | multiplicative_expr '/' unary_expr {
-        $$ = new BinaryOpNode(BinaryOpType::DIV, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::DIV, $1, $3);
     }
     | multiplicative_expr '%' unary_expr {
-        $$ = new BinaryOpNode(BinaryOpType::MOD, $1, $3);
+        $$ = make<BinaryOpNode>(BinaryOpType::MOD, $1, $3);
     }
     ;
 
 unary_expr:
     primary_expr { $$ = $1; }
     | NOT unary_expr {
-        $$ = new UnaryOpNode(UnaryOpType::NOT, $2);
+        $$ = make<UnaryOpNode>(UnaryOpType::NOT, $2);
     }
     | '-' unary_expr %prec UNARY {
-        $$ = new UnaryOpNode(UnaryOpType::NEG, $2);
+        $$ = make<UnaryOpNode>(UnaryOpType::NEG, $2);
     }
     ;
 
 primary_expr:
-    INTEGER { $$ = new IntegerNode($1); }
-    | BOOLEAN { $$ = new BooleanNode($1); }
-    | STRING { $$ = new StringNode($1); free($1); }
-    | IDENTIFIER { $$ = new VariableNode($1); free($1); }
+    INTEGER { $$ = make<IntegerNode>($1); }
+    | BOOLEAN { $$ = make<BooleanNode>($1); }
+    | STRING { $$ = make<StringNode>($1.str()); }
+    | IDENTIFIER { $$ = make<VariableNode>($1); }
     | function_call { $$ = $1; }
     | '(' expression ')' { $$ = $2; }
     ;
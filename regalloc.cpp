@@ -0,0 +1,211 @@
+#include "regalloc.h"
+#include <algorithm>
+#include <climits>
+
+// A set of vregs per block, packed 64 to a word; block b's set is the
+// words [b * words, (b + 1) * words)
+namespace {
+struct BlockSets {
+    size_t words;
+    std::vector<uint64_t> bits;
+
+    BlockSets(size_t blockCount, int vregCount) : words((vregCount + 63) / 64), bits(blockCount * words) {}
+    uint64_t* operator[](size_t block) { return bits.data() + block * words; }
+    const uint64_t* operator[](size_t block) const { return bits.data() + block * words; }
+};
+
+bool contains(const uint64_t* set, int v) { return set[v >> 6] >> (v & 63) & 1; }
+void insert(uint64_t* set, int v) { set[v >> 6] |= 1ULL << (v & 63); }
+
+// Call f on every vreg in a set
+template <typename F>
+void forEach(const uint64_t* set, size_t words, F f) {
+    for (size_t w = 0; w < words; w++) {
+        for (uint64_t word = set[w]; word; word &= word - 1) {
+            f((int)(w * 64 + __builtin_ctzll(word)));
+        }
+    }
+}
+} // namespace
+
+// Instruction i of the linearized function reads its operands at position
+// 2*i and writes its result at 2*i+1, so an operand's last use never
+// overlaps the result it feeds and the two may share a register.
+std::vector<LiveInterval> computeLiveIntervals(const IRFunction& func) {
+    size_t blockCount = func.blocks.size();
+    int vregCount = func.vregCount;
+
+    // Linear positions of each block (empty blocks still get one)
+    std::vector<int> blockStart(blockCount), blockEnd(blockCount);
+    int pos = 0;
+    for (size_t b = 0; b < blockCount; b++) {
+        size_t n = std::max<size_t>(func.blocks[b].instrs.size(), 1);
+        blockStart[b] = 2 * pos;
+        pos += n;
+        blockEnd[b] = 2 * pos - 1;
+    }
+
+    // Upward-exposed uses and definitions per block
+    BlockSets use(blockCount, vregCount), def(blockCount, vregCount);
+    for (size_t b = 0; b < blockCount; b++) {
+        for (const auto& instr : func.blocks[b].instrs) {
+            for (int arg : instr.args) {
+                if (!contains(def[b], arg)) insert(use[b], arg);
+            }
+            if (instr.dst >= 0) insert(def[b], instr.dst);
+        }
+    }
+
+    // Backward dataflow to a fixpoint. Postorder sees a block's successors
+    // before it, so outside loops one pass settles it; blocks unreachable
+    // from the entry still get code, and come last.
+    std::vector<std::vector<int>> succs(blockCount);
+    for (size_t b = 0; b < blockCount; b++) {
+        succs[b] = func.successors(b);
+    }
+    std::vector<int> order = func.reversePostOrder();
+    std::reverse(order.begin(), order.end());
+    std::vector<bool> ordered(blockCount);
+    for (int b : order) ordered[b] = true;
+    for (size_t b = blockCount; b-- > 0;) {
+        if (!ordered[b]) order.push_back(b);
+    }
+
+    size_t words = use.words;
+    BlockSets liveIn(blockCount, vregCount), liveOut(blockCount, vregCount);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b : order) {
+            uint64_t* out = liveOut[b];
+            uint64_t* in = liveIn[b];
+            for (size_t w = 0; w < words; w++) {
+                uint64_t o = 0;
+                for (int s : succs[b]) o |= liveIn[s][w];
+                uint64_t i = use[b][w] | (o & ~def[b][w]);
+                out[w] = o;
+                if (i != in[w]) {
+                    in[w] = i;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Build one interval per vreg spanning every position where it is live
+    std::vector<LiveInterval> ranges(vregCount);
+    for (int v = 0; v < vregCount; v++) {
+        ranges[v] = {v, INT_MAX, -1};
+    }
+    auto extend = [&](int v, int p) {
+        ranges[v].start = std::min(ranges[v].start, p);
+        ranges[v].end = std::max(ranges[v].end, p);
+    };
+
+    for (size_t b = 0; b < blockCount; b++) {
+        forEach(liveIn[b], words, [&](int v) { extend(v, blockStart[b]); });
+        forEach(liveOut[b], words, [&](int v) { extend(v, blockEnd[b]); });
+        int p = blockStart[b];
+        for (const auto& instr : func.blocks[b].instrs) {
+            for (int arg : instr.args) extend(arg, p);
+            if (instr.dst >= 0) extend(instr.dst, p + 1);
+            p += 2;
+        }
+    }
+
+    std::vector<LiveInterval> intervals;
+    for (const auto& range : ranges) {
+        if (range.end >= 0) intervals.push_back(range);
+    }
+    return intervals;
+}
+
+RegAllocation allocateRegisters(const IRFunction& func, int regCount) {
+    RegAllocation alloc;
+    alloc.locations.assign(func.vregCount, Operand::imm(0));
+
+    // A vreg whose only definition is a CONST needs no register: every use
+    // takes the constant as an immediate. Strings are the exception: their
+    // addresses are loaded once, where the code can be relocated. A MOVE
+    // prefers its source's register so the copy disappears when the
+    // source dies there.
+    std::vector<int> defCount(func.vregCount);
+    std::vector<int> hint(func.vregCount, -1);
+    for (const auto& block : func.blocks) {
+        for (const auto& instr : block.instrs) {
+            if (instr.dst < 0) continue;
+            defCount[instr.dst]++;
+            if (instr.op == IROp::CONST) alloc.locations[instr.dst] = Operand::imm(instr.imm);
+            if (instr.op == IROp::MOVE) hint[instr.dst] = instr.args[0];
+        }
+    }
+    std::vector<bool> rematerialized(func.vregCount);
+    for (const auto& block : func.blocks) {
+        for (const auto& instr : block.instrs) {
+            if (instr.op == IROp::CONST && defCount[instr.dst] == 1 && func.types[instr.dst] != IRType::STRING) {
+                rematerialized[instr.dst] = true;
+            }
+        }
+    }
+
+    std::vector<LiveInterval> intervals;
+    for (const auto& interval : computeLiveIntervals(func)) {
+        if (!rematerialized[interval.vreg]) intervals.push_back(interval);
+    }
+    std::sort(intervals.begin(), intervals.end(),
+              [](const LiveInterval& a, const LiveInterval& b) {
+                  return a.start != b.start ? a.start < b.start : a.vreg < b.vreg;
+              });
+
+    std::vector<bool> regFree(regCount, true);
+    std::vector<LiveInterval> active;  // sorted by increasing end
+
+    auto addActive = [&](const LiveInterval& interval) {
+        auto it = std::upper_bound(active.begin(), active.end(), interval,
+                                   [](const LiveInterval& a, const LiveInterval& b) {
+                                       return a.end < b.end;
+                                   });
+        active.insert(it, interval);
+    };
+
+    for (const auto& cur : intervals) {
+        // Expire intervals that ended before this one starts
+        while (!active.empty() && active.front().end < cur.start) {
+            regFree[alloc.locations[active.front().vreg].value] = true;
+            active.erase(active.begin());
+        }
+
+        int reg = -1;
+        if (hint[cur.vreg] >= 0) {
+            Operand source = alloc.locations[hint[cur.vreg]];
+            if (source.isReg() && regFree[source.value]) reg = source.value;
+        }
+        for (int r = 0; reg < 0 && r < regCount; r++) {
+            if (regFree[r]) {
+                reg = r;
+                break;
+            }
+        }
+
+        if (reg >= 0) {
+            regFree[reg] = false;
+            alloc.locations[cur.vreg] = Operand::reg(reg);
+            alloc.usedRegs = std::max(alloc.usedRegs, reg + 1);
+            addActive(cur);
+            continue;
+        }
+
+        // Out of registers: spill whichever interval lives longest
+        if (!active.empty() && active.back().end > cur.end) {
+            LiveInterval spilled = active.back();
+            active.pop_back();
+            alloc.locations[cur.vreg] = alloc.locations[spilled.vreg];
+            alloc.locations[spilled.vreg] = Operand::slot(alloc.spillSlots++);
+            addActive(cur);
+        } else {
+            alloc.locations[cur.vreg] = Operand::slot(alloc.spillSlots++);
+        }
+    }
+
+    return alloc;
+}
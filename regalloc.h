@@ -0,0 +1,35 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "ir.h"
+#include "codegen.h"
+#include <vector>
+
+// Result of register allocation: a location for every vreg
+struct RegAllocation {
+    std::vector<Operand> locations;  // indexed by vreg
+    int spillSlots = 0;              // frame slots used for spilled vregs
+    int usedRegs = 0;                // allocatable registers touched (prefix)
+
+    Operand operator[](int vreg) const { return locations[vreg]; }
+};
+
+// Live range of a vreg over the linearized instruction order
+struct LiveInterval {
+    int vreg;
+    int start;
+    int end;
+};
+
+// Compute live intervals from block-level liveness (loops extend ranges
+// across the whole loop body)
+std::vector<LiveInterval> computeLiveIntervals(const IRFunction& func);
+
+// Linear scan register allocation (Poletto & Sarkar) onto 'regCount'
+// callee-saved registers. Under pressure, the interval ending furthest
+// away is spilled to a frame slot. Single-definition constants, other than
+// string addresses, are rematerialized as immediate operands instead of
+// occupying a register.
+RegAllocation allocateRegisters(const IRFunction& func, int regCount);
+
+#endif // REGALLOC_H
@@ -0,0 +1,151 @@
+#include "resolver.h"
+#include <utility>
+#include <vector>
+
+namespace {
+
+class SlotResolver {
+public:
+    explicit SlotResolver(GlobalTable& globals) : globals(globals) {}
+
+    void resolveFunction(FunctionDefNode* func);
+    void resolveTopLevel(BlockNode* program);
+
+private:
+    GlobalTable& globals;
+
+    // Locals in scope in the function being resolved, innermost last; a
+    // block drops the ones it declared when it ends. Every declaration
+    // gets a slot of its own, so a local that shadows another (or is
+    // declared again) is a different variable.
+    std::vector<std::pair<Symbol, int>> scope;
+    int frameSize = 0;
+    bool inFunction = false;
+
+    int lookup(Symbol name) const;
+    void annotateBlock(ASTNode* node);
+    void annotate(ASTNode* node);
+};
+
+void SlotResolver::resolveFunction(FunctionDefNode* func) {
+    scope.clear();
+    frameSize = 0;
+    inFunction = true;
+    for (const auto& param : func->params) {
+        scope.emplace_back(param, frameSize++);
+    }
+    annotateBlock(func->body.get());
+    func->frameSize = frameSize;
+}
+
+// The main chunk has no locals; functions defined in it, inside blocks
+// too, get their own frames
+void SlotResolver::resolveTopLevel(BlockNode* program) {
+    scope.clear();
+    inFunction = false;
+    annotate(program);
+}
+
+// The innermost local of that name, or -1 for a global
+int SlotResolver::lookup(Symbol name) const {
+    for (auto it = scope.rbegin(); it != scope.rend(); ++it) {
+        if (it->first == name) return it->second;
+    }
+    return -1;
+}
+
+void SlotResolver::annotateBlock(ASTNode* node) {
+    size_t outer = scope.size();
+    annotate(node);
+    scope.resize(outer);
+}
+
+void SlotResolver::annotate(ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case ASTNodeType::VARIABLE: {
+            VariableNode* var = static_cast<VariableNode*>(node);
+            var->slot = lookup(var->name);
+            if (var->slot < 0) var->global = globals.index(var->name);
+            break;
+        }
+        case ASTNodeType::ASSIGNMENT: {
+            // 'local x = x' reads the x in scope before the declaration
+            AssignmentNode* assign = static_cast<AssignmentNode*>(node);
+            annotate(assign->value.get());
+            if (assign->isLocal && inFunction) {
+                assign->slot = frameSize++;
+                scope.emplace_back(assign->variable, assign->slot);
+            } else {
+                assign->slot = lookup(assign->variable);
+            }
+            if (assign->slot < 0) assign->global = globals.index(assign->variable);
+            break;
+        }
+        case ASTNodeType::BINARY_OP: {
+            BinaryOpNode* binOp = static_cast<BinaryOpNode*>(node);
+            annotate(binOp->left.get());
+            annotate(binOp->right.get());
+            break;
+        }
+        case ASTNodeType::UNARY_OP:
+            annotate(static_cast<UnaryOpNode*>(node)->operand.get());
+            break;
+        case ASTNodeType::FUNCTION_CALL:
+            for (auto& arg : static_cast<FunctionCallNode*>(node)->args) {
+                annotate(arg.get());
+            }
+            break;
+        case ASTNodeType::PRINT:
+            for (auto& arg : static_cast<PrintNode*>(node)->args) {
+                annotate(arg.get());
+            }
+            break;
+        case ASTNodeType::RETURN:
+            annotate(static_cast<ReturnNode*>(node)->value.get());
+            break;
+        case ASTNodeType::IF_STMT: {
+            IfNode* ifNode = static_cast<IfNode*>(node);
+            annotate(ifNode->condition.get());
+            annotateBlock(ifNode->thenBlock.get());
+            annotateBlock(ifNode->elseBlock.get());
+            break;
+        }
+        case ASTNodeType::WHILE_STMT: {
+            WhileNode* whileNode = static_cast<WhileNode*>(node);
+            annotate(whileNode->condition.get());
+            annotateBlock(whileNode->body.get());
+            break;
+        }
+        case ASTNodeType::BLOCK: {
+            size_t outer = scope.size();
+            for (auto& stmt : static_cast<BlockNode*>(node)->statements) {
+                annotate(stmt.get());
+            }
+            scope.resize(outer);
+            break;
+        }
+        case ASTNodeType::FUNCTION_DEF: {
+            // Nested definition: no upvalues, so it sees none of our
+            // locals; resolve it separately, then restore ours
+            auto savedScope = std::move(scope);
+            int savedFrameSize = frameSize;
+            bool savedInFunction = inFunction;
+            resolveFunction(static_cast<FunctionDefNode*>(node));
+            scope = std::move(savedScope);
+            frameSize = savedFrameSize;
+            inFunction = savedInFunction;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+} // namespace
+
+void resolveSlots(BlockNode* program, GlobalTable& globals) {
+    SlotResolver resolver(globals);
+    resolver.resolveTopLevel(program);
+}
@@ -0,0 +1,18 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ast.h"
+#include "globals.h"
+
+// Assigns frame slots to the parameters and 'local' variables of every
+// function and records them on the VariableNode/AssignmentNode uses, so the
+// interpreter, the VM and the JIT address them by index instead of by name.
+// Scoping is Lua's: a local is visible from the statement after its
+// declaration to the end of the enclosing block, and hides any variable of
+// the same name meanwhile; each declaration has a slot of its own. Anything else,
+// including every variable at the top level, is a global (slot -1), and
+// gets its slot in the global table instead. Resolving the same program
+// against a fresh table always gives the globals the same slots.
+void resolveSlots(BlockNode* program, GlobalTable& globals);
+
+#endif // RESOLVER_H
@@ -0,0 +1,40 @@
+#include "source.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::~SourceFile() {
+    if (mapping) munmap(mapping, length);
+}
+
+bool SourceFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    // A regular file is mapped and read front to back once; anything
+    // else (and an empty file, which can't be mapped) is read in
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            close(fd);
+            mapping = map;
+            text = (const char*)map;
+            length = st.st_size;
+            return true;
+        }
+    }
+
+    char buffer[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        contents.append(buffer, n);
+    }
+    close(fd);
+    if (n < 0) return false;
+    text = contents.data();
+    length = contents.size();
+    return true;
+}
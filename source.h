@@ -0,0 +1,30 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstddef>
+#include <string>
+
+// The text of a program file, mapped into memory where possible (read in
+// otherwise, e.g. from a pipe), for the lexer to scan in place. The text
+// stays valid as long as the SourceFile.
+class SourceFile {
+public:
+    SourceFile() = default;
+    ~SourceFile();
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    // False if the file can't be read
+    bool open(const std::string& path);
+
+    const char* data() const { return text; }
+    size_t size() const { return length; }
+
+private:
+    const char* text = "";
+    size_t length = 0;
+    void* mapping = nullptr;
+    std::string contents;  // if not mapped
+};
+
+#endif // SOURCE_H
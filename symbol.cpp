@@ -0,0 +1,40 @@
+#include "symbol.h"
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+// Names by ID, in a deque so that they never move: the index keys on
+// views of them
+struct SymbolTable {
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, uint32_t> ids;
+
+    SymbolTable() {
+        names.emplace_back();
+        ids.emplace(names.back(), 0);
+    }
+};
+
+SymbolTable& symbols() {
+    static SymbolTable table;
+    return table;
+}
+
+} // namespace
+
+Symbol Symbol::intern(const char* text, size_t length) {
+    SymbolTable& table = symbols();
+    auto it = table.ids.find(std::string_view(text, length));
+    if (it != table.ids.end()) return Symbol{it->second};
+
+    uint32_t id = (uint32_t)table.names.size();
+    table.names.emplace_back(text, length);
+    table.ids.emplace(table.names.back(), id);
+    return Symbol{id};
+}
+
+const std::string& Symbol::str() const {
+    return symbols().names[id];
+}
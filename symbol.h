@@ -0,0 +1,36 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// An interned name. The lexer enters each distinct identifier in the symbol
+// table the first time it sees it, and from then on the name is a Symbol:
+// comparing or hashing one is comparing or hashing a small integer. IDs are
+// handed out in the order names are first seen, so maps ordered by Symbol
+// iterate the same way every run; 0 is the empty name, so a value-
+// initialized Symbol is valid. Plain data, so the parser can hold one.
+struct Symbol {
+    uint32_t id;
+
+    static Symbol intern(const char* text, size_t length);
+    static Symbol intern(const std::string& text) { return intern(text.data(), text.size()); }
+
+    // The name, valid for as long as the program runs
+    const std::string& str() const;
+
+    bool operator==(Symbol other) const { return id == other.id; }
+    bool operator!=(Symbol other) const { return id != other.id; }
+    bool operator<(Symbol other) const { return id < other.id; }
+};
+
+namespace std {
+template <>
+struct hash<Symbol> {
+    size_t operator()(Symbol symbol) const { return symbol.id; }
+};
+}
+
+#endif // SYMBOL_H
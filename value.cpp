@@ -0,0 +1,24 @@
+#include "value.h"
+#include <stdexcept>
+#include <unordered_map>
+
+Value Value::interned(const std::string& s) {
+    // Deliberately never destroyed: interned strings outlive every Value
+    static auto* table = new std::unordered_map<std::string, StringObject*>();
+    auto it = table->find(s);
+    if (it == table->end()) {
+        it = table->emplace(s, new StringObject{1, true, s}).first;
+    }
+    return Value(it->second);
+}
+
+void Value::typeError(const char* expected) const {
+    static const char* names[] = {"an integer", "a boolean", "a string", "nil"};
+    throw std::runtime_error(std::string("Expected ") + expected + ", got " + names[(int)type]);
+}
+
+Value Value::concatenate(const Value& left, const Value& right) {
+    std::string result = left.type == ValueType::STRING ? left.asString() : std::to_string(left.asInteger());
+    result += right.type == ValueType::STRING ? right.asString() : std::to_string(right.asInteger());
+    return Value(std::move(result));
+}
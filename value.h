@@ -0,0 +1,141 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <string>
+#include <cstdint>
+
+enum class ValueType : uint8_t {
+    INTEGER,
+    BOOLEAN,
+    STRING,
+    NONE
+};
+
+// Immutable string payload shared between Values by reference counting.
+// Interned strings belong to the intern table and are never freed, so
+// copying them skips the count entirely.
+struct StringObject {
+    uint32_t refCount;
+    bool interned;
+    std::string str;
+};
+
+// 16-byte tagged value: a type tag plus a 64-bit payload. Integers and
+// booleans are stored inline, so the payload is exactly what compiled code
+// passes around; copying a string only touches its reference count.
+class Value {
+public:
+    ValueType type;
+
+    Value() : type(ValueType::NONE), integer(0) {}
+    Value(long long i) : type(ValueType::INTEGER), integer(i) {}
+    Value(bool b) : type(ValueType::BOOLEAN), integer(b) {}
+    Value(const std::string& s) : type(ValueType::STRING), string(new StringObject{1, false, s}) {}
+    Value(std::string&& s) : type(ValueType::STRING), string(new StringObject{1, false, std::move(s)}) {}
+    Value(const char* s) : Value(std::string(s)) {}
+
+    Value(const Value& other) : type(other.type), integer(other.integer) { retain(); }
+    Value(Value&& other) noexcept : type(other.type), integer(other.integer) {
+        other.type = ValueType::NONE;
+        other.integer = 0;
+    }
+    Value& operator=(const Value& other) {
+        other.retain();
+        release();
+        type = other.type;
+        integer = other.integer;
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            type = other.type;
+            integer = other.integer;
+            other.type = ValueType::NONE;
+            other.integer = 0;
+        }
+        return *this;
+    }
+    ~Value() { release(); }
+
+    // The shared copy of a string kept for the lifetime of the program
+    static Value interned(const std::string& s);
+
+    // A NONE value reads as 0, as it always has for compiled code
+    long long asInteger() const {
+        if (type != ValueType::INTEGER && type != ValueType::NONE) typeError("an integer");
+        return integer;
+    }
+    bool asBoolean() const {
+        if (type == ValueType::BOOLEAN) return integer != 0;
+        if (type == ValueType::INTEGER) return integer != 0;
+        return true;
+    }
+    const std::string& asString() const {
+        if (type != ValueType::STRING) typeError("a string");
+        return string->str;
+    }
+
+    bool isNone() const { return type == ValueType::NONE; }
+
+    // The payload as compiled code handles it: the integer, 0/1, or the
+    // StringObject pointer. fromBits takes a new reference to a string.
+    long long bits() const { return integer; }
+    static Value fromBits(ValueType type, long long bits) {
+        Value value;
+        value.type = type;
+        value.integer = bits;
+        value.retain();
+        return value;
+    }
+
+    // A reference kept as a bare payload outside any Value (see
+    // GlobalTable): taken with retainedBits, and given back to a Value,
+    // which drops it in the end, with adopt
+    long long retainedBits() const {
+        retain();
+        return integer;
+    }
+    static Value adopt(ValueType type, long long bits) {
+        Value value;
+        value.type = type;
+        value.integer = bits;
+        return value;
+    }
+
+    // '==' as the language defines it: values of different types (and nil)
+    // are never equal
+    bool equals(const Value& other) const {
+        if (type != other.type) return false;
+        if (type == ValueType::STRING) {
+            return string == other.string || string->str == other.string->str;
+        }
+        return type != ValueType::NONE && integer == other.integer;
+    }
+
+    // '+' with a string operand: both sides converted to text and joined
+    static Value concatenate(const Value& left, const Value& right);
+
+private:
+    union {
+        long long integer;      // INTEGER and BOOLEAN (0/1); 0 for NONE
+        StringObject* string;   // STRING
+    };
+
+    [[noreturn]] void typeError(const char* expected) const;
+
+    explicit Value(StringObject* s) : type(ValueType::STRING), string(s) {}
+
+    void retain() const {
+        if (type == ValueType::STRING && !string->interned) string->refCount++;
+    }
+    void release() {
+        if (type == ValueType::STRING && !string->interned && --string->refCount == 0) {
+            delete string;
+        }
+    }
+};
+
+static_assert(sizeof(Value) == 16, "Value should stay two words");
+
+#endif // VALUE_H
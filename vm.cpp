@@ -0,0 +1,298 @@
+#include "vm.h"
+#include <iostream>
+#include <stdexcept>
+
+// Deepest call nesting before the VM gives up instead of exhausting memory
+static const size_t MAX_FRAMES = 200000;
+
+VM::VM(Module& module)
+    : module(module),
+      globals(module.globalNames.size()),
+      globalDefined(module.globalNames.size(), false),
+      functions(module.functionNames.size(), nullptr) {}
+
+void VM::run() {
+    Proto* main = module.protos[0].get();
+    ensureStack(main->maxRegs);
+    execute(main, 0);
+    stack.clear();
+}
+
+void VM::ensureStack(size_t size) {
+    if (stack.size() < size) {
+        stack.resize(std::max(size, stack.size() * 2));
+    }
+}
+
+void VM::undefinedGlobal(int index) {
+    throw std::runtime_error("Undefined variable: " + module.globalNames[index].str());
+}
+
+void VM::undefinedFunction(int index) {
+    throw std::runtime_error("Undefined function: " + module.functionNames[index].str());
+}
+
+static void printValue(const Value& val) {
+    switch (val.type) {
+        case ValueType::INTEGER:
+            std::cout << val.asInteger();
+            break;
+        case ValueType::BOOLEAN:
+            std::cout << (val.asBoolean() ? "true" : "false");
+            break;
+        case ValueType::STRING:
+            std::cout << val.asString();
+            break;
+        case ValueType::NONE:
+            std::cout << "nil";
+            break;
+    }
+}
+
+// Dispatch: with GCC/Clang every handler jumps straight to the next one
+// through a label table (one indirect branch per handler, which predicts
+// far better than a single shared switch); elsewhere it is a plain switch.
+#if defined(__GNUC__)
+#define VM_DISPATCH() goto *labels[(insn = *pc++) & 0xFF]
+#define VM_SWITCH() VM_DISPATCH();
+#define VM_CASE(op) L_##op:
+#define VM_NEXT() VM_DISPATCH()
+#else
+#define VM_SWITCH() switch (decodeOp(insn = *pc++))
+#define VM_CASE(op) case Op::op:
+#define VM_NEXT() continue
+#endif
+
+#define RA R[decodeA(insn)]
+#define RB R[decodeB(insn)]
+#define RC R[decodeC(insn)]
+
+// Integer fast path for an arithmetic or comparison op; anything else goes
+// through Value, which raises the same type errors as the interpreter
+#define VM_ARITH(op, expr) \
+    VM_CASE(op) { \
+        const Value& b = RB; \
+        const Value& c = RC; \
+        long long x = b.asInteger(); \
+        long long y = c.asInteger(); \
+        RA = Value(expr); \
+        VM_NEXT(); \
+    }
+
+Value VM::execute(Proto* entry, size_t base) {
+#if defined(__GNUC__)
+    static void* const labels[] = {
+        &&L_MOVE, &&L_LOADI, &&L_LOADK, &&L_LOADBOOL, &&L_LOADNIL,
+        &&L_GETGLOBAL, &&L_SETGLOBAL,
+        &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_MOD,
+        &&L_EQ, &&L_NE, &&L_LT, &&L_LE, &&L_GT, &&L_GE,
+        &&L_AND, &&L_OR, &&L_NOT, &&L_NEG,
+        &&L_JMP, &&L_JMPIF, &&L_JMPIFNOT,
+        &&L_CALL, &&L_TAILCALL, &&L_RETURN, &&L_RETURN0, &&L_PRINT, &&L_DEFFUNC,
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == (size_t)Op::OP_COUNT,
+                  "dispatch table out of sync with Op");
+#endif
+
+    Proto* proto = entry;
+    const uint32_t* pc = proto->code.data();
+    const Value* K = proto->constants.data();
+    Value* R = stack.data() + base;
+    size_t entryFrames = frames.size();
+    uint32_t insn;
+    Value result;
+
+    for (;;) {
+        VM_SWITCH() {
+        VM_CASE(MOVE) {
+            RA = RB;
+            VM_NEXT();
+        }
+        VM_CASE(LOADI) {
+            RA = Value((long long)decodeSBx(insn));
+            VM_NEXT();
+        }
+        VM_CASE(LOADK) {
+            RA = K[decodeBx(insn)];
+            VM_NEXT();
+        }
+        VM_CASE(LOADBOOL) {
+            RA = Value(decodeB(insn) != 0);
+            VM_NEXT();
+        }
+        VM_CASE(LOADNIL) {
+            RA = Value();
+            VM_NEXT();
+        }
+        VM_CASE(GETGLOBAL) {
+            int index = decodeBx(insn);
+            if (!globalDefined[index]) undefinedGlobal(index);
+            RA = globals[index];
+            VM_NEXT();
+        }
+        VM_CASE(SETGLOBAL) {
+            int index = decodeBx(insn);
+            globals[index] = RA;
+            globalDefined[index] = true;
+            VM_NEXT();
+        }
+
+        VM_CASE(ADD) {
+            const Value& b = RB;
+            const Value& c = RC;
+            if (b.type == ValueType::STRING || c.type == ValueType::STRING) {
+                RA = Value::concatenate(b, c);
+            } else {
+                RA = Value(b.asInteger() + c.asInteger());
+            }
+            VM_NEXT();
+        }
+        VM_ARITH(SUB, x - y)
+        VM_ARITH(MUL, x * y)
+        VM_CASE(DIV) {
+            long long x = RB.asInteger();
+            long long y = RC.asInteger();
+            if (y == 0) throw std::runtime_error("Division by zero");
+            // LLONG_MIN / -1 wraps around to itself
+            RA = Value(y == -1 ? (long long)(0ULL - (unsigned long long)x) : x / y);
+            VM_NEXT();
+        }
+        VM_CASE(MOD) {
+            long long x = RB.asInteger();
+            long long y = RC.asInteger();
+            if (y == 0) throw std::runtime_error("Modulo by zero");
+            RA = Value(y == -1 ? 0LL : x % y);
+            VM_NEXT();
+        }
+        VM_CASE(EQ) {
+            RA = Value(RB.equals(RC));
+            VM_NEXT();
+        }
+        VM_CASE(NE) {
+            RA = Value(!RB.equals(RC));
+            VM_NEXT();
+        }
+        VM_ARITH(LT, x < y)
+        VM_ARITH(LE, x <= y)
+        VM_ARITH(GT, x > y)
+        VM_ARITH(GE, x >= y)
+        VM_CASE(AND) {
+            RA = Value(RB.asBoolean() && RC.asBoolean());
+            VM_NEXT();
+        }
+        VM_CASE(OR) {
+            RA = Value(RB.asBoolean() || RC.asBoolean());
+            VM_NEXT();
+        }
+        VM_CASE(NOT) {
+            RA = Value(!RB.asBoolean());
+            VM_NEXT();
+        }
+        VM_CASE(NEG) {
+            RA = Value(-RB.asInteger());
+            VM_NEXT();
+        }
+
+        VM_CASE(JMP) {
+            pc += decodeSBx(insn);
+            VM_NEXT();
+        }
+        VM_CASE(JMPIF) {
+            if (RA.asBoolean()) pc += decodeSBx(insn);
+            VM_NEXT();
+        }
+        VM_CASE(JMPIFNOT) {
+            if (!RA.asBoolean()) pc += decodeSBx(insn);
+            VM_NEXT();
+        }
+
+        VM_CASE(CALL) {
+            int index = proto->callees[decodeC(insn)];
+            Proto* callee = functions[index];
+            if (!callee) undefinedFunction(index);
+            if (frames.size() >= MAX_FRAMES) throw std::runtime_error("Stack overflow");
+
+            frames.push_back(CallFrame{proto, pc, base});
+            base += decodeA(insn);
+            ensureStack(base + callee->maxRegs);
+
+            // Missing parameters, extra arguments and locals all start as nil
+            int argc = decodeB(insn);
+            int first = argc < callee->numParams ? argc : callee->numParams;
+            Value* slots = stack.data() + base;
+            for (int i = first; i < callee->maxRegs; i++) slots[i] = Value();
+
+            proto = callee;
+            pc = proto->code.data();
+            K = proto->constants.data();
+            R = slots;
+            VM_NEXT();
+        }
+        VM_CASE(TAILCALL) {
+            int index = proto->callees[decodeC(insn)];
+            Proto* callee = functions[index];
+            if (!callee) undefinedFunction(index);
+
+            // The arguments move down to the bottom of this frame, which
+            // the callee takes over; the caller's frame stays as it was
+            int a = decodeA(insn);
+            int argc = decodeB(insn);
+            for (int i = 0; i < argc; i++) R[i] = std::move(R[a + i]);
+            ensureStack(base + callee->maxRegs);
+
+            int first = argc < callee->numParams ? argc : callee->numParams;
+            Value* slots = stack.data() + base;
+            for (int i = first; i < callee->maxRegs; i++) slots[i] = Value();
+
+            proto = callee;
+            pc = proto->code.data();
+            K = proto->constants.data();
+            R = slots;
+            VM_NEXT();
+        }
+        VM_CASE(RETURN) {
+            result = RA;
+            goto do_return;
+        }
+        VM_CASE(RETURN0) {
+            result = Value();
+            goto do_return;
+        }
+        VM_CASE(PRINT) {
+            int first = decodeA(insn);
+            int count = decodeB(insn);
+            for (int i = 0; i < count; i++) {
+                if (i > 0) std::cout << "\t";
+                printValue(R[first + i]);
+            }
+            std::cout << std::endl;
+            VM_NEXT();
+        }
+        VM_CASE(DEFFUNC) {
+            Proto* def = module.protos[decodeBx(insn)].get();
+            functions[def->functionIndex] = def;
+            VM_NEXT();
+        }
+
+#if !defined(__GNUC__)
+        default:
+            throw std::runtime_error("Invalid opcode");
+#endif
+        }
+
+    do_return:
+        if (frames.size() == entryFrames) return result;
+
+        // The callee's frame started at the caller's R[A], which is where
+        // the result goes
+        CallFrame& frame = frames.back();
+        stack[base] = std::move(result);
+        result = Value();
+        proto = frame.proto;
+        pc = frame.pc;
+        base = frame.base;
+        frames.pop_back();
+        K = proto->constants.data();
+        R = stack.data() + base;
+    }
+}
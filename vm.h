@@ -0,0 +1,40 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "value.h"
+#include <vector>
+
+// Executes a compiled Module. Calls between bytecode functions stay inside
+// one dispatch loop: each call pushes a CallFrame and points the register
+// window at the callee's arguments, which the caller left at the top of its
+// own frame.
+class VM {
+public:
+    VM(Module& module);
+
+    // Run the top-level chunk
+    void run();
+
+private:
+    struct CallFrame {
+        Proto* proto;
+        const uint32_t* pc;   // where to resume the caller
+        size_t base;          // caller's first register
+    };
+
+    Module& module;
+    std::vector<Value> globals;          // by Module::globalNames index
+    std::vector<bool> globalDefined;
+    std::vector<Proto*> functions;       // by Module::functionNames index
+    std::vector<Value> stack;            // registers of every active frame
+    std::vector<CallFrame> frames;
+
+    Value execute(Proto* entry, size_t base);
+    void ensureStack(size_t size);
+
+    [[noreturn]] void undefinedGlobal(int index);
+    [[noreturn]] void undefinedFunction(int index);
+};
+
+#endif // VM_H